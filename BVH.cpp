@@ -0,0 +1,400 @@
+/*
+* BVH.cpp
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/2/2018
+* Version 1.0
+*
+* A bounding volume hierarchy over the triangles of a Mesh, used to
+* find the first triangle crossed by a line segment without testing
+* every triangle. Each node holds an axis aligned bounding box; leaves
+* hold a short run of triangles. The tree is built once by splitting
+* the triangles at the median centroid along the longest axis of each
+* node's box, and is stored in depth first order so that the left
+* child of a node is always the node right after it.
+*
+* The BVH also answers closest point queries, used to bake signed
+* distance fields, by visiting nodes nearest first and skipping nodes
+* whose boxes are farther than the closest triangle found so far.
+*
+* Triangle vertices are copied into BVH order (as a vertex and two
+* edges) so that the triangles of a leaf are tested from contiguous memory.
+*/
+
+#include "BVH.h"
+#include "Mesh.h"
+#include "Vector.h"
+
+#include <algorithm>
+
+using namespace std;
+
+#define LEAFSIZE 4	// maximum number of triangles in a leaf
+#define MAXDEPTH 64	// size of traversal stack
+
+//-----------------------------------------------------------------
+/*
+BVH::BVH()
+* PURPOSE : Default constructor
+* INPUTS :  NONE
+* OUTPUTS : NONE, initializes empty BVH
+*/
+//-----------------------------------------------------------------
+
+BVH::BVH()
+{
+   mesh = NULL;
+   nodes = NULL;
+   numNodes = 0;
+   triOrder = NULL;
+   tris = NULL;
+   centroids = NULL;
+}
+
+//-----------------------------------------------------------------
+/*
+BVH::build(Mesh *m)
+* PURPOSE : Build the hierarchy over all triangles of a mesh
+* INPUTS :  Mesh *m, mesh to build over, must outlive the BVH
+* OUTPUTS : NONE, fills nodes, triOrder and tris
+*/
+//-----------------------------------------------------------------
+
+void BVH::build(Mesh *m)
+{
+   mesh = m;
+   int nt = mesh->numTriangles;
+
+   delete [] nodes;
+   delete [] triOrder;
+   delete [] tris;
+
+   nodes = new BVHNode[Max(2 * nt, 1)];
+   triOrder = new int[nt];
+   tris = new float[9 * nt];
+   centroids = new float[3 * nt];
+   numNodes = 0;
+
+   for (int t = 0; t < nt; t++){
+      triOrder[t] = t;
+      Vector3d c = (mesh->triangleVertex(t, 0) + mesh->triangleVertex(t, 1) + mesh->triangleVertex(t, 2)) / 3.0;
+      centroids[3 * t] = c.x;
+      centroids[3 * t + 1] = c.y;
+      centroids[3 * t + 2] = c.z;
+   }
+
+   if (nt > 0){
+      buildNode(0, nt);
+   }
+
+   for (int i = 0; i < nt; i++){		// Copy triangles into BVH order
+      Vector3d a = mesh->triangleVertex(triOrder[i], 0);
+      Vector3d e1 = mesh->triangleVertex(triOrder[i], 1) - a;
+      Vector3d e2 = mesh->triangleVertex(triOrder[i], 2) - a;
+      for (int k = 0; k < 3; k++){
+         tris[9 * i + k] = a[k];
+         tris[9 * i + 3 + k] = e1[k];
+         tris[9 * i + 6 + k] = e2[k];
+      }
+   }
+
+   delete [] centroids;
+   centroids = NULL;
+}
+
+//-----------------------------------------------------------------
+/*
+int BVH::buildNode(int start, int end)
+* PURPOSE : Recursively build the node holding triangles start to
+*           end - 1 (in BVH order)
+* INPUTS :  int start, int end, range of triOrder covered by the node
+* OUTPUTS : int, index of the new node
+*/
+//-----------------------------------------------------------------
+
+int BVH::buildNode(int start, int end)
+{
+   int index = numNodes;
+   numNodes = numNodes + 1;
+   BVHNode &node = nodes[index];
+
+   for (int k = 0; k < 3; k++){			// Bound all vertices of the node's triangles
+      node.lo[k] = HUGENUMBER;
+      node.hi[k] = -HUGENUMBER;
+   }
+   float clo[3] = {(float)HUGENUMBER, (float)HUGENUMBER, (float)HUGENUMBER};
+   float chi[3] = {(float)-HUGENUMBER, (float)-HUGENUMBER, (float)-HUGENUMBER};
+   for (int i = start; i < end; i++){
+      int t = triOrder[i];
+      for (int j = 0; j < 3; j++){
+         float *v = &mesh->vertices[3 * mesh->indices[3 * t + j]];
+         for (int k = 0; k < 3; k++){
+            node.lo[k] = Min(node.lo[k], v[k]);
+            node.hi[k] = Max(node.hi[k], v[k]);
+         }
+      }
+      for (int k = 0; k < 3; k++){
+         clo[k] = Min(clo[k], centroids[3 * t + k]);
+         chi[k] = Max(chi[k], centroids[3 * t + k]);
+      }
+   }
+
+   if (end - start <= LEAFSIZE){		// Small enough to be a leaf
+      node.start = start;
+      node.count = end - start;
+      node.right = -1;
+      return index;
+   }
+
+   int axis = 0;				// Split at median centroid along longest axis
+   for (int k = 1; k < 3; k++){
+      if (chi[k] - clo[k] > chi[axis] - clo[axis])
+         axis = k;
+   }
+   int mid = (start + end) / 2;
+   float *c = centroids;
+   nth_element(triOrder + start, triOrder + mid, triOrder + end,
+               [c, axis](int a, int b){return c[3 * a + axis] < c[3 * b + axis];});
+
+   node.start = start;
+   node.count = 0;
+   buildNode(start, mid);
+   node.right = buildNode(mid, end);		// nodes is preallocated, so node stays valid
+
+   return index;
+}
+
+//-----------------------------------------------------------------
+/*
+bool BVH::intersectSegment(const Vector3d &p0, const Vector3d &p1, double &s, int &tri)
+* PURPOSE : Find the first triangle crossed by the segment from p0 to
+*           p1, using the Moller-Trumbore ray/triangle test. Triangles
+*           are hit from either side.
+* INPUTS :  Vector3d p0, p1, segment end points
+*           double &s, int &tri, filled in if a triangle is hit
+* OUTPUTS : bool, true if the segment hits a triangle. s is the fraction
+*           of the way from p0 to p1 of the hit, tri is the mesh index
+*           of the triangle hit
+*/
+//-----------------------------------------------------------------
+
+bool BVH::intersectSegment(const Vector3d &p0, const Vector3d &p1, double &s, int &tri)
+{
+   const double epsilon = 1.0e-12;
+
+   if (numNodes == 0)
+      return false;
+
+   double o[3] = {p0.x, p0.y, p0.z};
+   double d[3] = {p1.x - p0.x, p1.y - p0.y, p1.z - p0.z};
+   double inv[3];
+   for (int k = 0; k < 3; k++){
+      inv[k] = (Abs(d[k]) > epsilon)? 1.0 / d[k] : ApplySign(HUGENUMBER, d[k]);
+   }
+
+   double best = 1.0;
+   int hit = -1;
+
+   int stack[MAXDEPTH];
+   int top = 0;
+   stack[top++] = 0;
+
+   while (top > 0){
+      int index = stack[--top];
+      BVHNode &node = nodes[index];
+
+      double tmin = 0.0, tmax = best;		// Slab test of segment against node's box
+      for (int k = 0; k < 3 && tmin <= tmax; k++){
+         double t0 = (node.lo[k] - o[k]) * inv[k];
+         double t1 = (node.hi[k] - o[k]) * inv[k];
+         if (t0 > t1){
+            double tmp = t0; t0 = t1; t1 = tmp;
+         }
+         tmin = Max(tmin, t0);
+         tmax = Min(tmax, t1);
+      }
+      if (tmin > tmax)
+         continue;
+
+      if (node.count > 0){			// Leaf, test its triangles
+         for (int i = node.start; i < node.start + node.count; i++){
+            float *a = &tris[9 * i];
+            float *e1 = a + 3;
+            float *e2 = a + 6;
+
+            double pv[3] = {d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0]};
+            double det = e1[0] * pv[0] + e1[1] * pv[1] + e1[2] * pv[2];
+            if (Abs(det) < epsilon)
+               continue;
+            double invdet = 1.0 / det;
+
+            double tv[3] = {o[0] - a[0], o[1] - a[1], o[2] - a[2]};
+            double u = (tv[0] * pv[0] + tv[1] * pv[1] + tv[2] * pv[2]) * invdet;
+            if (u < 0.0 || u > 1.0)
+               continue;
+
+            double qv[3] = {tv[1] * e1[2] - tv[2] * e1[1], tv[2] * e1[0] - tv[0] * e1[2], tv[0] * e1[1] - tv[1] * e1[0]};
+            double v = (d[0] * qv[0] + d[1] * qv[1] + d[2] * qv[2]) * invdet;
+            if (v < 0.0 || u + v > 1.0)
+               continue;
+
+            double t = (e2[0] * qv[0] + e2[1] * qv[1] + e2[2] * qv[2]) * invdet;
+            if (t >= 0.0 && t <= best){
+               best = t;
+               hit = i;
+            }
+         }
+      }
+      else if (top + 2 <= MAXDEPTH){		// Interior, visit both children
+         stack[top++] = node.right;
+         stack[top++] = index + 1;
+      }
+   }
+
+   if (hit < 0)
+      return false;
+
+   s = best;
+   tri = triOrder[hit];
+   return true;
+}
+
+//-----------------------------------------------------------------
+/*
+static Vector3d closestOnTriangle(const Vector3d &p, const Vector3d &a, const Vector3d &b, const Vector3d &c)
+* PURPOSE : Find the point of a triangle closest to p, by finding which
+*           vertex, edge or face region of the triangle p projects into
+*           (from Ericson, Real-Time Collision Detection)
+* INPUTS :  Vector3d p, query point
+*           Vector3d a, b, c, triangle vertices
+* OUTPUTS : Vector3d, closest point
+*/
+//-----------------------------------------------------------------
+
+static Vector3d closestOnTriangle(const Vector3d &p, const Vector3d &a, const Vector3d &b, const Vector3d &c)
+{
+   Vector3d ab = b - a;
+   Vector3d ac = c - a;
+   Vector3d ap = p - a;
+   double d1 = ab * ap;
+   double d2 = ac * ap;
+   if (d1 <= 0 && d2 <= 0)
+      return a;
+
+   Vector3d bp = p - b;
+   double d3 = ab * bp;
+   double d4 = ac * bp;
+   if (d3 >= 0 && d4 <= d3)
+      return b;
+
+   double vc = d1 * d4 - d3 * d2;
+   if (vc <= 0 && d1 >= 0 && d3 <= 0)
+      return a + (d1 / (d1 - d3)) * ab;
+
+   Vector3d cp = p - c;
+   double d5 = ab * cp;
+   double d6 = ac * cp;
+   if (d6 >= 0 && d5 <= d6)
+      return c;
+
+   double vb = d5 * d2 - d1 * d6;
+   if (vb <= 0 && d2 >= 0 && d6 <= 0)
+      return a + (d2 / (d2 - d6)) * ac;
+
+   double va = d3 * d6 - d5 * d4;
+   if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+      return b + ((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (c - b);
+
+   double denom = 1.0 / (va + vb + vc);
+   return a + (vb * denom) * ab + (vc * denom) * ac;
+}
+
+//-----------------------------------------------------------------
+/*
+static double boxDistanceSqr(const BVHNode &node, const Vector3d &p)
+* PURPOSE : Squared distance from a point to a node's box
+* INPUTS :  BVHNode &node, node with box
+*           Vector3d p, point
+* OUTPUTS : double, squared distance, 0 if p is inside the box
+*/
+//-----------------------------------------------------------------
+
+static double boxDistanceSqr(const BVHNode &node, const Vector3d &p)
+{
+   double d = 0;
+   for (int k = 0; k < 3; k++){
+      double v = p[k];
+      if (v < node.lo[k])
+         d += Sqr(node.lo[k] - v);
+      else if (v > node.hi[k])
+         d += Sqr(v - node.hi[k]);
+   }
+   return d;
+}
+
+//-----------------------------------------------------------------
+/*
+bool BVH::closestPoint(const Vector3d &p, double maxDist, Vector3d &c, int &tri)
+* PURPOSE : Find the closest point to p on any triangle of the mesh,
+*           within a maximum distance
+* INPUTS :  Vector3d p, query point
+*           double maxDist, triangles farther than this are ignored
+*           Vector3d &c, int &tri, filled in if a triangle is found
+* OUTPUTS : bool, true if a triangle is within maxDist. c is the closest
+*           point, tri is the mesh index of its triangle
+*/
+//-----------------------------------------------------------------
+
+bool BVH::closestPoint(const Vector3d &p, double maxDist, Vector3d &c, int &tri)
+{
+   if (numNodes == 0)
+      return false;
+
+   double best = Sqr(maxDist);
+   int hit = -1;
+
+   int stack[MAXDEPTH];
+   int top = 0;
+   stack[top++] = 0;
+
+   while (top > 0){
+      int index = stack[--top];
+      BVHNode &node = nodes[index];
+      if (boxDistanceSqr(node, p) > best)
+         continue;
+
+      if (node.count > 0){			// Leaf, test its triangles
+         for (int i = node.start; i < node.start + node.count; i++){
+            float *t = &tris[9 * i];
+            Vector3d a(t[0], t[1], t[2]);
+            Vector3d b = a + Vector3d(t[3], t[4], t[5]);
+            Vector3d cc = a + Vector3d(t[6], t[7], t[8]);
+            Vector3d q = closestOnTriangle(p, a, b, cc);
+            double d = (q - p).normsqr();
+            if (d <= best){
+               best = d;
+               hit = i;
+               c = q;
+            }
+         }
+      }
+      else if (top + 2 <= MAXDEPTH){		// Interior, visit nearer child first
+         int left = index + 1;
+         int right = node.right;
+         if (boxDistanceSqr(nodes[left], p) < boxDistanceSqr(nodes[right], p)){
+            stack[top++] = right;
+            stack[top++] = left;
+         }
+         else{
+            stack[top++] = left;
+            stack[top++] = right;
+         }
+      }
+   }
+
+   if (hit < 0)
+      return false;
+
+   tri = triOrder[hit];
+   return true;
+}
@@ -0,0 +1,44 @@
+/*
+* BVH.h
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/2/2018
+* Version 1.0
+*/
+
+#ifndef __BVH_H__
+#define __BVH_H__
+
+#include "Vector.h"
+#include "Mesh.h"
+
+struct BVHNode{
+   float lo[3];		// lo, hi, corners of the node's bounding box
+   float hi[3];
+   int start;		// start, first triangle of a leaf in BVH order
+   int count;		// count, number of triangles in a leaf, 0 for an interior node
+   int right;		// right, index of right child of an interior node, left child is the next node
+};
+
+class BVH{
+   private:
+      Mesh* mesh;
+      BVHNode* nodes;	// nodes, tree stored in depth first order
+      int numNodes;
+      int* triOrder;	// triOrder, mesh triangle index for each triangle in BVH order
+      float* tris;	// tris, vertex a, edge b-a, edge c-a of each triangle in BVH order
+      float* centroids;	// centroids, used only while building
+
+      int buildNode(int start, int end);
+
+   public:
+      BVH();
+
+      void build(Mesh *m);
+      bool intersectSegment(const Vector3d &p0, const Vector3d &p1, double &s, int &tri);
+      bool closestPoint(const Vector3d &p, double maxDist, Vector3d &c, int &tri);
+
+      int getNumNodes(){return numNodes;}
+};
+
+#endif
@@ -0,0 +1,184 @@
+/*
+* Budget.cpp
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/15/2018
+* Version 1.0
+*
+* The Budget holds the time per frame near a target when the scene has
+* more particles than the machine can keep up with. Every frame it
+* measures the wall clock time since the last frame, and keeps a running
+* average. A frame is a step of the simulation thread, which is paced
+* to the timestep, so the budget only cuts in once steps take longer
+* than the target. While the average is over the
+* target, the lowest priority generator that can still give something
+* up is throttled a little: first its emission rate, down to MINRATE of
+* what its RateCurve asks for, then the lifespan of its new particles,
+* down to MINLIFE. Once the average is comfortably under the target
+* (below HEADROOM of it), the highest priority generator that was
+* throttled gets back a little, lifespan first, then rate. Small steps
+* each frame, and the band between HEADROOM and the target, keep the
+* throttle from oscillating. Every REPORTFRAMES frames the number of
+* particles that were not emitted because of the throttle is reported.
+*/
+
+#include "Budget.h"
+#include "ParticleGenerator.h"
+#include "Utility.h"
+
+#include <cstdio>
+#include <string>
+
+using namespace std;
+
+#define MINRATE		0.1f	// least fraction of the emission rate kept
+#define MINLIFE		0.5f	// least fraction of the lifespan kept
+#define DECREASE	0.95f	// throttle change per frame over the target
+#define INCREASE	1.02f	// throttle change per frame under HEADROOM
+#define HEADROOM	0.85	// fraction of the target under which throttles are released
+#define SMOOTHING	0.9	// weight of the running average of frame time
+#define REPORTFRAMES	120	// frames between reports
+
+//-----------------------------------------------------------------
+/*
+Budget::Budget(float target)
+* PURPOSE : Constructor
+* INPUTS :  float target, frame time to hold, in milliseconds
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+Budget::Budget(float target)
+{
+   targetMs = target;
+   reset();
+}
+
+//-----------------------------------------------------------------
+/*
+void Budget::reset()
+* PURPOSE : Forget the measured frame times, called when the
+*           simulation is started or paused so the time in between
+*           is not counted as a frame
+* INPUTS :  NONE
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+void Budget::reset()
+{
+   smoothedMs = 0.0;
+   lastFrame = 0.0;
+   activeCount = 0;
+   frames = 0;
+   shedReported = 0.0;
+}
+
+//-----------------------------------------------------------------
+/*
+void Budget::update(ParticleGenerator *generators, int numGenerators)
+* PURPOSE : Measure the frame just finished, and adjust the throttle of
+*           one generator by a small step if the frame time is off target
+* INPUTS :  ParticleGenerator *generators, the generators being simulated
+*           int numGenerators, how many
+* OUTPUTS : NONE, changes generator throttles
+*/
+//-----------------------------------------------------------------
+
+void Budget::update(ParticleGenerator *generators, int numGenerators)
+{
+   double now = wallclock();
+   if (lastFrame == 0.0 || now - lastFrame > 1.0){	// first frame, or coming back from a pause
+      lastFrame = now;
+      return;
+   }
+
+   double ms = 1000.0 * (now - lastFrame);
+   lastFrame = now;
+   smoothedMs = (smoothedMs == 0.0)? ms : SMOOTHING * smoothedMs + (1.0 - SMOOTHING) * ms;
+
+   activeCount = 0;
+   for (int i = 0; i < numGenerators; i++){
+      activeCount = activeCount + generators[i].getActiveCount();
+   }
+
+   if (smoothedMs > targetMs){			// over budget, shed the least important
+      int g = -1;
+      for (int i = 0; i < numGenerators; i++){
+         bool canShed = generators[i].getRateScale() > MINRATE || generators[i].getLifeScale() > MINLIFE;
+         if (canShed && (g < 0 || generators[i].getPriority() < generators[g].getPriority()))
+            g = i;
+      }
+      if (g >= 0){
+         float rate = generators[g].getRateScale();
+         float life = generators[g].getLifeScale();
+         if (rate > MINRATE)
+            rate = Max(rate * DECREASE, MINRATE);
+         else
+            life = Max(life * DECREASE, MINLIFE);
+         generators[g].setThrottle(rate, life);
+      }
+   }
+   else if (smoothedMs < HEADROOM * targetMs){	// room to spare, restore the most important
+      int g = -1;
+      for (int i = 0; i < numGenerators; i++){
+         bool throttled = generators[i].getRateScale() < 1.0 || generators[i].getLifeScale() < 1.0;
+         if (throttled && (g < 0 || generators[i].getPriority() > generators[g].getPriority()))
+            g = i;
+      }
+      if (g >= 0){
+         float rate = generators[g].getRateScale();
+         float life = generators[g].getLifeScale();
+         if (life < 1.0)
+            life = Min(life * INCREASE, 1.0f);
+         else
+            rate = Min(rate * INCREASE, 1.0f);
+         generators[g].setThrottle(rate, life);
+      }
+   }
+
+   frames = frames + 1;
+   if (frames >= REPORTFRAMES){
+      report(generators, numGenerators);
+      frames = 0;
+   }
+}
+
+//-----------------------------------------------------------------
+/*
+void Budget::report(ParticleGenerator *generators, int numGenerators)
+* PURPOSE : Print the frame time, the number of active particles, how
+*           many particles were shed since the last report, and the
+*           throttle of each generator that is throttled. Nothing is
+*           printed if nothing has been shed.
+* INPUTS :  ParticleGenerator *generators, the generators being simulated
+*           int numGenerators, how many
+* OUTPUTS : NONE, prints status
+*/
+//-----------------------------------------------------------------
+
+void Budget::report(ParticleGenerator *generators, int numGenerators)
+{
+   double shed = 0.0;
+   for (int i = 0; i < numGenerators; i++){
+      shed = shed + generators[i].getShed();
+   }
+   if (shed == shedReported)
+      return;
+
+   char msg[256];
+   snprintf(msg, sizeof(msg), "%.1f ms/frame (target %.1f), %d active, shed %.0f particles (%.0f total)",
+            smoothedMs, targetMs, activeCount, shed - shedReported, shed);
+   string throttles;
+   for (int i = 0; i < numGenerators; i++){
+      if (generators[i].getRateScale() < 1.0 || generators[i].getLifeScale() < 1.0){
+         char gen[96];
+         snprintf(gen, sizeof(gen), "%sgenerator %d: rate %.0f%%, lifespan %.0f%%",
+                  throttles.empty()? "" : "; ", i + 1,
+                  100.0 * generators[i].getRateScale(), 100.0 * generators[i].getLifeScale());
+         throttles += gen;
+      }
+   }
+   status("Budget:", msg, throttles);
+   shedReported = shed;
+}
@@ -0,0 +1,35 @@
+/*
+* Budget.h
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/15/2018
+* Version 1.0
+*/
+
+#ifndef __BUDGET_H__
+#define __BUDGET_H__
+
+#include "ParticleGenerator.h"
+
+class Budget{			// Holds the frame time to a target by throttling generators
+   private:
+      float targetMs;		// frame time to hold, in milliseconds
+      double smoothedMs;	// running average of the measured frame time
+      double lastFrame;		// wall clock time of the last frame, 0 before the first
+      int activeCount;		// particles active at the last frame
+      int frames;		// frames since the last report
+      double shedReported;	// particles shed as of the last report
+
+   public:
+      Budget(float target);
+
+      void setTarget(float target){targetMs = target;}
+      float getTarget(){return targetMs;}
+      double getFrameTime(){return smoothedMs;}
+
+      void reset();
+      void update(ParticleGenerator *generators, int numGenerators);
+      void report(ParticleGenerator *generators, int numGenerators);
+};
+
+#endif
@@ -19,6 +19,7 @@
 #endif
 
 #include <cstdio>
+#include <cmath>
 
 using namespace std;
 
@@ -212,6 +213,73 @@ void Camera::AimCamera(){
   glRotatef(CurrentAzim, 0, 1, 0);
 }
 
+// multiply 4x4 column major matrices, C = A B
+static void MultMatrix(const double A[16], const double B[16], double C[16]){
+  for(int col = 0; col < 4; col++)
+    for(int row = 0; row < 4; row++){
+      C[4 * col + row] = 0;
+      for(int k = 0; k < 4; k++)
+        C[4 * col + row] += A[4 * k + row] * B[4 * col + k];
+    }
+}
+
+/*
+ * The viewing matrix AimCamera builds: gluLookAt from the current
+ * position, aim, and up vector, then the accumulated translation,
+ * elevation and azimuth, column major as in OpenGL
+*/
+void Camera::ViewMatrix(double M[16]) const {
+  Vector3d f = (Aim - Pos).normalize();
+  Vector3d s = (f % Up).normalize();
+  Vector3d u = s % f;
+
+  const double lookat[16] = {s.x, u.x, -f.x, 0,
+                             s.y, u.y, -f.y, 0,
+                             s.z, u.z, -f.z, 0,
+                             -(s * Pos), -(u * Pos), f * Pos, 1};
+
+  double ce = cos(DegToRad(CurrentElev)), se = sin(DegToRad(CurrentElev));
+  double ca = cos(DegToRad(CurrentAzim)), sa = sin(DegToRad(CurrentAzim));
+  const double translate[16] = {1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,
+                                TranslateX, TranslateY, TranslateZ, 1};
+  const double elevation[16] = {1, 0, 0, 0,  0, ce, se, 0,  0, -se, ce, 0,  0, 0, 0, 1};
+  const double azimuth[16] = {ca, 0, -sa, 0,  0, 1, 0, 0,  sa, 0, ca, 0,  0, 0, 0, 1};
+
+  double A[16], B[16];
+  MultMatrix(lookat, translate, A);
+  MultMatrix(A, elevation, B);
+  MultMatrix(B, azimuth, M);
+}
+
+/*
+ * The projection matrix PerspectiveDisplay builds with gluPerspective,
+ * for a W by H viewport, column major as in OpenGL
+*/
+void Camera::ProjectionMatrix(int W, int H, double M[16]) const {
+  double f = 1.0 / tan(DegToRad(Fov) / 2);
+  double aspect = (double)W / (double)H;
+
+  for(int i = 0; i < 16; i++)
+    M[i] = 0;
+  M[0] = f / aspect;
+  M[5] = f;
+  M[10] = (FarPlane + NearPlane) / (NearPlane - FarPlane);
+  M[11] = -1;
+  M[14] = 2 * FarPlane * NearPlane / (NearPlane - FarPlane);
+}
+
+/*
+ * The projection times the viewing matrix, taking points straight to
+ * clip coordinates of a W by H viewport, column major as in OpenGL
+*/
+void Camera::ViewProjectionMatrix(int W, int H, double M[16]) const {
+  double view[16], projection[16];
+  ViewMatrix(view);
+  ProjectionMatrix(W, H, projection);
+
+  MultMatrix(projection, view, M);
+}
+
 // Position, aim, and orient the camera in the current modelview frame
 // using updated position, aim, and up vectors
 void Camera::AimCamera(const Vector3d &P, const Vector3d &A, const Vector3d &U){
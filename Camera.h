@@ -96,6 +96,21 @@ public:
   // Uses the current NearPlane, FarPlane, and Fov parameters
   void PerspectiveDisplay(int W, int H);
 
+  // accessors for the current view, so it can be used without OpenGL
+  Vector3d GetPos() const {return Pos;}
+  Vector3d GetAim() const {return Aim;}
+  Vector3d GetUp() const {return Up;}
+  float GetFov() const {return Fov;}
+  float GetNearPlane() const {return NearPlane;}
+  float GetFarPlane() const {return FarPlane;}
+
+  // the matrices AimCamera and PerspectiveDisplay set up, column major as
+  // in OpenGL, for drawing without OpenGL
+  void ViewMatrix(double M[16]) const;
+  void ProjectionMatrix(int W, int H, double M[16]) const;
+  // and the projection times the viewing matrix, taking points to clip coordinates
+  void ViewProjectionMatrix(int W, int H, double M[16]) const;
+
   // Positions camera using current position, aim, and up vector
   void AimCamera();
   // Positions camera and updates position, aim, and up vector
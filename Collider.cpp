@@ -0,0 +1,142 @@
+/*
+* Collider.cpp
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/3/2018
+* Version 1.0
+*
+* A Collider is an object in the scene that particles bounce off of.
+* Colliders are tested after integration, when each active particle has
+* just moved from prev_position to position. Every kind of collider
+* resolves that motion in collide(), moving the particle to where it
+* should be after the bounce and updating its velocity.
+*
+* MeshCollider does continuous collision detection against a triangle
+* mesh: rather than testing whether the particle ended up inside the
+* geometry, it sweeps the segment prev_position -> position through a
+* BVH and bounces off the first triangle crossed. Fast particles with a
+* large timestep can then never tunnel through thin walls.
+*/
+
+#include "Collider.h"
+#include "Particle.h"
+#include "Mesh.h"
+#include "BVH.h"
+#include "Vector.h"
+
+using namespace std;
+
+#define MAXBOUNCES 3		// maximum number of bounces resolved in one timestep
+#define SEPARATION 1.0e-4	// distance particles are kept off of a surface
+
+//-----------------------------------------------------------------
+/*
+Collider::Collider()
+* PURPOSE : Default constructor
+* INPUTS :  NONE
+* OUTPUTS : NONE, sets default bounce parameters
+*/
+//-----------------------------------------------------------------
+
+Collider::Collider()
+{
+   restitution = 0.5;
+   friction = 0.1;
+}
+
+//-----------------------------------------------------------------
+/*
+Collider::setBounceParams(float res, float fr)
+* PURPOSE : Set how particles bounce off of the collider
+* INPUTS :  float res, coefficient of restitution (0 to 1)
+*           float fr, coefficient of friction (0 to 1)
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+void Collider::setBounceParams(float res, float fr)
+{
+   restitution = res;
+   friction = fr;
+}
+
+//-----------------------------------------------------------------
+/*
+Vector3d Collider::bounce(const Vector3d &v, const Vector3d &n)
+* PURPOSE : Reflect a vector off of a surface, scaling the normal
+*           part by restitution and the tangential part by friction
+* INPUTS :  Vector3d v, velocity or displacement
+*           Vector3d n, unit surface normal
+* OUTPUTS : Vector3d, reflected vector
+*/
+//-----------------------------------------------------------------
+
+Vector3d Collider::bounce(const Vector3d &v, const Vector3d &n)
+{
+   Vector3d vn = (v * n) * n;
+   Vector3d vt = v - vn;
+
+   return (1.0 - friction) * vt - restitution * vn;
+}
+
+//-----------------------------------------------------------------
+/*
+MeshCollider::MeshCollider(Mesh *m)
+* PURPOSE : Variable constructor
+* INPUTS :  Mesh *m, triangle mesh, must outlive the collider
+* OUTPUTS : NONE, builds BVH over mesh
+*/
+//-----------------------------------------------------------------
+
+MeshCollider::MeshCollider(Mesh *m)
+{
+   mesh = m;
+   bvh.build(mesh);
+}
+
+//-----------------------------------------------------------------
+/*
+bool MeshCollider::collide(Particle &p)
+* PURPOSE : Sweep the particle's motion over the last timestep
+*           through the mesh. At each triangle crossed, the particle
+*           is stopped at the surface, its velocity is bounced, and
+*           the rest of its motion is bounced the same way and swept
+*           again, up to MAXBOUNCES times.
+* INPUTS :  Particle &p, active particle that has just been integrated
+* OUTPUTS : bool, true if the particle hit the mesh. p.position and
+*           p.velocity are updated
+*/
+//-----------------------------------------------------------------
+
+bool MeshCollider::collide(Particle &p)
+{
+   Vector3d start = p.prev_position;
+   Vector3d end = p.position;
+   bool collided = false;
+
+   for (int b = 0; b < MAXBOUNCES; b++){
+      double s;
+      int tri;
+      if (bvh.intersectSegment(start, end, s, tri) == false)
+         break;
+
+      Vector3d d = end - start;
+      Vector3d n = mesh->triangleNormal(tri);
+      if (n * d > 0)				// Face the normal against the motion
+         n = -n;
+
+      Vector3d hit = start + s * d;
+      Vector3d rest = bounce((1.0 - s) * d, n);
+
+      p.velocity = bounce(p.velocity, n);
+      start = hit + SEPARATION * n;
+      end = start + rest;
+      collided = true;
+
+      if (b == MAXBOUNCES - 1)			// Out of bounces, stay at the surface
+         end = start;
+   }
+
+   p.position = end;
+   return collided;
+}
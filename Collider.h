@@ -0,0 +1,43 @@
+/*
+* Collider.h
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/3/2018
+* Version 1.0
+*/
+
+#ifndef __COLLIDER_H__
+#define __COLLIDER_H__
+
+#include "Vector.h"
+#include "Particle.h"
+#include "Mesh.h"
+#include "BVH.h"
+
+class Collider{				// Base class of all objects particles can collide with
+   protected:
+      float restitution;	// restitution, fraction of normal velocity kept after bounce
+      float friction;		// friction, fraction of tangential velocity lost in bounce
+
+      Vector3d bounce(const Vector3d &v, const Vector3d &n);
+
+   public:
+      Collider();
+
+      void setBounceParams(float res, float fr);
+      virtual bool collide(Particle &p) = 0;
+};
+
+class MeshCollider : public Collider{	// Continuous collision against a triangle mesh
+   private:
+      Mesh* mesh;
+      BVH bvh;
+
+   public:
+      MeshCollider(Mesh *m);
+
+      bool collide(Particle &p);
+      Mesh* getMesh(){return mesh;}
+};
+
+#endif
@@ -0,0 +1,319 @@
+/*
+* DensityRenderer.cpp
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/21/2018
+* Version 1.0
+*
+* With many millions of particles, drawing each as a line costs more than
+* it shows: most lines are a pixel or less long, and pile up on the same
+* pixels. The DensityRenderer instead splats each particle, at its
+* position through the View's Camera, onto the four pixels around it with
+* bilinear weights, adding up its color there. The sums are a density
+* image, which is tone mapped, 1 - exp(-exposure * density) for each of
+* red, green and blue, so that any density shows, and the densest parts
+* go to full brightness without clipping.
+*
+* The image is accumulated in TILESIZE square tiles, in three parallel
+* passes over fixed size chunks of the particles, and one over tiles:
+*   - each chunk projects its particles, and counts how many splats it
+*     has on each tile,
+*   - the counts are summed tile by tile, chunk by chunk, to find where
+*     each chunk puts the splats of each tile,
+*   - each chunk writes its particles to the list of every tile they
+*     splat on, in order,
+*   - each tile is accumulated by one thread, in a small buffer of that
+*     thread's own, then tone mapped into the image.
+* No two threads ever add to the same pixel, so there are no atomics or
+* locks, and every pixel adds its particles in the same order, so the
+* image does not depend on the number of threads.
+*/
+
+#include "DensityRenderer.h"
+#include "Parallel.h"
+#include "Utility.h"
+
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+#define TILESIZE	32	// pixels on a side of a tile
+#define SPLATCHUNK	65536	// particles per chunk when projecting and binning
+
+//-----------------------------------------------------------------
+/*
+DensityRenderer::DensityRenderer(int w, int h)
+* PURPOSE : Constructor, an image of w by h pixels, viewed by a camera
+*           at the origin looking down -z
+* INPUTS :  int w, h, size in pixels
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+DensityRenderer::DensityRenderer(int w, int h)
+{
+   image = NULL;
+   tileStart = NULL;
+   resize(w, h);
+   exposure = 0.25;
+
+   Camera camera;
+   setCamera(camera);
+
+   points = NULL;
+   maxPoints = 0;
+   counts = NULL;
+   maxCounts = 0;
+   records = NULL;
+   maxRecords = 0;
+   tileBuffers = NULL;
+   numTileBuffers = 0;
+}
+
+//-----------------------------------------------------------------
+/*
+void DensityRenderer::resize(int w, int h)
+* PURPOSE : Change the size of the image, it is cleared to black. Call
+*           setCamera() again after, to fit the view to the new size.
+* INPUTS :  int w, h, size in pixels
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+void DensityRenderer::resize(int w, int h)
+{
+   if (image != NULL && w == width && h == height)
+      return;
+
+   width = w;
+   height = h;
+   tilesX = (width + TILESIZE - 1) / TILESIZE;
+   tilesY = (height + TILESIZE - 1) / TILESIZE;
+
+   delete [] image;
+   image = new unsigned char[4 * width * height];
+   for (int i = 0; i < width * height; i++){
+      image[4 * i] = image[4 * i + 1] = image[4 * i + 2] = 0;
+      image[4 * i + 3] = 255;
+   }
+   delete [] tileStart;
+   tileStart = new int[tilesX * tilesY + 1];
+}
+
+//-----------------------------------------------------------------
+/*
+void DensityRenderer::setCamera(const Camera &camera)
+* PURPOSE : View through the camera, as the View does, with the
+*           camera's field of view fitted to the image
+* INPUTS :  const Camera &camera, the camera
+* OUTPUTS : NONE, sets viewProjection
+*/
+//-----------------------------------------------------------------
+
+void DensityRenderer::setCamera(const Camera &camera)
+{
+   camera.ViewProjectionMatrix(width, height, viewProjection);
+}
+
+//-----------------------------------------------------------------
+/*
+static int splatTiles(const SplatPoint &p, int width, int height,
+                      int tilesX, int *tiles)
+* PURPOSE : Find the tiles a particle's splat falls on. The splat covers
+*           the 2 by 2 pixels whose centers surround the particle.
+* INPUTS :  const SplatPoint &p, the particle
+*           int width, height, size of the image
+*           int tilesX, tiles across the image
+*           int *tiles, room for 4 tiles
+* OUTPUTS : int, number of tiles, and the tiles, each once
+*/
+//-----------------------------------------------------------------
+
+static int splatTiles(const SplatPoint &p, int width, int height, int tilesX, int *tiles)
+{
+   int x0 = (int)floor(p.x - 0.5f);
+   int y0 = (int)floor(p.y - 0.5f);
+   if (x0 + 1 < 0 || y0 + 1 < 0 || x0 >= width || y0 >= height)
+      return 0;
+
+   int tx0 = Max(x0, 0) / TILESIZE;
+   int tx1 = Min(x0 + 1, width - 1) / TILESIZE;
+   int ty0 = Max(y0, 0) / TILESIZE;
+   int ty1 = Min(y0 + 1, height - 1) / TILESIZE;
+
+   int n = 0;
+   for (int ty = ty0; ty <= ty1; ty++){
+      for (int tx = tx0; tx <= tx1; tx++){
+         tiles[n] = ty * tilesX + tx;
+         n++;
+      }
+   }
+   return n;
+}
+
+//-----------------------------------------------------------------
+/*
+void DensityRenderer::accumulateTile(int tile, float *buffer)
+* PURPOSE : Add up the splats on a tile, and tone map it into the image
+* INPUTS :  int tile, the tile
+*           float *buffer, RGB of TILESIZE x TILESIZE pixels to work in
+* OUTPUTS : NONE, sets the tile's pixels of the image
+*/
+//-----------------------------------------------------------------
+
+void DensityRenderer::accumulateTile(int tile, float *buffer)
+{
+   int tx0 = (tile % tilesX) * TILESIZE;
+   int ty0 = (tile / tilesX) * TILESIZE;
+   int tx1 = Min(tx0 + TILESIZE, width);
+   int ty1 = Min(ty0 + TILESIZE, height);
+   memset(buffer, 0, 3 * TILESIZE * TILESIZE * sizeof(float));
+
+   for (int r = tileStart[tile]; r < tileStart[tile + 1]; r++){
+      const SplatPoint &p = points[records[r]];
+      float sx = p.x - 0.5f;
+      float sy = p.y - 0.5f;
+      int x0 = (int)floor(sx);
+      int y0 = (int)floor(sy);
+      float fx = sx - x0;
+      float fy = sy - y0;
+      float rgb[3] = {p.color[0] / 255.0f, p.color[1] / 255.0f, p.color[2] / 255.0f};
+
+      for (int dy = 0; dy < 2; dy++){
+         int y = y0 + dy;
+         if (y < ty0 || y >= ty1)
+            continue;
+         float wy = dy? fy : 1.0f - fy;
+         for (int dx = 0; dx < 2; dx++){
+            int x = x0 + dx;
+            if (x < tx0 || x >= tx1)
+               continue;
+            float w = wy * (dx? fx : 1.0f - fx);
+            float *b = buffer + 3 * ((y - ty0) * TILESIZE + (x - tx0));
+            b[0] = b[0] + w * rgb[0];
+            b[1] = b[1] + w * rgb[1];
+            b[2] = b[2] + w * rgb[2];
+         }
+      }
+   }
+
+   for (int y = ty0; y < ty1; y++){
+      for (int x = tx0; x < tx1; x++){
+         const float *b = buffer + 3 * ((y - ty0) * TILESIZE + (x - tx0));
+         unsigned char *pixel = image + 4 * (y * width + x);
+         for (int k = 0; k < 3; k++){
+            pixel[k] = (unsigned char)(255.0f * (1.0f - exp(-exposure * b[k])) + 0.5f);
+         }
+      }
+   }
+}
+
+//-----------------------------------------------------------------
+/*
+void DensityRenderer::draw(const RenderSnapshot &snapshot)
+* PURPOSE : Splat every particle of a snapshot at its position, in the
+*           mean color of its streak, and tone map the density
+* INPUTS :  const RenderSnapshot &snapshot, the particles to draw
+* OUTPUTS : NONE, replaces the image
+*/
+//-----------------------------------------------------------------
+
+void DensityRenderer::draw(const RenderSnapshot &snapshot)
+{
+   int n = snapshot.getNumVertices() / 2;
+   const StreakVertex *vertices = snapshot.getVertices();
+   int numTiles = tilesX * tilesY;
+
+   if (n > maxPoints){
+      delete [] points;
+      maxPoints = Max(n, 2 * maxPoints);
+      points = new SplatPoint[maxPoints];
+   }
+   int numChunks = (n + SPLATCHUNK - 1) / SPLATCHUNK;
+   if (numChunks * numTiles > maxCounts){
+      delete [] counts;
+      maxCounts = numChunks * numTiles;
+      counts = new int[maxCounts];
+   }
+   int numThreads = getNumThreads();
+   if (numThreads > numTileBuffers){
+      delete [] tileBuffers;
+      numTileBuffers = numThreads;
+      tileBuffers = new float[numTileBuffers * 3 * TILESIZE * TILESIZE];
+   }
+
+   // project each chunk of particles, and count their splats on each tile
+   const double *M = viewProjection;
+   parallelFor(numChunks, [&](int c, int worker){
+      int *count = counts + c * numTiles;
+      memset(count, 0, numTiles * sizeof(int));
+
+      int end = Min((c + 1) * SPLATCHUNK, n);
+      for (int i = c * SPLATCHUNK; i < end; i++){
+         const StreakVertex &v0 = vertices[2 * i];
+         const StreakVertex &v1 = vertices[2 * i + 1];
+         const float *q = v1.position;
+         double clip[4];
+         for (int r = 0; r < 4; r++){
+            clip[r] = M[r] * q[0] + M[4 + r] * q[1] + M[8 + r] * q[2] + M[12 + r];
+         }
+
+         SplatPoint &p = points[i];
+         if (clip[3] <= 0.0 || clip[2] < -clip[3] || clip[2] > clip[3]){	// before the near or past the far plane
+            p.x = p.y = -2.0;
+            continue;
+         }
+         p.x = (0.5 + 0.5 * clip[0] / clip[3]) * width;
+         p.y = (0.5 + 0.5 * clip[1] / clip[3]) * height;
+         for (int k = 0; k < 3; k++){
+            float mean = 0.5f * (v0.color[k] + v1.color[k]);
+            p.color[k] = (unsigned char)(Min(Max(mean, 0.0f), 1.0f) * 255.0f + 0.5f);
+         }
+         p.color[3] = 255;
+
+         int tiles[4];
+         int numSplatTiles = splatTiles(p, width, height, tilesX, tiles);
+         for (int t = 0; t < numSplatTiles; t++){
+            count[tiles[t]]++;
+         }
+      }
+   });
+
+   // where each chunk's splats of each tile go, tile by tile, chunk by chunk
+   int total = 0;
+   for (int t = 0; t < numTiles; t++){
+      tileStart[t] = total;
+      for (int c = 0; c < numChunks; c++){
+         int count = counts[c * numTiles + t];
+         counts[c * numTiles + t] = total;
+         total = total + count;
+      }
+   }
+   tileStart[numTiles] = total;
+
+   if (total > maxRecords){
+      delete [] records;
+      maxRecords = Max(total, 2 * maxRecords);
+      records = new int[maxRecords];
+   }
+
+   // list each chunk's particles on the tiles they splat on
+   parallelFor(numChunks, [&](int c, int worker){
+      int *next = counts + c * numTiles;
+      int end = Min((c + 1) * SPLATCHUNK, n);
+      for (int i = c * SPLATCHUNK; i < end; i++){
+         int tiles[4];
+         int numSplatTiles = splatTiles(points[i], width, height, tilesX, tiles);
+         for (int t = 0; t < numSplatTiles; t++){
+            records[next[tiles[t]]] = i;
+            next[tiles[t]]++;
+         }
+      }
+   });
+
+   // add up and tone map each tile, in the buffer of the thread doing it
+   parallelFor(numTiles, [&](int tile, int worker){
+      accumulateTile(tile, tileBuffers + worker * 3 * TILESIZE * TILESIZE);
+   });
+}
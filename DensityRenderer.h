@@ -0,0 +1,56 @@
+/*
+* DensityRenderer.h
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/21/2018
+* Version 1.0
+*/
+
+#ifndef __DENSITYRENDERER_H__
+#define __DENSITYRENDERER_H__
+
+#include "RenderSnapshot.h"
+#include "Camera.h"
+
+struct SplatPoint{		// A particle projected to the screen
+   float x, y;			// pixels, bottom row first, off the screen if not in view
+   unsigned char color[4];	// RGB, and A unused
+};
+
+class DensityRenderer{		// Splats particles into a tone mapped density image, on the CPU
+   private:
+      int width, height;
+      int tilesX, tilesY;	// the image is accumulated in TILESIZE square tiles
+      unsigned char *image;	// RGBA of each pixel, bottom row first
+      float exposure;		// density that maps to 63% of full brightness is 1 / exposure
+
+      double viewProjection[16];	// projection times viewing matrix, column major
+
+      SplatPoint *points;	// particles of the snapshot being drawn
+      int maxPoints;
+      int *counts;		// splats of each chunk of particles on each tile, then where they go
+      int maxCounts;
+      int *records;		// particles splatted on each tile, tile after tile
+      int maxRecords;
+      int *tileStart;		// first record of each tile
+      float *tileBuffers;	// RGB density of a tile, one per worker thread
+      int numTileBuffers;
+
+      void accumulateTile(int tile, float *buffer);
+
+   public:
+      DensityRenderer(int w, int h);
+
+      void resize(int w, int h);
+      int getWidth(){return width;}
+      int getHeight(){return height;}
+      const unsigned char* getImage(){return image;}
+
+      void setExposure(float e){exposure = e;}
+      float getExposure(){return exposure;}
+
+      void setCamera(const Camera &camera);
+      void draw(const RenderSnapshot &snapshot);
+};
+
+#endif
@@ -0,0 +1,170 @@
+/*
+* DepthSort.cpp
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/20/2018
+* Version 1.0
+*
+* Streaks fade from opaque to clear along their length, which only looks
+* right when they are blended over what is behind them, farthest first.
+* DepthSort orders the visible streaks by their distance from the camera
+* every frame. Comparison sorts cost too much at a million streaks a
+* frame, so this is a least significant digit radix sort, 8 bits a pass,
+* over keys made from the distance so that their order as unsigned
+* integers is the order to draw in.
+*
+* Each pass is done in parallel over fixed size chunks of the keys:
+* every chunk counts its digits, the counts are summed digit by digit,
+* chunk by chunk, to find where each chunk puts its keys of each digit,
+* and then every chunk scatters its keys there, in order. Each pass is
+* stable, so keys that tie stay in the order they were given, and the
+* result does not depend on the number of threads. A pass is skipped
+* when every key has the same digit, as the high digits of distances
+* across the scene usually are.
+*/
+
+#include "DepthSort.h"
+#include "Parallel.h"
+#include "Utility.h"
+
+#include <cstring>
+
+using namespace std;
+
+#define SORTCHUNK	65536	// keys per chunk
+#define RADIXBITS	8	// bits of the key sorted on each pass
+#define RADIX		(1 << RADIXBITS)
+
+//-----------------------------------------------------------------
+/*
+DepthSort::DepthSort()
+* PURPOSE : Constructor, nothing is allocated until reserve()
+* INPUTS :  NONE
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+DepthSort::DepthSort()
+{
+   keys = NULL;
+   values = NULL;
+   tmpKeys = NULL;
+   tmpValues = NULL;
+   maxItems = 0;
+   counts = NULL;
+   maxCounts = 0;
+}
+
+//-----------------------------------------------------------------
+/*
+void DepthSort::reserve(int n)
+* PURPOSE : Make room for n keys and values, to be filled in through
+*           getKeys() and getValues(). Their contents are lost when
+*           more room is made.
+* INPUTS :  int n, number of keys
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+void DepthSort::reserve(int n)
+{
+   if (n <= maxItems)
+      return;
+
+   delete [] keys;
+   delete [] values;
+   delete [] tmpKeys;
+   delete [] tmpValues;
+   maxItems = Max(n, 2 * maxItems);
+   keys = new unsigned int[maxItems];
+   values = new int[maxItems];
+   tmpKeys = new unsigned int[maxItems];
+   tmpValues = new int[maxItems];
+}
+
+//-----------------------------------------------------------------
+/*
+void DepthSort::sort(int n)
+* PURPOSE : Sort the first n keys in increasing order, moving each
+*           value with its key. Equal keys keep their order.
+* INPUTS :  int n, number of keys, at most what was reserved
+* OUTPUTS : NONE, getKeys() and getValues() hold the sorted keys and
+*           values
+*/
+//-----------------------------------------------------------------
+
+void DepthSort::sort(int n)
+{
+   int numChunks = (n + SORTCHUNK - 1) / SORTCHUNK;
+   if (numChunks * RADIX > maxCounts){
+      delete [] counts;
+      maxCounts = numChunks * RADIX;
+      counts = new int[maxCounts];
+   }
+
+   for (int shift = 0; shift < 32; shift += RADIXBITS){
+      // count the digits of each chunk
+      parallelFor(numChunks, [&](int c, int worker){
+         int *count = counts + c * RADIX;
+         memset(count, 0, RADIX * sizeof(int));
+         int end = Min((c + 1) * SORTCHUNK, n);
+         for (int i = c * SORTCHUNK; i < end; i++){
+            count[(keys[i] >> shift) & (RADIX - 1)]++;
+         }
+      });
+
+      // where each chunk's keys of each digit go, digit by digit, chunk by chunk
+      int start = 0;
+      bool skip = false;
+      for (int d = 0; d < RADIX; d++){
+         int total = 0;
+         for (int c = 0; c < numChunks; c++){
+            int count = counts[c * RADIX + d];
+            counts[c * RADIX + d] = start + total;
+            total = total + count;
+         }
+         if (total == n)
+            skip = true;		// every key has this digit, the pass changes nothing
+         start = start + total;
+      }
+      if (skip)
+         continue;
+
+      parallelFor(numChunks, [&](int c, int worker){
+         int *next = counts + c * RADIX;
+         int end = Min((c + 1) * SORTCHUNK, n);
+         for (int i = c * SORTCHUNK; i < end; i++){
+            int j = next[(keys[i] >> shift) & (RADIX - 1)]++;
+            tmpKeys[j] = keys[i];
+            tmpValues[j] = values[i];
+         }
+      });
+
+      unsigned int *swapKeys = keys;
+      keys = tmpKeys;
+      tmpKeys = swapKeys;
+      int *swapValues = values;
+      values = tmpValues;
+      tmpValues = swapValues;
+   }
+}
+
+//-----------------------------------------------------------------
+/*
+unsigned int DepthSort::backToFront(float distance)
+* PURPOSE : Key that sorts the farthest first. The bits of a float
+*           order like an unsigned integer once the sign bit is set
+*           for positive numbers, and every bit is flipped for
+*           negative ones. Flipping the result puts the largest first.
+* INPUTS :  float distance, distance from the camera
+* OUTPUTS : unsigned int, the key
+*/
+//-----------------------------------------------------------------
+
+unsigned int DepthSort::backToFront(float distance)
+{
+   unsigned int bits;
+   memcpy(&bits, &distance, sizeof(bits));
+   bits = (bits & 0x80000000u)? ~bits : bits | 0x80000000u;
+   return ~bits;
+}
@@ -0,0 +1,34 @@
+/*
+* DepthSort.h
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/20/2018
+* Version 1.0
+*/
+
+#ifndef __DEPTHSORT_H__
+#define __DEPTHSORT_H__
+
+class DepthSort{		// Parallel radix sort of 32 bit keys, each carrying an int value
+   private:
+      unsigned int *keys;	// keys and values to sort, and the sorted result
+      int *values;
+      unsigned int *tmpKeys;	// where each pass scatters to, swapped with keys after it
+      int *tmpValues;
+      int maxItems;
+      int *counts;		// count of each digit in each chunk, then where the chunk scatters it
+      int maxCounts;
+
+   public:
+      DepthSort();
+
+      void reserve(int n);
+      unsigned int* getKeys(){return keys;}
+      int* getValues(){return values;}
+
+      void sort(int n);
+
+      static unsigned int backToFront(float distance);
+};
+
+#endif
@@ -0,0 +1,214 @@
+/*
+* Emitter.cpp
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/12/2018
+* Version 1.0
+*
+* An Emitter is the shape a ParticleGenerator adds particles from. For
+* each new particle, the emitter picks a random point on (or in) its
+* shape, uniformly by area or volume, and the direction the particle
+* should leave in. The generator then places the particle at its own
+* position plus that point, with a randomized speed along that direction.
+*
+* MeshEmitter emits from the surface of a triangle Mesh. To be uniform
+* over the surface, triangles must be picked with probability in
+* proportion to their area. A search through the running total of areas
+* would cost O(log n) per particle, so instead a Walker/Vose alias table
+* is built once: each triangle gets a slot holding the chance of keeping
+* it, and an alias triangle to take otherwise. Picking a slot at random
+* and flipping one weighted coin costs the same for any size of mesh.
+*/
+
+#include "Emitter.h"
+#include "Mesh.h"
+#include "Vector.h"
+#include "Rng.h"
+
+#include <vector>
+
+using namespace std;
+
+//-----------------------------------------------------------------
+/*
+static void perpendiculars(const Vector3d &n, Vector3d &u, Vector3d &v)
+* PURPOSE : Two unit vectors perpendicular to n and to each other
+*/
+//-----------------------------------------------------------------
+
+static void perpendiculars(const Vector3d &n, Vector3d &u, Vector3d &v)
+{
+   Vector3d other = (Abs(n.x) < 0.9)? Vector3d(1, 0, 0) : Vector3d(0, 1, 0);
+   u = (n % other).normalize();
+   v = n % u;
+}
+
+//-----------------------------------------------------------------
+/*
+* Emitter constructors
+*
+* PURPOSE : Variable constructors, define the shape of each emitter
+* INPUTS :  rad, radius of sphere, disk, or cylinder
+*           n, normal of disk, a, axis of cylinder (need not be unit)
+*           size, dimensions of box, h, height of cylinder
+*           m, mesh to emit from, must outlive the emitter
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+SphereEmitter::SphereEmitter(float rad)
+{
+   radius = rad;
+}
+
+DiskEmitter::DiskEmitter(float rad, Vector3d n)
+{
+   radius = rad;
+   normal = n.normalize();
+   perpendiculars(normal, u, v);
+}
+
+BoxEmitter::BoxEmitter(Vector3d size)
+{
+   halfSize = 0.5 * size;
+}
+
+CylinderEmitter::CylinderEmitter(float rad, float h, Vector3d a)
+{
+   radius = rad;
+   height = h;
+   axis = a.normalize();
+   perpendiculars(axis, u, v);
+}
+
+//-----------------------------------------------------------------
+/*
+MeshEmitter::MeshEmitter(Mesh *m)
+* PURPOSE : Variable constructor, builds the alias table over the
+*           triangle areas with Vose's method
+* INPUTS :  Mesh *m, mesh to emit from, must outlive the emitter
+* OUTPUTS : NONE, fills probability and alias
+*/
+//-----------------------------------------------------------------
+
+MeshEmitter::MeshEmitter(Mesh *m)
+{
+   mesh = m;
+   int nt = mesh->numTriangles;
+   probability = new float[Max(nt, 1)];
+   alias = new int[Max(nt, 1)];
+
+   double total = 0;
+   vector<double> scaled(nt);
+   for (int t = 0; t < nt; t++){
+      scaled[t] = mesh->triangleArea(t);
+      total += scaled[t];
+   }
+
+   vector<int> small, large;			// Scale areas so the average is 1, and split
+   for (int t = 0; t < nt; t++){		// into those below and above average
+      scaled[t] = (total > 0)? scaled[t] * nt / total : 1.0;
+      if (scaled[t] < 1.0)
+         small.push_back(t);
+      else
+         large.push_back(t);
+   }
+
+   while (small.size() > 0 && large.size() > 0){	// Fill each small slot from a large one
+      int s = small.back(); small.pop_back();
+      int l = large.back(); large.pop_back();
+      probability[s] = scaled[s];
+      alias[s] = l;
+      scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+      if (scaled[l] < 1.0)
+         small.push_back(l);
+      else
+         large.push_back(l);
+   }
+   while (large.size() > 0){			// Left over slots (and round off) are kept
+      probability[large.back()] = 1.0;
+      alias[large.back()] = large.back();
+      large.pop_back();
+   }
+   while (small.size() > 0){
+      probability[small.back()] = 1.0;
+      alias[small.back()] = small.back();
+      small.pop_back();
+   }
+}
+
+//-----------------------------------------------------------------
+/*
+* Emitter::sample(Vector3d &offset, Vector3d &direction)
+*
+* PURPOSE : Choose a random emission point on each kind of emitter,
+*           uniform over its area (or volume, for the box)
+* INPUTS :  offset, direction, filled in with the point, relative to
+*           the generator's position, and the unit direction of travel
+*           rng, random numbers of the generator
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+void PointEmitter::sample(Vector3d &offset, Vector3d &direction, Rng &rng)
+{
+   offset.set(0, 0, 0);
+   direction = rng.direction();
+}
+
+void SphereEmitter::sample(Vector3d &offset, Vector3d &direction, Rng &rng)
+{
+   direction = rng.direction();
+   offset = radius * direction;
+}
+
+void DiskEmitter::sample(Vector3d &offset, Vector3d &direction, Rng &rng)
+{
+   double r = radius * sqrt(rng.uniform());	// sqrt keeps points uniform over area
+   double theta = 2.0 * PI * rng.uniform();
+
+   offset = (r * cos(theta)) * u + (r * sin(theta)) * v;
+   direction = normal;
+}
+
+void BoxEmitter::sample(Vector3d &offset, Vector3d &direction, Rng &rng)
+{
+   offset.set(halfSize.x * (2.0 * rng.uniform() - 1.0),
+              halfSize.y * (2.0 * rng.uniform() - 1.0),
+              halfSize.z * (2.0 * rng.uniform() - 1.0));
+   direction = rng.direction();
+}
+
+void CylinderEmitter::sample(Vector3d &offset, Vector3d &direction, Rng &rng)
+{
+   double theta = 2.0 * PI * rng.uniform();
+   double h = height * (rng.uniform() - 0.5);
+
+   direction = cos(theta) * u + sin(theta) * v;
+   offset = radius * direction + h * axis;
+}
+
+void MeshEmitter::sample(Vector3d &offset, Vector3d &direction, Rng &rng)
+{
+   int nt = mesh->numTriangles;
+   if (nt == 0){
+      offset.set(0, 0, 0);
+      direction = rng.direction();
+      return;
+   }
+
+   int t = (int)(rng.uniform() * nt);		// Alias table pick of triangle
+   if (t >= nt)
+      t = nt - 1;
+   if (rng.uniform() >= probability[t])
+      t = alias[t];
+
+   double r1 = sqrt(rng.uniform());		// Uniform point in triangle
+   double r2 = rng.uniform();
+   Vector3d a = mesh->triangleVertex(t, 0);
+   Vector3d b = mesh->triangleVertex(t, 1);
+   Vector3d c = mesh->triangleVertex(t, 2);
+
+   offset = (1.0 - r1) * a + (r1 * (1.0 - r2)) * b + (r1 * r2) * c;
+   direction = mesh->triangleNormal(t);
+}
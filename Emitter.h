@@ -0,0 +1,83 @@
+/*
+* Emitter.h
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/12/2018
+* Version 1.0
+*/
+
+#ifndef __EMITTER_H__
+#define __EMITTER_H__
+
+#include "Vector.h"
+#include "Mesh.h"
+#include "Rng.h"
+
+class Emitter{				// Base class of the shapes a ParticleGenerator emits from
+   public:
+      virtual ~Emitter(){}
+
+      // choose a random point on the shape, relative to the generator's position,
+      // and the unit direction a particle leaving that point travels in, drawing
+      // random numbers from rng
+      virtual void sample(Vector3d &offset, Vector3d &direction, Rng &rng) = 0;
+};
+
+class PointEmitter : public Emitter{	// All particles start at the center, in random directions
+   public:
+      void sample(Vector3d &offset, Vector3d &direction, Rng &rng);
+};
+
+class SphereEmitter : public Emitter{	// Particles leave the surface of a sphere, radially
+   private:
+      float radius;
+
+   public:
+      SphereEmitter(float rad);
+      void sample(Vector3d &offset, Vector3d &direction, Rng &rng);
+};
+
+class DiskEmitter : public Emitter{	// Particles leave a disk, along its normal
+   private:
+      float radius;
+      Vector3d normal;
+      Vector3d u, v;		// u, v, unit vectors spanning the disk
+
+   public:
+      DiskEmitter(float rad, Vector3d n);
+      void sample(Vector3d &offset, Vector3d &direction, Rng &rng);
+};
+
+class BoxEmitter : public Emitter{	// Particles start anywhere inside a box, in random directions
+   private:
+      Vector3d halfSize;
+
+   public:
+      BoxEmitter(Vector3d size);
+      void sample(Vector3d &offset, Vector3d &direction, Rng &rng);
+};
+
+class CylinderEmitter : public Emitter{	// Particles leave the side of a cylinder, radially
+   private:
+      float radius;
+      float height;
+      Vector3d axis;
+      Vector3d u, v;		// u, v, unit vectors perpendicular to the axis
+
+   public:
+      CylinderEmitter(float rad, float h, Vector3d a);
+      void sample(Vector3d &offset, Vector3d &direction, Rng &rng);
+};
+
+class MeshEmitter : public Emitter{	// Particles leave the surface of a mesh, along triangle normals
+   private:
+      Mesh* mesh;
+      float* probability;	// probability, alias table: chance of keeping each triangle
+      int* alias;		// alias, triangle chosen instead when not kept
+
+   public:
+      MeshEmitter(Mesh *m);
+      void sample(Vector3d &offset, Vector3d &direction, Rng &rng);
+};
+
+#endif
@@ -0,0 +1,359 @@
+/*
+* FrameCapture.cpp
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/22/2018
+* Version 1.0
+*
+* Records what the View shows as a numbered sequence of PNG or PPM
+* images, without slowing down the drawing. Reading a frame back with
+* glReadPixels waits until it has been drawn, and writing it to a file
+* takes longer than drawing it, so neither is done while the View waits:
+*   - each frame is read back into one of NUMREADBACKS pixel buffer
+*     objects in turn, which returns without waiting for the drawing,
+*   - by the time that buffer comes round again the frame is there, and
+*     it is copied into a frame of a pool of MAXQUEUEDFRAMES, which is
+*     queued for the writer,
+*   - the writer, a thread of its own, writes the queued frames oldest
+*     first, and hands each back to the pool once it is written.
+* If the writer falls so far behind that the whole pool is queued, the
+* frame is dropped rather than making the View wait, and the number of
+* frames dropped is reported when the recording stops. Without pixel
+* buffer objects (before OpenGL 2.1) frames are read straight into the
+* pool, which waits for the drawing, but they are still written by the
+* writer.
+*/
+
+#define GL_GLEXT_PROTOTYPES		// buffer object entry points
+
+#include "FrameCapture.h"
+#include "ImageFile.h"
+#include "Utility.h"
+
+#ifdef __APPLE__
+#  pragma clang diagnostic ignored "-Wdeprecated-declarations"
+#  include <GLUT/glut.h>
+#else
+#  include <GL/glut.h>
+#endif
+
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+//-----------------------------------------------------------------
+/*
+FrameCapture::FrameCapture()
+* PURPOSE : Constructor, not recording, into capture0000.png, ... Nothing
+*           is allocated, and no thread started, until the first frame.
+* INPUTS :  NONE
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+FrameCapture::FrameCapture():
+   filename("capture.png"), writeFailed(false)
+{
+   recording = false;
+   numFrames = 0;
+   firstFrame = 0;
+   numDropped = 0;
+
+   checked = false;
+   pixelBuffers = false;
+   for (int r = 0; r < NUMREADBACKS; r++){
+      readbacks[r] = 0;
+      readbackSize[r] = 0;
+      readbackWidth[r] = readbackHeight[r] = 0;
+   }
+   nextReadback = 0;
+
+   for (int f = 0; f < MAXQUEUEDFRAMES; f++){
+      frames[f].pixels = NULL;
+      frames[f].size = 0;
+      frames[f].width = frames[f].height = 0;
+      frames[f].number = 0;
+      frames[f].state = FRAMEFREE;
+   }
+   writer = NULL;
+   quitting = false;
+}
+
+//-----------------------------------------------------------------
+/*
+void FrameCapture::start()
+* PURPOSE : Start recording. Frames are numbered on from the last
+*           recording, so they do not replace its files.
+* INPUTS :  NONE
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+void FrameCapture::start()
+{
+   if (recording)
+      return;
+
+   if (writer == NULL)
+      writer = new thread(&FrameCapture::writeFrames, this);
+
+   recording = true;
+   firstFrame = numFrames;
+   numDropped = 0;
+   writeFailed = false;
+   status("FrameCapture:", "recording to", sequenceName(filename.c_str(), firstFrame) + ", ...");
+}
+
+//-----------------------------------------------------------------
+/*
+CapturedFrame* FrameCapture::takeFrame(int width, int height)
+* PURPOSE : Take a free frame of the pool, big enough for a frame of
+*           width by height
+* INPUTS :  int width, height, size of the frame in pixels
+* OUTPUTS : CapturedFrame*, the frame, NULL if none is free
+*/
+//-----------------------------------------------------------------
+
+CapturedFrame* FrameCapture::takeFrame(int width, int height)
+{
+   CapturedFrame *frame = NULL;
+   {
+      lock_guard<mutex> guard(lock);
+      for (int f = 0; f < MAXQUEUEDFRAMES && frame == NULL; f++){
+         if (frames[f].state == FRAMEFREE)
+            frame = &frames[f];
+      }
+   }
+   if (frame == NULL){
+      numDropped++;
+      return NULL;
+   }
+
+   // only this thread touches a free frame, so it may be resized unlocked
+   int size = 4 * width * height;
+   if (size > frame->size){
+      delete [] frame->pixels;
+      frame->pixels = new unsigned char[size];
+      frame->size = size;
+   }
+   frame->width = width;
+   frame->height = height;
+   return frame;
+}
+
+//-----------------------------------------------------------------
+/*
+void FrameCapture::queueFrame(CapturedFrame *frame)
+* PURPOSE : Number a frame that has been read back, and hand it to the
+*           writer
+* INPUTS :  CapturedFrame *frame, the frame, from takeFrame()
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+void FrameCapture::queueFrame(CapturedFrame *frame)
+{
+   frame->number = numFrames;
+   numFrames++;
+   {
+      lock_guard<mutex> guard(lock);
+      frame->state = FRAMEQUEUED;
+   }
+   frameQueued.notify_one();
+}
+
+//-----------------------------------------------------------------
+/*
+void FrameCapture::collect(int r)
+* PURPOSE : Copy the frame read into a pixel buffer object, if it has
+*           one, into a frame of the pool, and queue it
+* INPUTS :  int r, the pixel buffer object
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+void FrameCapture::collect(int r)
+{
+   int width = readbackWidth[r];
+   int height = readbackHeight[r];
+   if (width == 0)
+      return;
+   readbackWidth[r] = readbackHeight[r] = 0;
+
+   CapturedFrame *frame = takeFrame(width, height);
+   if (frame == NULL)
+      return;
+
+   glBindBuffer(GL_PIXEL_PACK_BUFFER, readbacks[r]);
+   const void *data = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+   if (data != NULL){
+      memcpy(frame->pixels, data, 4 * width * height);
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+   }
+   glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+   if (data == NULL){
+      lock_guard<mutex> guard(lock);	// hand the frame back unused
+      frame->state = FRAMEFREE;
+      numDropped++;
+      return;
+   }
+   queueFrame(frame);
+}
+
+//-----------------------------------------------------------------
+/*
+void FrameCapture::capture()
+* PURPOSE : Read back the viewport of the frame just drawn, before the
+*           buffers are swapped, to be written once it is there
+* INPUTS :  NONE
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+void FrameCapture::capture()
+{
+   if (!recording)
+      return;
+   if (writeFailed){
+      error("FrameCapture:", "stopped, a frame could not be written");
+      stop();
+      return;
+   }
+
+   if (!checked){
+      int major = 0, minor = 0;
+      const char *version = (const char *)glGetString(GL_VERSION);
+      const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+      if (version != NULL)
+         sscanf(version, "%d.%d", &major, &minor);
+      pixelBuffers = major > 2 || (major == 2 && minor >= 1) ||
+                     (extensions != NULL && strstr(extensions, "GL_ARB_pixel_buffer_object") != NULL);
+      if (pixelBuffers)
+         glGenBuffers(NUMREADBACKS, readbacks);
+      checked = true;
+   }
+
+   int viewport[4];
+   glGetIntegerv(GL_VIEWPORT, viewport);
+   int width = viewport[2];
+   int height = viewport[3];
+   if (width <= 0 || height <= 0)
+      return;
+
+   glPixelStorei(GL_PACK_ALIGNMENT, 4);
+   if (!pixelBuffers){
+      CapturedFrame *frame = takeFrame(width, height);
+      if (frame != NULL){
+         glReadPixels(viewport[0], viewport[1], width, height, GL_RGBA, GL_UNSIGNED_BYTE, frame->pixels);
+         queueFrame(frame);
+      }
+      return;
+   }
+
+   // the frame read into this buffer NUMREADBACKS frames ago is there by now
+   int r = nextReadback;
+   collect(r);
+
+   glBindBuffer(GL_PIXEL_PACK_BUFFER, readbacks[r]);
+   if (4 * width * height > readbackSize[r]){
+      readbackSize[r] = 4 * width * height;
+      glBufferData(GL_PIXEL_PACK_BUFFER, readbackSize[r], NULL, GL_STREAM_READ);
+   }
+   glReadPixels(viewport[0], viewport[1], width, height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+   glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+   readbackWidth[r] = width;
+   readbackHeight[r] = height;
+   nextReadback = (r + 1) % NUMREADBACKS;
+}
+
+//-----------------------------------------------------------------
+/*
+void FrameCapture::stop()
+* PURPOSE : Stop recording. The frames still being read back are
+*           queued, and the writer goes on writing the queued frames.
+* INPUTS :  NONE
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+void FrameCapture::stop()
+{
+   if (!recording)
+      return;
+
+   for (int k = 0; k < NUMREADBACKS; k++){
+      collect((nextReadback + k) % NUMREADBACKS);	// oldest first
+   }
+   recording = false;
+
+   char msg[128];
+   snprintf(msg, sizeof(msg), "%d frames recorded, %d dropped because writing fell behind",
+            numFrames - firstFrame, numDropped);
+   status("FrameCapture:", msg);
+}
+
+//-----------------------------------------------------------------
+/*
+void FrameCapture::finish()
+* PURPOSE : Stop recording, and wait for every frame to be written. Call
+*           before exiting, while the OpenGL context is still there.
+* INPUTS :  NONE
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+void FrameCapture::finish()
+{
+   stop();
+   if (writer == NULL)
+      return;
+
+   {
+      lock_guard<mutex> guard(lock);
+      quitting = true;
+   }
+   frameQueued.notify_one();
+   writer->join();
+   delete writer;
+   writer = NULL;
+   quitting = false;
+}
+
+//-----------------------------------------------------------------
+/*
+void FrameCapture::writeFrames()
+* PURPOSE : Body of the writer thread: write the queued frames, oldest
+*           first, handing each back to the pool once written, until
+*           told to quit and none are left
+* INPUTS :  NONE
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+void FrameCapture::writeFrames()
+{
+   unique_lock<mutex> guard(lock);
+   while (true){
+      CapturedFrame *frame = NULL;
+      for (int f = 0; f < MAXQUEUEDFRAMES; f++){
+         if (frames[f].state == FRAMEQUEUED && (frame == NULL || frames[f].number < frame->number))
+            frame = &frames[f];
+      }
+      if (frame == NULL){
+         if (quitting)
+            return;
+         frameQueued.wait(guard);
+         continue;
+      }
+
+      frame->state = FRAMEWRITING;
+      guard.unlock();
+      string name = sequenceName(filename.c_str(), frame->number);
+      if (!writeImage(name.c_str(), frame->pixels, frame->width, frame->height, 4, true))
+         writeFailed = true;
+      guard.lock();
+      frame->state = FRAMEFREE;
+   }
+}
@@ -0,0 +1,75 @@
+/*
+* FrameCapture.h
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/22/2018
+* Version 1.0
+*/
+
+#ifndef __FRAMECAPTURE_H__
+#define __FRAMECAPTURE_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#define NUMREADBACKS	3	// frames being read back from OpenGL at once
+#define MAXQUEUEDFRAMES	8	// frames read back and waiting to be written
+
+enum FrameState{		// Who has a frame of the pool
+   FRAMEFREE,			// nobody, the View may read a frame back into it
+   FRAMEQUEUED,			// the writer, when it gets to it
+   FRAMEWRITING			// the writer, writing it
+};
+
+struct CapturedFrame{		// A frame read back from the window
+   unsigned char *pixels;	// RGBA of each pixel, bottom row first
+   int size;			// bytes allocated for pixels
+   int width, height;
+   int number;			// number in the sequence
+   FrameState state;
+};
+
+class FrameCapture{		// Reads back the frames the View draws, and writes them as images on a thread of its own
+   private:
+      std::string filename;	// name of the sequence, the frames are named after it
+      bool recording;
+      int numFrames;		// frames handed to the writer, over every recording
+      int firstFrame;		// number of the first frame of this recording
+      int numDropped;		// frames of this recording dropped because the writer was behind
+
+      bool checked;		// whether OpenGL has been asked if it has pixel buffer objects
+      bool pixelBuffers;	// read back through pixel buffer objects, without waiting for the drawing
+      unsigned int readbacks[NUMREADBACKS];	// pixel buffer objects frames are read into, in turn
+      int readbackSize[NUMREADBACKS];	// bytes allocated for each
+      int readbackWidth[NUMREADBACKS];	// size of the frame being read into each, 0 if none
+      int readbackHeight[NUMREADBACKS];
+      int nextReadback;		// the one to read the next frame into, and the oldest being read
+
+      CapturedFrame frames[MAXQUEUEDFRAMES];	// frames read back, reused once written
+      std::mutex lock;		// guards the frames' states, and quitting
+      std::condition_variable frameQueued;	// wakes the writer
+      std::thread *writer;	// writes the queued frames, oldest first, NULL until started
+      bool quitting;		// tells the writer to stop once every queued frame is written
+      std::atomic<bool> writeFailed;	// set by the writer if a frame could not be written
+
+      CapturedFrame* takeFrame(int width, int height);
+      void queueFrame(CapturedFrame *frame);
+      void collect(int r);
+      void writeFrames();
+
+   public:
+      FrameCapture();
+
+      void setFilename(const char *name){filename = name;}
+      bool isRecording(){return recording;}
+
+      void start();
+      void capture();
+      void stop();
+      void finish();
+};
+
+#endif
@@ -0,0 +1,169 @@
+/*
+* Frustum.cpp
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/19/2018
+* Version 1.0
+*
+* A Frustum is the view volume of a Camera, as six planes: left, right,
+* bottom, top, near and far. The planes are taken from the rows of the
+* camera's projection times viewing matrix (Gribb and Hartmann), so they
+* follow everything that places the camera: its position, aim and up
+* vector, field of view, clipping planes, and the mouse rotations and
+* translations the View applies on top of them.
+*
+* A streak is culled when both of its ends are outside the same plane.
+* This keeps every streak that could be seen, and a few that cross the
+* corners of the frustum but are not. Streaks are tested four at a time
+* with SSE, the ends of four streaks loaded as rows and transposed into
+* x, y and z columns, and each plane applied to all four at once.
+*/
+
+#include "Frustum.h"
+
+#ifdef __SSE__
+#  include <xmmintrin.h>
+#endif
+
+using namespace std;
+
+//-----------------------------------------------------------------
+/*
+Frustum::Frustum()
+* PURPOSE : Constructor, a frustum everything is inside of
+* INPUTS :  NONE
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+Frustum::Frustum()
+{
+   for (int p = 0; p < 6; p++){
+      planes[p][0] = planes[p][1] = planes[p][2] = 0.0;
+      planes[p][3] = 1.0;
+   }
+}
+
+//-----------------------------------------------------------------
+/*
+void Frustum::set(const Camera &camera, int w, int h)
+* PURPOSE : Set the planes to the view volume of a camera
+* INPUTS :  const Camera &camera, the camera
+*           int w, h, size of the viewport it draws into
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+void Frustum::set(const Camera &camera, int w, int h)
+{
+   double M[16];
+   camera.ViewProjectionMatrix(w, h, M);
+   set(M);
+}
+
+//-----------------------------------------------------------------
+/*
+void Frustum::set(const double M[16])
+* PURPOSE : Set the planes from a projection times viewing matrix. A
+*           point is inside when -w <= x, y, z <= w in clip
+*           coordinates, and each of those is a row of M plus or
+*           minus its last row.
+* INPUTS :  const double M[16], the matrix, column major
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+void Frustum::set(const double M[16])
+{
+   for (int axis = 0; axis < 3; axis++){
+      for (int k = 0; k < 4; k++){
+         planes[2 * axis][k] = M[4 * k + 3] + M[4 * k + axis];		// left, bottom, near
+         planes[2 * axis + 1][k] = M[4 * k + 3] - M[4 * k + axis];	// right, top, far
+      }
+   }
+}
+
+//-----------------------------------------------------------------
+/*
+bool Frustum::isVisible(const float *p0, const float *p1) const
+* PURPOSE : Test a streak against the planes
+* INPUTS :  const float *p0, p1, x, y, z of its ends
+* OUTPUTS : bool, false if both ends are outside the same plane
+*/
+//-----------------------------------------------------------------
+
+bool Frustum::isVisible(const float *p0, const float *p1) const
+{
+   for (int p = 0; p < 6; p++){
+      const float *P = planes[p];
+      float d0 = P[0] * p0[0] + P[1] * p0[1] + P[2] * p0[2] + P[3];
+      float d1 = P[0] * p1[0] + P[1] * p1[1] + P[2] * p1[2] + P[3];
+      if (d0 < 0.0 && d1 < 0.0)
+         return false;
+   }
+   return true;
+}
+
+//-----------------------------------------------------------------
+/*
+int Frustum::cullStreaks(const StreakVertex *v, int n, unsigned char *visible) const
+* PURPOSE : Test a run of streaks against the planes
+* INPUTS :  const StreakVertex *v, the streaks, two vertices each
+*           int n, how many streaks
+*           unsigned char *visible, n flags to set
+* OUTPUTS : int, number of streaks that are visible, each flag is set
+*           to 1 if its streak is visible, or 0 if it is culled
+*/
+//-----------------------------------------------------------------
+
+int Frustum::cullStreaks(const StreakVertex *v, int n, unsigned char *visible) const
+{
+   int count = 0;
+   int i = 0;
+
+#ifdef __SSE__
+   __m128 zero = _mm_setzero_ps();
+   for (; i + 4 <= n; i += 4){
+      const StreakVertex *s = v + 2 * i;
+
+      // x, y, z (and a color, unused) of each end, one streak per row,
+      // transposed to one coordinate of the four streaks per register
+      __m128 x0 = _mm_loadu_ps(s[0].position);
+      __m128 y0 = _mm_loadu_ps(s[2].position);
+      __m128 z0 = _mm_loadu_ps(s[4].position);
+      __m128 w0 = _mm_loadu_ps(s[6].position);
+      _MM_TRANSPOSE4_PS(x0, y0, z0, w0);
+      __m128 x1 = _mm_loadu_ps(s[1].position);
+      __m128 y1 = _mm_loadu_ps(s[3].position);
+      __m128 z1 = _mm_loadu_ps(s[5].position);
+      __m128 w1 = _mm_loadu_ps(s[7].position);
+      _MM_TRANSPOSE4_PS(x1, y1, z1, w1);
+
+      __m128 outside = zero;
+      for (int p = 0; p < 6; p++){
+         __m128 a = _mm_set1_ps(planes[p][0]);
+         __m128 b = _mm_set1_ps(planes[p][1]);
+         __m128 c = _mm_set1_ps(planes[p][2]);
+         __m128 d = _mm_set1_ps(planes[p][3]);
+         __m128 d0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, x0), _mm_mul_ps(b, y0)),
+                                _mm_add_ps(_mm_mul_ps(c, z0), d));
+         __m128 d1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, x1), _mm_mul_ps(b, y1)),
+                                _mm_add_ps(_mm_mul_ps(c, z1), d));
+         outside = _mm_or_ps(outside, _mm_and_ps(_mm_cmplt_ps(d0, zero), _mm_cmplt_ps(d1, zero)));
+      }
+
+      int culled = _mm_movemask_ps(outside);
+      for (int k = 0; k < 4; k++){
+         visible[i + k] = !((culled >> k) & 1);
+         count = count + visible[i + k];
+      }
+   }
+#endif
+
+   // the rest, or all of them without SSE
+   for (; i < n; i++){
+      visible[i] = isVisible(v[2 * i].position, v[2 * i + 1].position);
+      count = count + visible[i];
+   }
+   return count;
+}
@@ -0,0 +1,29 @@
+/*
+* Frustum.h
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/19/2018
+* Version 1.0
+*/
+
+#ifndef __FRUSTUM_H__
+#define __FRUSTUM_H__
+
+#include "Camera.h"
+#include "RenderSnapshot.h"
+
+class Frustum{			// The six planes bounding what a Camera sees
+   private:
+      float planes[6][4];	// a, b, c, d, a point is inside if a x + b y + c z + d >= 0
+
+   public:
+      Frustum();
+
+      void set(const Camera &camera, int w, int h);
+      void set(const double M[16]);
+
+      bool isVisible(const float *p0, const float *p1) const;
+      int cullStreaks(const StreakVertex *v, int n, unsigned char *visible) const;
+};
+
+#endif
@@ -0,0 +1,288 @@
+/*
+* ImageFile.cpp
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/22/2018
+* Version 1.0
+*
+* Writes frames, from the SoftRasterizer or read back from the window,
+* as binary PPM or PNG images, and names the frames of a sequence. The
+* PNG is written without compression (deflate stored blocks), which
+* needs no library. These run on whatever thread calls them, and use no
+* parallel loops, so that a writer thread never holds up the drawing.
+*/
+
+#include "ImageFile.h"
+#include "Utility.h"
+
+#include <cstdio>
+#include <vector>
+
+using namespace std;
+
+//-----------------------------------------------------------------
+/*
+static void copyRow(unsigned char *rgb, const unsigned char *pixels, int y,
+                    int width, int height, int components, bool bottomUp)
+* PURPOSE : Copy row y of an image, counting from the top, as RGB
+* INPUTS :  unsigned char *rgb, room for the 3 * width bytes of the row
+*           pixels, width, height, components, bottomUp, the image, as
+*           given to writePPM()
+* OUTPUTS : NONE, fills rgb
+*/
+//-----------------------------------------------------------------
+
+static void copyRow(unsigned char *rgb, const unsigned char *pixels, int y,
+                    int width, int height, int components, bool bottomUp)
+{
+   const unsigned char *row = pixels + (size_t)(bottomUp? height - 1 - y : y) * width * components;
+   for (int x = 0; x < width; x++){
+      rgb[3 * x] = row[components * x];
+      rgb[3 * x + 1] = row[components * x + 1];
+      rgb[3 * x + 2] = row[components * x + 2];
+   }
+}
+
+//-----------------------------------------------------------------
+/*
+bool writePPM(const char *filename, const unsigned char *pixels, int width,
+              int height, int components, bool bottomUp)
+* PURPOSE : Write an image as a binary (P6) PPM image
+* INPUTS :  const char *filename, file to write
+*           const unsigned char *pixels, components bytes per pixel
+*           int width, height, size in pixels
+*           int components, 3 for RGB, 4 for RGBA
+*           bool bottomUp, true if the bottom row comes first
+* OUTPUTS : bool, false if the file could not be written
+*/
+//-----------------------------------------------------------------
+
+bool writePPM(const char *filename, const unsigned char *pixels, int width, int height,
+              int components, bool bottomUp)
+{
+   FILE *file = fopen(filename, "wb");
+   if (file == NULL){
+      error("ImageFile:", "could not write", filename);
+      return false;
+   }
+
+   vector<unsigned char> row(3 * width);
+   fprintf(file, "P6\n%d %d\n255\n", width, height);
+   for (int y = 0; y < height; y++){
+      copyRow(&row[0], pixels, y, width, height, components, bottomUp);
+      fwrite(&row[0], 1, row.size(), file);
+   }
+
+   bool ok = !ferror(file);
+   fclose(file);
+   return ok;
+}
+
+//-----------------------------------------------------------------
+/*
+* PNG helpers
+*
+* PURPOSE : CRC-32 of PNG chunks, Adler-32 of the zlib stream, and
+*           writing a chunk (big endian length, type, data, CRC)
+* INPUTS :  data, size, bytes, crc, adler, running checksums
+*           type, chunk type, file, where to write
+* OUTPUTS : the updated checksum
+*/
+//-----------------------------------------------------------------
+
+struct CRCTable{		// CRC of every byte, made once, on first use, by whichever thread is first
+   unsigned int crc[256];
+   CRCTable(){
+      for (unsigned int n = 0; n < 256; n++){
+         unsigned int c = n;
+         for (int k = 0; k < 8; k++)
+            c = (c & 1)? 0xEDB88320u ^ (c >> 1) : c >> 1;
+         crc[n] = c;
+      }
+   }
+};
+
+static unsigned int crc32(unsigned int crc, const unsigned char *data, size_t size)
+{
+   static const CRCTable table;
+   crc = ~crc;
+   for (size_t i = 0; i < size; i++){
+      crc = table.crc[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+   }
+   return ~crc;
+}
+
+static unsigned int adler32(unsigned int adler, const unsigned char *data, size_t size)
+{
+   unsigned int a = adler & 0xFFFF, b = adler >> 16;
+   while (size > 0){
+      size_t n = Min(size, (size_t)5552);	// most bytes the sums can take before they overflow
+      for (size_t i = 0; i < n; i++){
+         a = a + data[i];
+         b = b + a;
+      }
+      a = a % 65521;
+      b = b % 65521;
+      data = data + n;
+      size = size - n;
+   }
+   return (b << 16) | a;
+}
+
+static void putBigEndian(unsigned char *p, unsigned int v)
+{
+   p[0] = v >> 24;
+   p[1] = v >> 16;
+   p[2] = v >> 8;
+   p[3] = v;
+}
+
+static void writeChunk(FILE *file, const char *type, const unsigned char *data, size_t size)
+{
+   unsigned char header[8];
+   putBigEndian(header, size);
+   for (int k = 0; k < 4; k++)
+      header[4 + k] = type[k];
+
+   unsigned int crc = crc32(0, header + 4, 4);
+   crc = crc32(crc, data, size);
+   unsigned char trailer[4];
+   putBigEndian(trailer, crc);
+
+   fwrite(header, 1, 8, file);
+   if (size > 0)
+      fwrite(data, 1, size, file);
+   fwrite(trailer, 1, 4, file);
+}
+
+//-----------------------------------------------------------------
+/*
+bool writePNG(const char *filename, const unsigned char *pixels, int width,
+              int height, int components, bool bottomUp)
+* PURPOSE : Write an image as an 8 bit RGB PNG image. The image data is
+*           a zlib stream of deflate stored (uncompressed) blocks, each
+*           row starting with filter type 0.
+* INPUTS :  as writePPM()
+* OUTPUTS : bool, false if the file could not be written
+*/
+//-----------------------------------------------------------------
+
+bool writePNG(const char *filename, const unsigned char *pixels, int width, int height,
+              int components, bool bottomUp)
+{
+   FILE *file = fopen(filename, "wb");
+   if (file == NULL){
+      error("ImageFile:", "could not write", filename);
+      return false;
+   }
+
+   // raw image: each row is a filter byte and the RGB of its pixels
+   size_t rowSize = 1 + 3 * width;
+   vector<unsigned char> raw(rowSize * height);
+   for (int y = 0; y < height; y++){
+      raw[y * rowSize] = 0;
+      copyRow(&raw[y * rowSize + 1], pixels, y, width, height, components, bottomUp);
+   }
+
+   // zlib stream of stored blocks of at most 65535 bytes
+   size_t numBlocks = (raw.size() + 65534) / 65535;
+   vector<unsigned char> zlib;
+   zlib.reserve(raw.size() + 5 * numBlocks + 6);
+   zlib.push_back(0x78);		// deflate, 32K window
+   zlib.push_back(0x01);		// no preset dictionary, fastest, check bits
+   for (size_t start = 0; start < raw.size(); start += 65535){
+      size_t size = Min(raw.size() - start, (size_t)65535);
+      zlib.push_back((start + size == raw.size())? 1 : 0);	// last block flag, stored
+      zlib.push_back(size & 0xFF);
+      zlib.push_back(size >> 8);
+      zlib.push_back(~size & 0xFF);
+      zlib.push_back((~size >> 8) & 0xFF);
+      zlib.insert(zlib.end(), raw.begin() + start, raw.begin() + start + size);
+   }
+   unsigned char check[4];
+   putBigEndian(check, adler32(1, &raw[0], raw.size()));
+   zlib.insert(zlib.end(), check, check + 4);
+
+   const unsigned char signature[8] = {137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+   unsigned char ihdr[13];
+   putBigEndian(ihdr, width);
+   putBigEndian(ihdr + 4, height);
+   ihdr[8] = 8;			// bits per component
+   ihdr[9] = 2;			// RGB
+   ihdr[10] = 0;		// deflate
+   ihdr[11] = 0;		// adaptive filtering
+   ihdr[12] = 0;		// not interlaced
+
+   fwrite(signature, 1, 8, file);
+   writeChunk(file, "IHDR", ihdr, 13);
+   writeChunk(file, "IDAT", &zlib[0], zlib.size());
+   writeChunk(file, "IEND", NULL, 0);
+
+   bool ok = !ferror(file);
+   fclose(file);
+   return ok;
+}
+
+//-----------------------------------------------------------------
+/*
+static void splitName(const char *filename, string &prefix, string &ext)
+* PURPOSE : Split a file name at the dot of its extension, if it has one
+*           after its last slash, or else give it the extension .png
+* INPUTS :  const char *filename, the name
+*           string &prefix, string &ext, the two parts
+* OUTPUTS : NONE, sets prefix and ext
+*/
+//-----------------------------------------------------------------
+
+static void splitName(const char *filename, string &prefix, string &ext)
+{
+   prefix = filename;
+   ext = ".png";
+   size_t dot = prefix.rfind('.');
+   size_t slash = prefix.rfind('/');
+   if (dot != string::npos && (slash == string::npos || dot > slash)){
+      ext = prefix.substr(dot);
+      prefix = prefix.substr(0, dot);
+   }
+}
+
+//-----------------------------------------------------------------
+/*
+bool writeImage(const char *filename, const unsigned char *pixels, int width,
+                int height, int components, bool bottomUp)
+* PURPOSE : Write an image as a PPM if the file name ends in .ppm, and
+*           as a PNG otherwise
+* INPUTS :  as writePPM()
+* OUTPUTS : bool, false if the file could not be written
+*/
+//-----------------------------------------------------------------
+
+bool writeImage(const char *filename, const unsigned char *pixels, int width, int height,
+                int components, bool bottomUp)
+{
+   string prefix, ext;
+   splitName(filename, prefix, ext);
+   if (ext == ".ppm" || ext == ".PPM")
+      return writePPM(filename, pixels, width, height, components, bottomUp);
+   return writePNG(filename, pixels, width, height, components, bottomUp);
+}
+
+//-----------------------------------------------------------------
+/*
+string sequenceName(const char *filename, int frame)
+* PURPOSE : Name a frame of a numbered sequence, the number going before
+*           the extension: frame.png gives frame0000.png, frame0001.png
+* INPUTS :  const char *filename, name of the sequence
+*           int frame, number of the frame
+* OUTPUTS : string, name of the frame's file
+*/
+//-----------------------------------------------------------------
+
+string sequenceName(const char *filename, int frame)
+{
+   string prefix, ext;
+   splitName(filename, prefix, ext);
+   char number[16];
+   snprintf(number, sizeof(number), "%04d", frame);
+   return prefix + number + ext;
+}
@@ -0,0 +1,30 @@
+/*
+* ImageFile.h
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/22/2018
+* Version 1.0
+*/
+
+#ifndef __IMAGEFILE_H__
+#define __IMAGEFILE_H__
+
+#include <string>
+
+// write an 8 bit image as a binary (P6) PPM or as a PNG, or as a PPM if
+// the name ends in .ppm and a PNG otherwise. pixels has components bytes
+// per pixel, 3 for RGB or 4 for RGBA (alpha is not written), top row first,
+// or bottom row first, as glReadPixels returns them, if bottomUp. Returns
+// false if the file could not be written
+bool writePPM(const char *filename, const unsigned char *pixels, int width, int height,
+              int components, bool bottomUp);
+bool writePNG(const char *filename, const unsigned char *pixels, int width, int height,
+              int components, bool bottomUp);
+bool writeImage(const char *filename, const unsigned char *pixels, int width, int height,
+                int components, bool bottomUp);
+
+// name of a frame of a numbered sequence named after filename, frame.png
+// gives frame0000.png, frame0001.png, ...
+std::string sequenceName(const char *filename, int frame);
+
+#endif
@@ -0,0 +1,188 @@
+/*
+* Mesh.cpp
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/2/2018
+* Version 1.0
+*
+* Mesh holds triangle geometry that particles may collide with or be
+* emitted from. To keep the data compact and easy to hand to a BVH or
+* to GL, the mesh is stored as two flat arrays:
+*
+* vertices, 3 floats (x, y, z) per vertex
+* indices,  3 ints per triangle, indexing into vertices
+*
+* Meshes are either built in code (see addQuad) or read from a file.
+*/
+
+#include "Mesh.h"
+#include "Vector.h"
+
+using namespace std;
+
+//-----------------------------------------------------------------
+/*
+Mesh::Mesh()
+* PURPOSE : Default constructor
+* INPUTS :  NONE
+* OUTPUTS : NONE, initializes empty Mesh
+*/
+//-----------------------------------------------------------------
+
+Mesh::Mesh()
+{
+   numVertices = 0;
+   numTriangles = 0;
+   vertices = NULL;
+   indices = NULL;
+}
+
+//-----------------------------------------------------------------
+/*
+Mesh::Mesh(int nv, int nt)
+* PURPOSE : Variable constructor
+* INPUTS :  int nv, number of vertices
+*           int nt, number of triangles
+* OUTPUTS : NONE, allocates vertex and index arrays
+*/
+//-----------------------------------------------------------------
+
+Mesh::Mesh(int nv, int nt)
+{
+   numVertices = 0;
+   numTriangles = 0;
+   vertices = NULL;
+   indices = NULL;
+   resize(nv, nt);
+}
+
+//-----------------------------------------------------------------
+/*
+Mesh::resize(int nv, int nt)
+* PURPOSE : Change the number of vertices and triangles, keeping
+*           the contents that still fit
+* INPUTS :  int nv, number of vertices
+*           int nt, number of triangles
+* OUTPUTS : NONE, reallocates vertices and indices
+*/
+//-----------------------------------------------------------------
+
+void Mesh::resize(int nv, int nt)
+{
+   float *v = new float[3 * nv];
+   int *ix = new int[3 * nt];
+
+   for (int i = 0; i < 3 * Min(nv, numVertices); i++){
+      v[i] = vertices[i];
+   }
+   for (int i = 0; i < 3 * Min(nt, numTriangles); i++){
+      ix[i] = indices[i];
+   }
+
+   delete [] vertices;
+   delete [] indices;
+
+   vertices = v;
+   indices = ix;
+   numVertices = nv;
+   numTriangles = nt;
+}
+
+//-----------------------------------------------------------------
+/*
+* Mesh accessors
+*
+* PURPOSE : Set and get vertices and triangles in the flat arrays
+* INPUTS :  i, vertex or triangle index
+*           t, triangle index, k, corner of triangle (0, 1 or 2)
+* OUTPUTS : Vector3d vertex positions
+*/
+//-----------------------------------------------------------------
+
+void Mesh::setVertex(int i, Vector3d v)
+{
+   vertices[3 * i] = v.x;
+   vertices[3 * i + 1] = v.y;
+   vertices[3 * i + 2] = v.z;
+}
+
+void Mesh::setTriangle(int i, int a, int b, int c)
+{
+   indices[3 * i] = a;
+   indices[3 * i + 1] = b;
+   indices[3 * i + 2] = c;
+}
+
+Vector3d Mesh::getVertex(int i)
+{
+   return Vector3d(vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2]);
+}
+
+Vector3d Mesh::triangleVertex(int t, int k)
+{
+   return getVertex(indices[3 * t + k]);
+}
+
+//-----------------------------------------------------------------
+/*
+Vector3d Mesh::triangleNormal(int t)
+* PURPOSE : Compute unit normal of a triangle, following the
+*           counterclockwise winding of its vertices
+* INPUTS :  int t, triangle index
+* OUTPUTS : Vector3d, unit normal
+*/
+//-----------------------------------------------------------------
+
+Vector3d Mesh::triangleNormal(int t)
+{
+   Vector3d a = triangleVertex(t, 0);
+   Vector3d b = triangleVertex(t, 1);
+   Vector3d c = triangleVertex(t, 2);
+
+   return ((b - a) % (c - a)).normalize();
+}
+
+//-----------------------------------------------------------------
+/*
+float Mesh::triangleArea(int t)
+* PURPOSE : Compute area of a triangle
+* INPUTS :  int t, triangle index
+* OUTPUTS : float, area
+*/
+//-----------------------------------------------------------------
+
+float Mesh::triangleArea(int t)
+{
+   Vector3d a = triangleVertex(t, 0);
+   Vector3d b = triangleVertex(t, 1);
+   Vector3d c = triangleVertex(t, 2);
+
+   return 0.5 * ((b - a) % (c - a)).norm();
+}
+
+//-----------------------------------------------------------------
+/*
+Mesh::addQuad(Vector3d a, Vector3d b, Vector3d c, Vector3d d)
+* PURPOSE : Append a quadrilateral to the mesh as two triangles,
+*           used to build simple colliders (floors, walls) in code
+* INPUTS :  Vector3d a, b, c, d, corners in counterclockwise order
+*           seen from the front of the quad
+* OUTPUTS : NONE, adds 4 vertices and 2 triangles
+*/
+//-----------------------------------------------------------------
+
+void Mesh::addQuad(Vector3d a, Vector3d b, Vector3d c, Vector3d d)
+{
+   int v0 = numVertices;
+   int t0 = numTriangles;
+
+   resize(numVertices + 4, numTriangles + 2);
+
+   setVertex(v0, a);
+   setVertex(v0 + 1, b);
+   setVertex(v0 + 2, c);
+   setVertex(v0 + 3, d);
+
+   setTriangle(t0, v0, v0 + 1, v0 + 2);
+   setTriangle(t0 + 1, v0, v0 + 2, v0 + 3);
+}
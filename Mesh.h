@@ -0,0 +1,34 @@
+/*
+* Mesh.h
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/2/2018
+* Version 1.0
+*/
+
+#ifndef __MESH_H__
+#define __MESH_H__
+
+#include "Vector.h"
+
+class Mesh{				// Mesh arrays are made public for benefit of the View and colliders
+	public:
+		int numVertices;
+		int numTriangles;
+		float* vertices;	// vertices, flat array of x, y, z for each vertex
+		int* indices;		// indices, flat array of three vertex indeces for each triangle
+
+		Mesh();
+		Mesh(int nv, int nt);
+
+		void resize(int nv, int nt);
+		void setVertex(int i, Vector3d v);
+		void setTriangle(int i, int a, int b, int c);
+		Vector3d getVertex(int i);
+		Vector3d triangleVertex(int t, int k);
+		Vector3d triangleNormal(int t);
+		float triangleArea(int t);
+		void addQuad(Vector3d a, Vector3d b, Vector3d c, Vector3d d);
+};
+
+#endif
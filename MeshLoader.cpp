@@ -0,0 +1,765 @@
+/*
+* MeshLoader.cpp
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/5/2018
+* Version 1.0
+*
+* MeshLoader reads triangle meshes from Wavefront OBJ files and from
+* binary PLY files into a Mesh, so that colliders and emitters can use
+* geometry made outside of the program. Meshes with a million or more
+* triangles are common, so the loader is built for speed:
+*
+* - The file is memory mapped rather than read through a stream, so it
+*   is never copied and the operating system pages it in as it is used.
+*
+* - OBJ text is cut into chunks of about a megabyte at line boundaries,
+*   and the chunks are parsed on all threads at once. Each chunk keeps
+*   its own vertex and triangle lists; once every chunk is parsed, the
+*   counts are summed to find where each chunk's data goes, and the
+*   chunks are copied into the Mesh, again in parallel. Polygons are
+*   split into triangle fans, and negative (relative) OBJ indeces are
+*   resolved against the vertex count at the chunk's start.
+*
+* - PLY vertex records have a fixed size, so they are converted in
+*   parallel directly from the mapped file. Faces are checked (in
+*   parallel) to all be triangles, in which case they also have a fixed
+*   size and are converted in parallel, otherwise faces are read one at
+*   a time and split into triangle fans.
+*
+* Only positions and faces are read; normals, texture coordinates and
+* other properties are skipped.
+*/
+
+#include "MeshLoader.h"
+#include "Mesh.h"
+#include "Parallel.h"
+#include "Utility.h"
+
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sstream>
+
+#ifdef WIN32
+#  include <cstdio>
+#else
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+using namespace std;
+
+#define CHUNKSIZE (1 << 20)	// bytes of OBJ text parsed per chunk
+#define PLYCHUNK 65536		// PLY vertices or faces converted per chunk
+#define MAXCORNERS 64		// most corners of an OBJ polygon
+
+//-----------------------------------------------------------------
+/*
+MeshLoader::MeshLoader()
+* PURPOSE : Default constructor
+* INPUTS :  NONE
+* OUTPUTS : NONE, initializes MeshLoader with no file
+*/
+//-----------------------------------------------------------------
+
+MeshLoader::MeshLoader()
+{
+   data = NULL;
+   size = 0;
+   mapped = false;
+}
+
+//-----------------------------------------------------------------
+/*
+bool MeshLoader::mapFile(const char *filename)
+* PURPOSE : Memory map a file for reading (or read it into memory
+*           where mapping is not available)
+* INPUTS :  const char *filename, name of file
+* OUTPUTS : bool, true if the file could be mapped, sets data and size
+*/
+//-----------------------------------------------------------------
+
+bool MeshLoader::mapFile(const char *filename)
+{
+#ifdef WIN32
+   FILE *fp = fopen(filename, "rb");
+   if (fp == NULL)
+      return false;
+
+   fseek(fp, 0, SEEK_END);
+   size = ftell(fp);
+   fseek(fp, 0, SEEK_SET);
+
+   char *buffer = new char[size + 1];
+   size_t got = fread(buffer, 1, size, fp);
+   fclose(fp);
+   if (got != size || size == 0){
+      delete [] buffer;
+      return false;
+   }
+
+   data = buffer;
+   mapped = false;
+#else
+   int fd = open(filename, O_RDONLY);
+   if (fd < 0)
+      return false;
+
+   struct stat st;
+   if (fstat(fd, &st) < 0 || st.st_size == 0){
+      close(fd);
+      return false;
+   }
+   size = st.st_size;
+
+   void *p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);					// The mapping stays valid after close
+   if (p == MAP_FAILED)
+      return false;
+   madvise(p, size, MADV_WILLNEED);		// Start paging in ahead of the parsers
+
+   data = (const char *)p;
+   mapped = true;
+#endif
+
+   return true;
+}
+
+//-----------------------------------------------------------------
+/*
+void MeshLoader::unmapFile()
+* PURPOSE : Release the file mapped by mapFile
+* INPUTS :  NONE
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+void MeshLoader::unmapFile()
+{
+#ifndef WIN32
+   if (mapped)
+      munmap((void *)data, size);
+   else
+#endif
+      delete [] data;
+
+   data = NULL;
+   size = 0;
+   mapped = false;
+}
+
+//-----------------------------------------------------------------
+/*
+bool MeshLoader::load(const char *filename, Mesh *mesh)
+* PURPOSE : Load a mesh from an OBJ or binary PLY file. PLY files are
+*           recognized by their "ply" header, anything else is read
+*           as OBJ.
+* INPUTS :  const char *filename, name of mesh file
+*           Mesh *mesh, mesh to fill, its old contents are replaced
+* OUTPUTS : bool, true if the mesh was loaded, otherwise an error is
+*           printed and mesh is left empty
+*/
+//-----------------------------------------------------------------
+
+bool MeshLoader::load(const char *filename, Mesh *mesh)
+{
+   mesh->resize(0, 0);
+
+   if (mapFile(filename) == false){
+      error("cannot open mesh file", filename);
+      return false;
+   }
+
+   bool loaded;
+   if (size >= 4 && strncmp(data, "ply", 3) == 0 && (data[3] == '\n' || data[3] == '\r'))
+      loaded = loadPLY(mesh);
+   else
+      loaded = loadOBJ(mesh);
+
+   unmapFile();
+
+   if (loaded == false){
+      error("cannot read mesh file", filename);
+      mesh->resize(0, 0);
+   }
+
+   return loaded;
+}
+
+//*****************************************************************
+// OBJ parsing
+//*****************************************************************
+
+struct OBJChunk{
+   const char* begin;		// begin, end, text of the chunk
+   const char* end;
+   vector<float> vertices;	// vertices, x, y, z of vertices in the chunk
+   vector<int> indices;		// indices, 3 per triangle, 0 based
+   vector<int> relative;	// relative, positions in indices relative to the chunk's first vertex
+   int vertexStart;		// vertexStart, triangleStart, where the chunk goes in the Mesh
+   int triangleStart;
+   bool ok;			// ok, false on a parse error, or an index out of range
+};
+
+static inline bool isBlank(char c)
+{
+   return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline void skipBlanks(const char *&p, const char *end)
+{
+   while (p < end && isBlank(*p))
+      p++;
+}
+
+static inline void skipLine(const char *&p, const char *end)
+{
+   const char *nl = (const char *)memchr(p, '\n', end - p);
+   p = (nl == NULL)? end : nl + 1;
+}
+
+//-----------------------------------------------------------------
+/*
+static bool parseInt(const char *&p, const char *end, int &value)
+static bool parseFloat(const char *&p, const char *end, float &value)
+* PURPOSE : Parse a number from text, much faster than strtod since
+*           OBJ numbers are simple decimal numbers
+* INPUTS :  const char *&p, start of number, advanced past it
+*           const char *end, end of text
+*           value, set to the number read
+* OUTPUTS : bool, true if a number was read
+*/
+//-----------------------------------------------------------------
+
+static bool parseInt(const char *&p, const char *end, int &value)
+{
+   bool negative = false;
+   if (p < end && (*p == '-' || *p == '+')){
+      negative = (*p == '-');
+      p++;
+   }
+   if (p >= end || *p < '0' || *p > '9')
+      return false;
+
+   long v = 0;
+   while (p < end && *p >= '0' && *p <= '9'){
+      v = 10 * v + (*p - '0');
+      p++;
+   }
+   value = negative? -v : v;
+   return true;
+}
+
+static bool parseFloat(const char *&p, const char *end, float &value)
+{
+   static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+                                   1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18};
+
+   bool negative = false;
+   if (p < end && (*p == '-' || *p == '+')){
+      negative = (*p == '-');
+      p++;
+   }
+
+   uint64_t mantissa = 0;
+   int digits = 0;
+   int exponent = 0;
+   bool any = false;
+   while (p < end && *p >= '0' && *p <= '9'){	// Integer part
+      if (digits < 18){
+         mantissa = 10 * mantissa + (*p - '0');
+         if (mantissa > 0)
+            digits++;
+      }
+      else
+         exponent++;
+      p++;
+      any = true;
+   }
+   if (p < end && *p == '.'){			// Fractional part
+      p++;
+      while (p < end && *p >= '0' && *p <= '9'){
+         if (digits < 18){
+            mantissa = 10 * mantissa + (*p - '0');
+            if (mantissa > 0)
+               digits++;
+            exponent--;
+         }
+         p++;
+         any = true;
+      }
+   }
+   if (any == false)
+      return false;
+
+   if (p < end && (*p == 'e' || *p == 'E')){	// Exponent
+      p++;
+      int e;
+      if (parseInt(p, end, e) == false)
+         return false;
+      exponent += e;
+   }
+
+   double v = (double)mantissa;
+   if (exponent < 0)
+      v = (exponent >= -18)? v / powers[-exponent] : v * pow(10.0, exponent);
+   else if (exponent > 0)
+      v = (exponent <= 18)? v * powers[exponent] : v * pow(10.0, exponent);
+
+   value = negative? -v : v;
+   return true;
+}
+
+//-----------------------------------------------------------------
+/*
+static void parseOBJChunk(OBJChunk &chunk)
+* PURPOSE : Parse the vertex (v) and face (f) lines of one chunk of an
+*           OBJ file into the chunk's own lists. Other lines are skipped.
+* INPUTS :  OBJChunk &chunk, chunk with begin and end set
+* OUTPUTS : NONE, fills chunk lists, chunk.ok is false on a parse error
+*/
+//-----------------------------------------------------------------
+
+static void parseOBJChunk(OBJChunk &chunk)
+{
+   const char *p = chunk.begin;
+   const char *end = chunk.end;
+   int numVertices = 0;
+   int corners[MAXCORNERS];
+   bool isRelative[MAXCORNERS];
+
+   chunk.ok = true;
+
+   while (p < end){
+      skipBlanks(p, end);
+      if (end - p < 2 || isBlank(p[1]) == false){	// Not a v or f line
+         skipLine(p, end);
+         continue;
+      }
+
+      if (*p == 'v'){
+         p += 2;
+         for (int k = 0; k < 3; k++){
+            float x;
+            skipBlanks(p, end);
+            if (parseFloat(p, end, x) == false){
+               chunk.ok = false;
+               return;
+            }
+            chunk.vertices.push_back(x);
+         }
+         numVertices++;
+      }
+      else if (*p == 'f'){
+         p += 2;
+         int n = 0;
+         while (true){
+            skipBlanks(p, end);
+            if (p >= end || *p == '\n' || *p == '#')
+               break;
+
+            int index;
+            if (parseInt(p, end, index) == false || index == 0 || n == MAXCORNERS){
+               chunk.ok = false;
+               return;
+            }
+            while (p < end && *p != '\n' && isBlank(*p) == false)	// Skip /texture/normal
+               p++;
+
+            if (index > 0){
+               corners[n] = index - 1;
+               isRelative[n] = false;
+            }
+            else{					// Relative to vertices read so far
+               corners[n] = numVertices + index;
+               isRelative[n] = true;
+            }
+            n++;
+         }
+
+         for (int k = 1; k + 1 < n; k++){		// Split polygon into a fan
+            int fan[3] = {0, k, k + 1};
+            for (int j = 0; j < 3; j++){
+               if (isRelative[fan[j]])
+                  chunk.relative.push_back(chunk.indices.size());
+               chunk.indices.push_back(corners[fan[j]]);
+            }
+         }
+      }
+
+      skipLine(p, end);
+   }
+}
+
+//-----------------------------------------------------------------
+/*
+bool MeshLoader::loadOBJ(Mesh *mesh)
+* PURPOSE : Parse the mapped file as OBJ, in parallel chunks
+* INPUTS :  Mesh *mesh, mesh to fill
+* OUTPUTS : bool, true if the file was read without error
+*/
+//-----------------------------------------------------------------
+
+bool MeshLoader::loadOBJ(Mesh *mesh)
+{
+   const char *end = data + size;
+   int numChunks = (size + CHUNKSIZE - 1) / CHUNKSIZE;
+   vector<OBJChunk> chunks(numChunks);
+
+   const char *p = data;			// Cut text into chunks at line boundaries
+   for (int c = 0; c < numChunks; c++){
+      chunks[c].begin = p;
+      const char *q = Min(data + (size_t)(c + 1) * CHUNKSIZE, end);
+      if (q < end)
+         skipLine(q, end);
+      chunks[c].end = q;
+      p = q;
+   }
+
+   parallelFor(numChunks, [&chunks](int c, int worker){
+      parseOBJChunk(chunks[c]);
+   });
+
+   int numVertices = 0;				// Find where each chunk goes
+   int numTriangles = 0;
+   for (int c = 0; c < numChunks; c++){
+      if (chunks[c].ok == false)
+         return false;
+      chunks[c].vertexStart = numVertices;
+      chunks[c].triangleStart = numTriangles;
+      numVertices += chunks[c].vertices.size() / 3;
+      numTriangles += chunks[c].indices.size() / 3;
+   }
+
+   mesh->resize(numVertices, numTriangles);
+
+   parallelFor(numChunks, [&chunks, mesh, numVertices](int c, int worker){
+      OBJChunk &chunk = chunks[c];
+      if (chunk.vertices.size() > 0)
+         memcpy(&mesh->vertices[3 * chunk.vertexStart], &chunk.vertices[0], chunk.vertices.size() * sizeof(float));
+
+      int *ix = &mesh->indices[3 * chunk.triangleStart];
+      for (size_t i = 0; i < chunk.indices.size(); i++)
+         ix[i] = chunk.indices[i];
+      for (size_t i = 0; i < chunk.relative.size(); i++)
+         ix[chunk.relative[i]] += chunk.vertexStart;
+
+      for (size_t i = 0; i < chunk.indices.size(); i++){
+         if (ix[i] < 0 || ix[i] >= numVertices)
+            chunk.ok = false;
+      }
+   });
+
+   for (int c = 0; c < numChunks; c++){		// Each chunk checked its own indices
+      if (chunks[c].ok == false)
+         return false;
+   }
+
+   return true;
+}
+
+//*****************************************************************
+// PLY parsing
+//*****************************************************************
+
+enum PLYType {PLY_NONE, PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16, PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64};
+
+struct PLYProperty{
+   string name;
+   PLYType type;		// type, value type, or index type of a list
+   PLYType countType;		// countType, type of the length of a list, PLY_NONE if not a list
+};
+
+struct PLYElement{
+   string name;
+   long count;
+   vector<PLYProperty> properties;
+};
+
+static PLYType plyType(const string &name)
+{
+   if (name == "char" || name == "int8") return PLY_INT8;
+   if (name == "uchar" || name == "uint8") return PLY_UINT8;
+   if (name == "short" || name == "int16") return PLY_INT16;
+   if (name == "ushort" || name == "uint16") return PLY_UINT16;
+   if (name == "int" || name == "int32") return PLY_INT32;
+   if (name == "uint" || name == "uint32") return PLY_UINT32;
+   if (name == "float" || name == "float32") return PLY_FLOAT32;
+   if (name == "double" || name == "float64") return PLY_FLOAT64;
+   return PLY_NONE;
+}
+
+static int plySize(PLYType type)
+{
+   static const int sizes[] = {0, 1, 1, 2, 2, 4, 4, 4, 8};
+   return sizes[type];
+}
+
+//-----------------------------------------------------------------
+/*
+static double plyValue(const char *p, PLYType type, bool swap)
+* PURPOSE : Read one binary PLY value of any type
+* INPUTS :  const char *p, location of value
+*           PLYType type, type of value
+*           bool swap, true if the file's byte order is not the machine's
+* OUTPUTS : double, value read
+*/
+//-----------------------------------------------------------------
+
+static double plyValue(const char *p, PLYType type, bool swap)
+{
+   unsigned char b[8];
+   int n = plySize(type);
+   for (int i = 0; i < n; i++)
+      b[i] = p[swap? n - 1 - i : i];
+
+   switch (type){
+      case PLY_INT8:    {int8_t v; memcpy(&v, b, 1); return v;}
+      case PLY_UINT8:   {uint8_t v; memcpy(&v, b, 1); return v;}
+      case PLY_INT16:   {int16_t v; memcpy(&v, b, 2); return v;}
+      case PLY_UINT16:  {uint16_t v; memcpy(&v, b, 2); return v;}
+      case PLY_INT32:   {int32_t v; memcpy(&v, b, 4); return v;}
+      case PLY_UINT32:  {uint32_t v; memcpy(&v, b, 4); return v;}
+      case PLY_FLOAT32: {float v; memcpy(&v, b, 4); return v;}
+      case PLY_FLOAT64: {double v; memcpy(&v, b, 8); return v;}
+      default:          return 0;
+   }
+}
+
+//-----------------------------------------------------------------
+/*
+static bool skipPLYProperty(const char *&p, const char *end, const PLYProperty &prop, bool swap)
+* PURPOSE : Step over one property of a record, which may be a list
+* INPUTS :  const char *&p, start of property, advanced past it
+*           const char *end, end of file
+*           PLYProperty &prop, description of property
+*           bool swap, true if byte order must be swapped
+* OUTPUTS : bool, false if the property runs past the end of the file
+*/
+//-----------------------------------------------------------------
+
+static bool skipPLYProperty(const char *&p, const char *end, const PLYProperty &prop, bool swap)
+{
+   long n = 1;
+   if (prop.countType != PLY_NONE){
+      if (p + plySize(prop.countType) > end)
+         return false;
+      n = (long)plyValue(p, prop.countType, swap);
+      p += plySize(prop.countType);
+   }
+   if (n < 0 || p + n * plySize(prop.type) > end)
+      return false;
+   p += n * plySize(prop.type);
+
+   return true;
+}
+
+//-----------------------------------------------------------------
+/*
+bool MeshLoader::loadPLY(Mesh *mesh)
+* PURPOSE : Parse the mapped file as binary PLY. Reads the x, y, z
+*           properties of the vertex element and the vertex_indices
+*           list of the face element, skipping everything else.
+* INPUTS :  Mesh *mesh, mesh to fill
+* OUTPUTS : bool, true if the file was read without error
+*/
+//-----------------------------------------------------------------
+
+bool MeshLoader::loadPLY(Mesh *mesh)
+{
+   const char *end = data + size;
+   const char *header = data;			// Header is text, body is binary
+   while (header < end && strncmp(header, "end_header", Min((size_t)10, (size_t)(end - header))) != 0)
+      skipLine(header, end);
+   if (end - header < 10)
+      return false;
+   const char *body = header;
+   skipLine(body, end);
+
+   istringstream lines(string(data, header - data));
+   string line;
+   string format;
+   vector<PLYElement> elements;
+
+   while (getline(lines, line)){				// Read header
+      istringstream words(line);
+      string keyword;
+      words >> keyword;
+      if (keyword == "format"){
+         words >> format;
+      }
+      else if (keyword == "element"){
+         PLYElement e;
+         words >> e.name >> e.count;
+         elements.push_back(e);
+      }
+      else if (keyword == "property" && elements.size() > 0){
+         PLYProperty prop;
+         string type;
+         words >> type;
+         if (type == "list"){
+            string countType, indexType;
+            words >> countType >> indexType;
+            prop.countType = plyType(countType);
+            prop.type = plyType(indexType);
+            if (prop.countType == PLY_NONE)
+               return false;
+         }
+         else{
+            prop.countType = PLY_NONE;
+            prop.type = plyType(type);
+         }
+         words >> prop.name;
+         if (prop.type == PLY_NONE)
+            return false;
+         elements.back().properties.push_back(prop);
+      }
+   }
+
+   const int one = 1;
+   bool littleEndian = (*(const char *)&one == 1);
+   bool swap;
+   if (format == "binary_little_endian")
+      swap = !littleEndian;
+   else if (format == "binary_big_endian")
+      swap = littleEndian;
+   else{
+      error("only binary PLY files are supported, not", format);
+      return false;
+   }
+
+   const char *p = body;
+   for (size_t ei = 0; ei < elements.size(); ei++){
+      PLYElement &e = elements[ei];
+
+      int stride = 0;				// Record size, if all properties are fixed size
+      bool fixed = true;
+      int listAt = -1;
+      int offset[3] = {-1, -1, -1};
+      PLYType type[3] = {PLY_NONE, PLY_NONE, PLY_NONE};
+      PLYProperty *list = NULL;
+      for (size_t i = 0; i < e.properties.size(); i++){
+         PLYProperty &prop = e.properties[i];
+         if (prop.countType != PLY_NONE){
+            if (list != NULL || (prop.name != "vertex_indices" && prop.name != "vertex_index"))
+               fixed = false;
+            list = &prop;
+            listAt = stride;
+            stride += plySize(prop.countType) + 3 * plySize(prop.type);	// if a triangle
+            continue;
+         }
+         int axis = (prop.name == "x")? 0 : (prop.name == "y")? 1 : (prop.name == "z")? 2 : -1;
+         if (axis >= 0){
+            offset[axis] = stride;
+            type[axis] = prop.type;
+         }
+         stride += plySize(prop.type);
+      }
+
+      if (e.name == "vertex"){
+         if (list != NULL || offset[0] < 0 || offset[1] < 0 || offset[2] < 0)
+            return false;
+         if (p + (size_t)e.count * stride > end)
+            return false;
+
+         mesh->resize((int)e.count, mesh->numTriangles);
+         const char *records = p;
+         int numChunks = (e.count + PLYCHUNK - 1) / PLYCHUNK;
+         parallelFor(numChunks, [&](int c, int worker){
+            long last = Min((long)(c + 1) * PLYCHUNK, e.count);
+            for (long v = (long)c * PLYCHUNK; v < last; v++){
+               const char *r = records + v * stride;
+               for (int k = 0; k < 3; k++)
+                  mesh->vertices[3 * v + k] = plyValue(r + offset[k], type[k], swap);
+            }
+         });
+         p += (size_t)e.count * stride;
+      }
+      else if (e.name == "face"){
+         if (list == NULL)
+            return false;
+
+         int countSize = plySize(list->countType);
+         int indexSize = plySize(list->type);
+         const char *records = p;
+
+         bool triangles = fixed && (p + (size_t)e.count * stride <= end);
+         int numChunks = (e.count + PLYCHUNK - 1) / PLYCHUNK;
+         if (triangles){				// Check that every face is a triangle
+            vector<char> allTriangles(numChunks, 1);
+            parallelFor(numChunks, [&](int c, int worker){
+               long last = Min((long)(c + 1) * PLYCHUNK, e.count);
+               for (long f = (long)c * PLYCHUNK; f < last; f++){
+                  if (plyValue(records + f * stride + listAt, list->countType, swap) != 3){
+                     allTriangles[c] = 0;
+                     return;
+                  }
+               }
+            });
+            for (int c = 0; c < numChunks; c++)
+               triangles = triangles && allTriangles[c];
+         }
+
+         if (triangles){				// Fixed size faces, convert in parallel
+            mesh->resize(mesh->numVertices, (int)e.count);
+            parallelFor(numChunks, [&](int c, int worker){
+               long last = Min((long)(c + 1) * PLYCHUNK, e.count);
+               for (long f = (long)c * PLYCHUNK; f < last; f++){
+                  const char *r = records + f * stride + listAt + countSize;
+                  for (int k = 0; k < 3; k++)
+                     mesh->indices[3 * f + k] = (int)plyValue(r + k * indexSize, list->type, swap);
+               }
+            });
+            p += (size_t)e.count * stride;
+         }
+         else{						// Polygons, read one face at a time
+            vector<int> indices;
+            for (long f = 0; f < e.count; f++){
+               for (size_t i = 0; i < e.properties.size(); i++){
+                  PLYProperty &prop = e.properties[i];
+                  if (&prop != list){
+                     if (skipPLYProperty(p, end, prop, swap) == false)
+                        return false;
+                     continue;
+                  }
+                  if (p + countSize > end)
+                     return false;
+                  long n = (long)plyValue(p, list->countType, swap);
+                  p += countSize;
+                  if (p + n * indexSize > end)
+                     return false;
+                  for (long k = 1; k + 1 < n; k++){
+                     indices.push_back((int)plyValue(p, list->type, swap));
+                     indices.push_back((int)plyValue(p + k * indexSize, list->type, swap));
+                     indices.push_back((int)plyValue(p + (k + 1) * indexSize, list->type, swap));
+                  }
+                  p += n * indexSize;
+               }
+            }
+            mesh->resize(mesh->numVertices, indices.size() / 3);
+            if (indices.size() > 0)
+               memcpy(mesh->indices, &indices[0], indices.size() * sizeof(int));
+         }
+      }
+      else{						// Some other element, skip it
+         for (long r = 0; r < e.count; r++){
+            for (size_t i = 0; i < e.properties.size(); i++){
+               if (skipPLYProperty(p, end, e.properties[i], swap) == false)
+                  return false;
+            }
+         }
+      }
+   }
+
+   for (int i = 0; i < 3 * mesh->numTriangles; i++){
+      if (mesh->indices[i] < 0 || mesh->indices[i] >= mesh->numVertices)
+         return false;
+   }
+
+   return true;
+}
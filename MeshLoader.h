@@ -0,0 +1,33 @@
+/*
+* MeshLoader.h
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/5/2018
+* Version 1.0
+*/
+
+#ifndef __MESHLOADER_H__
+#define __MESHLOADER_H__
+
+#include <cstddef>
+
+#include "Mesh.h"
+
+class MeshLoader{
+   private:
+      const char* data;		// data, contents of the file, memory mapped
+      size_t size;		// size, length of data in bytes
+      bool mapped;		// mapped, true if data is a memory mapping, false if read into memory
+
+      bool mapFile(const char *filename);
+      void unmapFile();
+      bool loadOBJ(Mesh *mesh);
+      bool loadPLY(Mesh *mesh);
+
+   public:
+      MeshLoader();
+
+      bool load(const char *filename, Mesh *mesh);
+};
+
+#endif
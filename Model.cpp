@@ -14,10 +14,15 @@
 #include "Particle.h"
 #include "ParticleList.h"
 #include "ParticleGenerator.h"
+#include "Mesh.h"
+#include "Collider.h"
+#include "MeshLoader.h"
+#include "SDFCollider.h"
 
 #include <cstdlib>
 #include <cstdio>
 #include <cmath>
+#include <chrono>
 
 
 using namespace std;
@@ -32,6 +37,36 @@ Model::Model()
 //-----------------------------------------------------------------
 
 Model::Model(){
+  reorderInterval = 0;	// Morton reordering is off until toggled on
+  sceneMesh = NULL;
+  collider = NULL;
+
+  // curl noise on a 32^3 grid tiling every 20 units, drifting upward
+  turbulence = new Turbulence(32, 20.0, 4.0);
+  turbulence->setScroll(Vector3d(0.0, 1.5, 0.0));
+  turbulenceOn = true;
+
+  budget = new Budget(1000.0 / 30.0);	// hold 30 frames per second
+  budgetOn = true;
+
+  seed = 1;
+  deterministic = false;
+
+  stageTiming = false;	// stages are timed only while the HUD is shown
+  numSteps = 0;
+  for (int s = 0; s < NUMSIMSTAGES; s++)
+     stageTime[s] = 0.0;
+
+  snapshots = new RenderSnapshot[3];	// nothing to draw until the first step
+  frontSnapshot = 0;
+  middleSnapshot = 1;
+  backSnapshot = 2;
+
+  simThread = NULL;	// steps are taken by the caller until startThread()
+  quitting = false;
+  messageHead = 0;
+  messageTail = 0;
+
   initSimulation();
 }
 
@@ -76,6 +111,8 @@ void Model::initSimulation(){
    pg.setSpeedParams(mean_s, s_range);
    pg.setLifespanParams(mean_ls, ls_range);
    pg.setRadius(rad);
+   pg.setColors(Vector4d(1, 0.894, 0.2, 1.0), Vector4d(0.760, 0.043, 0, 0.0));
+   pg.setPriority(2);		// throttled last when over the frame budget
 //--------------------------------------------------------
 
    Vector3d x2;
@@ -96,6 +133,8 @@ void Model::initSimulation(){
    pg2.setSpeedParams(mean_s2, s_range2);
    pg2.setLifespanParams(mean_ls2, ls_range2);
    pg2.setRadius(rad2);
+   pg2.setColors(Vector4d(0.231, 0.125, 0.796, 1.0), Vector4d(0.705, 0.960, 0.619, 0.0));
+   pg2.setPriority(1);
 //--------------------------------------------------------
    Vector3d x3;
    x3.set(-18.0, -5.0, 4.0);
@@ -115,11 +154,29 @@ void Model::initSimulation(){
    pg3.setSpeedParams(mean_s3, s_range3);
    pg3.setLifespanParams(mean_ls3, ls_range3);
    pg3.setRadius(rad3);
+   pg3.setColors(Vector4d(0.878, 0, 0.807, 1.0), Vector4d(0.964, 0.713, 0.215, 0.0));
+   pg3.setPriority(0);		// throttled first
+
+   pg.setSeed(Rng::stream(seed, 0));		// each generator draws its own random numbers
+   pg2.setSeed(Rng::stream(seed, 1));
+   pg3.setSeed(Rng::stream(seed, 2));
 
    generators[0] = pg;
    generators[1] = pg2;
    generators[2] = pg3;
+
+   // particles of the second generator burst into sparks, in the third's list, when they die
+   SubEmitter sparks(ON_DEATH, 4, generators[2].getParticleList());
+   sparks.setSpeedParams(4.0, 2.0, 0.3);
+   sparks.setLifespanParams(0.4, 0.2);
+   sparks.setColors(Vector4d(1, 1, 0.8, 1.0), Vector4d(1, 0.5, 0.1, 0.0));
+   generators[1].addSubEmitter(sparks);
 //*****************************************************
+
+   if (collider == NULL){	// colliders are built only once
+      buildColliders();
+   }
+
    for (int i = 0; i < numGenerators; i++){
       ParticleList *pl = generators[i].getParticleList();
       pl->clear();
@@ -131,6 +188,98 @@ void Model::initSimulation(){
    t = 0.0; 		// current time
    n = 0;		// current step
 
+   steps = 0;		// reset reordering statistics
+   updateTime = 0.0;
+   unsortedTime = 0.0;
+
+   budget->reset();
+
+   publishSnapshot();	// nothing to draw until the first step
+
+}
+
+//-----------------------------------------------------------------
+/*
+Model::buildColliders()
+* PURPOSE : Build the geometry in the scene that particles collide
+*           with: a floor below the generators, and a thin wall in
+*           the path of the fast particles of the second generator
+* INPUTS :  NONE
+* OUTPUTS : NONE, defines sceneMesh and collider
+*/
+//-----------------------------------------------------------------
+
+void Model::buildColliders(){
+
+//***** DEFINE COLLIDERS HERE **************************
+   sceneMesh = new Mesh();
+
+   sceneMesh->addQuad(Vector3d(-40.0, -12.0, 40.0), Vector3d(40.0, -12.0, 40.0),	// floor
+                      Vector3d(40.0, -12.0, -40.0), Vector3d(-40.0, -12.0, -40.0));
+   sceneMesh->addQuad(Vector3d(24.0, -12.0, 15.0), Vector3d(24.0, -12.0, -15.0),	// wall
+                      Vector3d(24.0, 12.0, -15.0), Vector3d(24.0, 12.0, 15.0));
+
+   collider = new MeshCollider(sceneMesh);
+   collider->setBounceParams(0.4, 0.2);
+//*****************************************************
+}
+
+//-----------------------------------------------------------------
+/*
+Model::loadColliderMesh(const char *filename)
+* PURPOSE : Replace the scene colliders with a mesh read from an OBJ
+*           or binary PLY file
+* INPUTS :  const char *filename, name of mesh file
+* OUTPUTS : bool, true if the mesh was loaded, otherwise the scene
+*           colliders are left as they were
+*/
+//-----------------------------------------------------------------
+
+bool Model::loadColliderMesh(const char *filename){
+   MeshLoader loader;
+   Mesh *mesh = new Mesh();
+
+   double start = wallclock();
+   if (loader.load(filename, mesh) == false){
+      delete mesh;
+      return false;
+   }
+   double loaded = wallclock();
+
+   MeshCollider *meshCollider = new MeshCollider(mesh);
+   meshCollider->setBounceParams(0.4, 0.2);
+   double built = wallclock();
+
+   char msg[256];
+   snprintf(msg, sizeof(msg), "%d vertices, %d triangles, load %.1f ms, BVH %.1f ms",
+            mesh->numVertices, mesh->numTriangles, 1000.0 * (loaded - start), 1000.0 * (built - loaded));
+   status("Loaded", filename, msg);
+
+   sceneMesh = mesh;
+   collider = meshCollider;
+   return true;
+}
+
+//-----------------------------------------------------------------
+/*
+Model::useSDFColliders(const char *cachefile)
+* PURPOSE : Collide with a signed distance field baked from the scene
+*           mesh, rather than with the mesh itself, so that the cost of
+*           collisions does not grow with the number of triangles
+* INPUTS :  const char *cachefile, file the field is cached in, NULL
+*           to always bake it
+* OUTPUTS : NONE, replaces collider
+*/
+//-----------------------------------------------------------------
+
+void Model::useSDFColliders(const char *cachefile){
+   if (sceneMesh == NULL)
+      return;
+
+   SDFCollider *sdfCollider = new SDFCollider(sceneMesh, 128, cachefile);
+   sdfCollider->setBounceParams(0.4, 0.2);
+
+   collider = sdfCollider;
 }
 
 //-----------------------------------------------------------------
@@ -145,18 +294,400 @@ Model::timeStep()
 void Model::timeStep(){
 
   if(running){
+     double start = wallclock();
+     bool timing = stageTiming;
+     double lap = start;
+
      for (int i = 0; i < numGenerators; i++)
      {   
-        generators[i].generateParticles(t, h);	// generate particles
         generators[i].testAndDeactivate(h, t);  	// deactivate dead particles
-        generators[i].computeAccelerations(drag);	// compute accelerations of particles
+        generators[i].computeAccelerations(drag, turbulenceOn? turbulence : NULL, t);	// compute accelerations of particles
         generators[i].integrate(h);			// Euler integration
+        if (timing)
+           lapStage(STAGE_UPDATE, lap);
+        generators[i].generateParticles(t, h);	// generate particles born during the step
+        if (timing)
+           lapStage(STAGE_EMIT, lap);
+        if (collider != NULL)
+           generators[i].collide(collider);		// bounce off of scene geometry
+        if (timing)
+           lapStage(STAGE_COLLIDE, lap);
         n = n + 1;				// update time
         t = n * h; 
      }
+
+     updateTime = updateTime + (wallclock() - start);
+     steps = steps + 1;
+     numSteps = numSteps + 1;
+
+     if (reorderInterval > 0 && steps % reorderInterval == 0){
+        if (timing)
+           lap = wallclock();
+        reorderParticles();
+        if (timing)
+           lapStage(STAGE_REORDER, lap);
+     }
+
+     if (budgetOn)
+        budget->update(generators, numGenerators);	// throttle generators if frames are too slow
+
+     publishSnapshot();
   }
 }
 
+//-----------------------------------------------------------------
+/*
+Model::lapStage()
+* PURPOSE : Add the time since the last lap to a stage of the step, for
+*           the HUD, and start the next lap
+* INPUTS :  SimStage stage, the stage that just ended
+*           double &lap, wall clock time the stage started
+* OUTPUTS : None, adds to stageTime, and sets lap to now
+*/
+//-----------------------------------------------------------------
+
+void Model::lapStage(SimStage stage, double &lap){
+  double now = wallclock();
+  stageTime[stage] = stageTime[stage] + (now - lap);
+  lap = now;
+}
+
+//-----------------------------------------------------------------
+/*
+Model::publishSnapshot()
+Model::acquireSnapshot()
+Model::hasNewSnapshot()
+*
+* PURPOSE : Hand the particles to the View through a triple buffer of
+*           RenderSnapshots. The Model captures each step into the back
+*           snapshot and swaps it with the middle one, marked fresh. The
+*           View, when the middle one is fresh, swaps it with the front
+*           one, and draws the front one. Each side only swaps with the
+*           middle, so neither ever waits for the other, and the View
+*           always draws the most recent complete step.
+* INPUTS :  None
+* OUTPUTS : acquireSnapshot, the snapshot to draw, hasNewSnapshot, true
+*           if a step has been published since the last acquire
+*/
+//-----------------------------------------------------------------
+
+#define FRESHSNAPSHOT 4		// marks the middle snapshot as not yet read
+
+void Model::publishSnapshot(){
+  ParticleList **lists = new ParticleList*[numGenerators];
+  for (int i = 0; i < numGenerators; i++)
+     lists[i] = generators[i].getParticleList();
+
+  bool timing = stageTiming;
+  double lap = timing? wallclock() : 0.0;
+  snapshots[backSnapshot].capture(lists, numGenerators, t);
+  if (timing)
+     lapStage(STAGE_CAPTURE, lap);		// shows in the next snapshot
+  snapshots[backSnapshot].setStepTimes(numSteps, stageTime);
+  backSnapshot = middleSnapshot.exchange(backSnapshot | FRESHSNAPSHOT, std::memory_order_acq_rel) & ~FRESHSNAPSHOT;
+
+  delete [] lists;
+}
+
+const RenderSnapshot* Model::acquireSnapshot(){
+  if (middleSnapshot.load(std::memory_order_relaxed) & FRESHSNAPSHOT)
+     frontSnapshot = middleSnapshot.exchange(frontSnapshot, std::memory_order_acq_rel) & ~FRESHSNAPSHOT;
+
+  return &snapshots[frontSnapshot];
+}
+
+bool Model::hasNewSnapshot(){
+  return (middleSnapshot.load(std::memory_order_relaxed) & FRESHSNAPSHOT) != 0;
+}
+
+//-----------------------------------------------------------------
+/*
+Model::startThread()
+Model::stopThread()
+*
+* PURPOSE : Start taking steps on a thread of its own, so that they do
+*           not wait for drawing, or stop it, waiting for the step in
+*           progress to finish
+* INPUTS :  None
+* OUTPUTS : None
+*/
+//-----------------------------------------------------------------
+
+void Model::startThread(){
+  if (simThread != NULL)
+     return;
+
+  quitting = false;
+  simThread = new std::thread(&Model::simulate, this);
+}
+
+void Model::stopThread(){
+  if (simThread == NULL)
+     return;
+
+  quitting = true;
+  simThread->join();
+  delete simThread;
+  simThread = NULL;
+}
+
+//-----------------------------------------------------------------
+/*
+Model::post(ModelMessage message)
+* PURPOSE : Send a command to the simulation thread, which carries it
+*           out between steps. The messages are a ring written only by
+*           the controller and read only by the simulation thread, so
+*           neither needs a lock. Without a thread the command is
+*           carried out right away.
+* INPUTS :  ModelMessage message, the command
+* OUTPUTS : None
+*/
+//-----------------------------------------------------------------
+
+void Model::post(ModelMessage message){
+  if (simThread == NULL){
+     handleMessage(message);
+     return;
+  }
+
+  int tail = messageTail.load(std::memory_order_relaxed);
+  int next = (tail + 1) % MAXMESSAGES;
+  if (next == messageHead.load(std::memory_order_acquire)){
+     error("Model:", "too many messages waiting for the simulation thread, ignored");
+     return;
+  }
+  messages[tail] = message;
+  messageTail.store(next, std::memory_order_release);
+}
+
+//-----------------------------------------------------------------
+/*
+Model::handleMessage(int message)
+* PURPOSE : Carry out a command from the controller
+* INPUTS :  int message, a ModelMessage
+* OUTPUTS : None
+*/
+//-----------------------------------------------------------------
+
+void Model::handleMessage(int message){
+  switch (message){
+     case START_SIMULATION:
+        initSimulation();
+        startSimulation();
+        break;
+     case TOGGLE_REORDERING:
+        toggleReordering();
+        break;
+     case TOGGLE_TURBULENCE:
+        toggleTurbulence();
+        break;
+     case TOGGLE_BUDGET:
+        toggleBudget();
+        break;
+  }
+}
+
+//-----------------------------------------------------------------
+/*
+Model::simulate()
+* PURPOSE : Body of the simulation thread: carry out the messages
+*           waiting, and take a step, paced so that simulation time
+*           keeps up with, but does not run ahead of, the clock. If the
+*           steps fall behind, the time lost is not made up.
+* INPUTS :  None
+* OUTPUTS : None, runs until stopThread()
+*/
+//-----------------------------------------------------------------
+
+void Model::simulate(){
+  typedef std::chrono::steady_clock Clock;
+  Clock::time_point next = Clock::now();
+
+  while (!quitting){
+     int head = messageHead.load(std::memory_order_relaxed);
+     while (head != messageTail.load(std::memory_order_acquire)){
+        handleMessage(messages[head]);
+        head = (head + 1) % MAXMESSAGES;
+        messageHead.store(head, std::memory_order_release);
+     }
+
+     if (!running){		// nothing to do until started
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        next = Clock::now();
+        continue;
+     }
+
+     timeStep();
+
+     next = next + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(h));
+     Clock::time_point now = Clock::now();
+     if (next < now)
+        next = now;
+     else
+        std::this_thread::sleep_until(next);
+  }
+}
+
+//-----------------------------------------------------------------
+/*
+Model::reorderParticles()
+* PURPOSE : Sort the particles of every generator into Morton order,
+*           and report the cost of the sort and the time per step
+*           spent since the last reorder, compared with the time per
+*           step before the first reorder (unsorted storage)
+* INPUTS :  None
+* OUTPUTS : None, reorders particles, prints timing status
+*/
+//-----------------------------------------------------------------
+
+void Model::reorderParticles(){
+  double start = wallclock();
+  int numActive = 0;
+  for (int i = 0; i < numGenerators; i++){
+     numActive = numActive + generators[i].reorderMorton();
+  }
+  double sortms = 1000.0 * (wallclock() - start);
+
+  double stepms = 1000.0 * updateTime / reorderInterval;
+  if (unsortedTime == 0.0)		// first window ran on unsorted storage
+     unsortedTime = stepms;
+  updateTime = 0.0;
+
+  char msg[256];
+  snprintf(msg, sizeof(msg), "%d active, sort %.3f ms, step %.3f ms (unsorted %.3f ms, %.2fx)",
+           numActive, sortms, stepms, unsortedTime, unsortedTime / Max(stepms, SMALLNUMBER));
+  status("Morton reorder:", msg);
+}
+
+//-----------------------------------------------------------------
+/*
+Model::toggleReordering()
+* PURPOSE : Turn periodic Morton reordering of particles on or off
+* INPUTS :  None
+* OUTPUTS : None, changes reorderInterval and resets timing statistics
+*/
+//-----------------------------------------------------------------
+
+void Model::toggleReordering(){
+  if (reorderInterval > 0)
+     reorderInterval = 0;
+  else
+     reorderInterval = 50;	// reorder every 50 steps
+
+  steps = 0;
+  updateTime = 0.0;
+  unsortedTime = 0.0;
+}
+
+//-----------------------------------------------------------------
+/*
+Model::toggleBudget()
+* PURPOSE : Turn the frame time budget on or off. Turning it off
+*           releases all generator throttles.
+* INPUTS :  None
+* OUTPUTS : None, changes budgetOn
+*/
+//-----------------------------------------------------------------
+
+void Model::toggleBudget(){
+  if (deterministic)		// frame times would make runs differ
+     return;
+
+  budgetOn = !budgetOn;
+  budget->reset();
+
+  if (!budgetOn){
+     for (int i = 0; i < numGenerators; i++)
+        generators[i].setThrottle(1.0, 1.0);
+  }
+}
+
+//-----------------------------------------------------------------
+/*
+Model::setDeterministic(bool on)
+* PURPOSE : Turn deterministic mode on or off. Random numbers and slot
+*           assignment only ever depend on the seed, the generator, and
+*           the step, but the budget throttles generators by the measured
+*           frame time, so in deterministic mode the budget is off.
+* INPUTS :  bool on, true for deterministic mode
+* OUTPUTS : None, changes deterministic and budgetOn
+*/
+//-----------------------------------------------------------------
+
+void Model::setDeterministic(bool on){
+  deterministic = on;
+  budgetOn = !on;
+  budget->reset();
+
+  for (int i = 0; i < numGenerators; i++)
+     generators[i].setThrottle(1.0, 1.0);
+}
+
+//-----------------------------------------------------------------
+/*
+static void hashBytes(unsigned long long &hash, const void *data, size_t size)
+* PURPOSE : Add bytes to a 64 bit FNV-1a hash
+* INPUTS :  hash, running hash, data, size, bytes to add
+* OUTPUTS : None, updates hash
+*/
+//-----------------------------------------------------------------
+
+static void hashBytes(unsigned long long &hash, const void *data, size_t size){
+  const unsigned char *bytes = (const unsigned char *)data;
+  for (size_t i = 0; i < size; i++){
+     hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+  }
+}
+
+//-----------------------------------------------------------------
+/*
+Model::hashState()
+* PURPOSE : Hash the full state of every particle list: each active
+*           particle, its attribute channels, and the inactive stack.
+*           Two runs that agree bit for bit have the same hash.
+* INPUTS :  None
+* OUTPUTS : unsigned long long, 64 bit FNV-1a hash
+*/
+//-----------------------------------------------------------------
+
+unsigned long long Model::hashState(){
+  unsigned long long hash = 0xCBF29CE484222325ull;
+
+  for (int g = 0; g < numGenerators; g++){
+     ParticleList *pl = generators[g].getParticleList();
+     int np = pl->getNumParticles();
+
+     for (int i = 0; i < np; i++){
+        Particle &p = pl->particles[i];
+        hashBytes(hash, &p.isActive, sizeof(p.isActive));
+        if (!p.isActive)
+           continue;
+
+        // field by field, the padding inside Particle is not hashed
+        hashBytes(hash, &p.position, sizeof(p.position));
+        hashBytes(hash, &p.prev_position, sizeof(p.prev_position));
+        hashBytes(hash, &p.velocity, sizeof(p.velocity));
+        hashBytes(hash, &p.acceleration, sizeof(p.acceleration));
+        hashBytes(hash, &p.mass, sizeof(p.mass));
+        hashBytes(hash, &p.timestamp, sizeof(p.timestamp));
+        hashBytes(hash, &p.lifespan, sizeof(p.lifespan));
+
+        for (int c = 0; c < NUMCHANNELS; c++){
+           char *data = (char *)pl->getChannel((AttributeChannel)c);
+           if (data != NULL){
+              int size = ParticleList::channelSize((AttributeChannel)c);
+              hashBytes(hash, data + (size_t)i * size, size);
+           }
+        }
+     }
+
+     hashBytes(hash, &pl->inactiveCount, sizeof(pl->inactiveCount));
+     hashBytes(hash, pl->inactiveStack, pl->inactiveCount * sizeof(int));
+  }
+
+  return hash;
+}
+
 //-----------------------------------------------------------------
 /*
 Model::startSimulation()
@@ -168,4 +699,5 @@ Model::startSimulation()
 
 void Model::startSimulation(){
   running = true;
+  budget->reset();		// time before the start is not a frame
 }
@@ -12,6 +12,23 @@
 #include "Particle.h"
 #include "ParticleList.h"
 #include "ParticleGenerator.h"
+#include "Mesh.h"
+#include "Collider.h"
+#include "Turbulence.h"
+#include "Budget.h"
+#include "RenderSnapshot.h"
+
+#include <atomic>
+#include <thread>
+
+enum ModelMessage{		// Commands the controller sends the simulation thread
+  START_SIMULATION,		// reinitialize and start
+  TOGGLE_REORDERING,
+  TOGGLE_TURBULENCE,
+  TOGGLE_BUDGET
+};
+
+#define MAXMESSAGES 64		// messages that may wait for the simulation thread
 
 class Model{
   private:
@@ -22,7 +39,7 @@ class Model{
     int numParticles;	// total number of particles in system
 
 
-    bool running;	// flag to start simulation
+    std::atomic<bool> running;	// flag to start simulation
     float t;		// t, Current time
     int n;		// number timesteps
 
@@ -31,6 +48,48 @@ class Model{
     ParticleGenerator pg3;
 
     int numGenerators;
+
+    Mesh *sceneMesh;		// sceneMesh, geometry particles collide with
+    Collider *collider;		// collider, resolves collisions with sceneMesh, NULL if none
+
+    Turbulence *turbulence;	// turbulence, precomputed curl noise acceleration
+    bool turbulenceOn;		// flag to apply turbulence
+
+    void buildColliders();
+
+    Budget *budget;		// budget, throttles generators to hold the frame time
+    bool budgetOn;		// flag to apply the budget
+
+    unsigned long long seed;	// seed, random numbers of every generator derive from it
+    bool deterministic;	// flag for runs that repeat exactly, budget is kept off
+
+    int reorderInterval;	// reorder particles in Morton order every reorderInterval steps, 0 = off
+    int steps;		// number of steps since the simulation or reordering was (re)started
+    double updateTime;	// time spent in timeStep since the last reorder
+    double unsortedTime;	// ms per step before the first reorder, for comparison
+
+    void reorderParticles();
+
+    std::atomic<bool> stageTiming;	// stageTiming, flag to time the stages of each step for the HUD
+    long long numSteps;	// numSteps, steps taken since the Model was made
+    double stageTime[NUMSIMSTAGES];	// stageTime, seconds spent in each stage while timed
+
+    void lapStage(SimStage stage, double &lap);
+
+    RenderSnapshot *snapshots;	// snapshots, three, see publishSnapshot()
+    int frontSnapshot;		// frontSnapshot, the one the View reads
+    int backSnapshot;		// backSnapshot, the one the Model captures into
+    std::atomic<int> middleSnapshot;	// middleSnapshot, the one handed over, FRESHSNAPSHOT if not yet read
+
+    std::thread *simThread;	// simThread, takes the steps, NULL if the caller takes them
+    std::atomic<bool> quitting;	// quitting, tells simThread to stop
+    int messages[MAXMESSAGES];	// messages, ring of messages waiting for simThread
+    std::atomic<int> messageHead;	// messageHead, next message to handle, advanced by simThread
+    std::atomic<int> messageTail;	// messageTail, next free slot, advanced by post()
+
+    void publishSnapshot();
+    void simulate();
+    void handleMessage(int message);
     
   public:
     ParticleGenerator *generators;
@@ -39,11 +98,23 @@ class Model{
     void initSimulation();
     void timeStep();
     void startSimulation();       
+    void startThread();
+    void stopThread();
+    void post(ModelMessage message);
+    void toggleReordering();
+    void toggleTurbulence(){turbulenceOn = !turbulenceOn;}
+    void toggleBudget();
+    void setStageTiming(bool on){stageTiming = on;}
+    void setSeed(unsigned long long s){seed = s;}
+    void setDeterministic(bool on);
+    unsigned long long hashState();
+    bool loadColliderMesh(const char *filename);
+    void useSDFColliders(const char *cachefile);
 
     int getNumParticles(){return numParticles;}
-    ParticleGenerator getGen1(){return pg;}
-    ParticleGenerator getGen2(){return pg2;}
-    ParticleGenerator getGen3(){return pg3;}
+    Mesh* getColliderMesh(){return sceneMesh;}
+    const RenderSnapshot* acquireSnapshot();
+    bool hasNewSnapshot();
 
     bool isSimRunning(){return running;}
     int displayInterval(){return dispinterval;}
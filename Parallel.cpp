@@ -0,0 +1,243 @@
+/*
+* Parallel.cpp
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/5/2018
+* Version 1.0
+*
+* A small pool of worker threads used to spread loops over particles,
+* triangles, voxels or pixels across the cores of the machine. The
+* threads are created once and sleep between jobs, so parallelFor is
+* cheap enough to call several times per timestep.
+*
+* The pool runs one job at a time. The simulation thread and the
+* drawing thread both run parallel loops, so a job started while another
+* thread's job is running waits for it to finish first.
+*
+* Work is handed out as numbered chunks. How the work is cut into chunks
+* is up to the caller, which means that a caller that sizes its chunks
+* independently of the number of threads gets the same chunks, and so
+* the same results, however many threads are running.
+*/
+
+#include "Parallel.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+
+using namespace std;
+
+static int numThreads = 0;		// numThreads, 0 until first use
+
+static const function<void(int, int)> *job = NULL;
+static atomic<int> nextChunk;
+static int numChunksInJob = 0;
+static int jobNumber = 0;		// jobNumber, incremented for every job, tells workers there is new work
+static int busyWorkers = 0;
+static bool quitting = false;
+
+static thread_local bool insideJob = false;
+
+struct WorkerPool{			// threads and the locks they sleep on
+   vector<thread> workers;		// workers, threads other than the calling thread
+   mutex jobLock;			// jobLock, held by the thread whose job the pool is running
+   mutex lock;
+   condition_variable wakeup;		// wakeup, signals workers that a job is ready
+   condition_variable finished;		// finished, signals caller that workers are done
+
+   ~WorkerPool();
+};
+
+//-----------------------------------------------------------------
+/*
+static WorkerPool &pool()
+* PURPOSE : The pool, built on first use. The Model's constructor runs
+*           parallel loops before main, possibly before the statics of
+*           this file are built, so the pool cannot be an ordinary
+*           static. Built on first use, it is destroyed (stopping its
+*           workers) before anything that was built ahead of it.
+* INPUTS :  NONE
+* OUTPUTS : WorkerPool &, the pool
+*/
+//-----------------------------------------------------------------
+
+static WorkerPool &pool()
+{
+   static WorkerPool workerPool;
+   return workerPool;
+}
+
+//-----------------------------------------------------------------
+/*
+static void runChunks(int worker)
+* PURPOSE : Take chunks of the current job until there are none left
+* INPUTS :  int worker, index of the thread running the chunks
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+static void runChunks(int worker)
+{
+   insideJob = true;
+   int chunk;
+   while ((chunk = nextChunk.fetch_add(1)) < numChunksInJob){
+      (*job)(chunk, worker);
+   }
+   insideJob = false;
+}
+
+//-----------------------------------------------------------------
+/*
+static void workerLoop(int worker, int seen)
+* PURPOSE : Body of each worker thread, sleeps until a job is posted
+* INPUTS :  int worker, index of this worker (1 and up)
+*           int seen, number of the last job posted before it started,
+*           which it must not take for a new one
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+static void workerLoop(int worker, int seen)
+{
+   WorkerPool &p = pool();
+
+   while (true){
+      {
+         unique_lock<mutex> lock(p.lock);
+         p.wakeup.wait(lock, [&seen]{return quitting || jobNumber != seen;});
+         if (quitting)
+            return;
+         seen = jobNumber;
+      }
+
+      runChunks(worker);
+
+      unique_lock<mutex> lock(p.lock);
+      busyWorkers = busyWorkers - 1;
+      if (busyWorkers == 0)
+         p.finished.notify_one();
+   }
+}
+
+//-----------------------------------------------------------------
+/*
+static void stopWorkers(WorkerPool &p)
+WorkerPool::~WorkerPool()
+*
+* PURPOSE : Wake all workers up to quit, and wait for them. Also done
+*           when the pool is destroyed at exit, since threads may not
+*           be destroyed while running, and the locks may not be
+*           destroyed while threads sleep on them
+* INPUTS :  WorkerPool &p, the pool
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+static void stopWorkers(WorkerPool &p)
+{
+   {
+      unique_lock<mutex> lock(p.lock);
+      quitting = true;
+   }
+   p.wakeup.notify_all();
+   for (size_t i = 0; i < p.workers.size(); i++){
+      p.workers[i].join();
+   }
+   p.workers.clear();
+   quitting = false;
+}
+
+WorkerPool::~WorkerPool()
+{
+   stopWorkers(*this);
+}
+
+//-----------------------------------------------------------------
+/*
+void setNumThreads(int n)
+* PURPOSE : Stop the current workers and start n - 1 new ones, once no
+*           job is running
+* INPUTS :  int n, number of threads, 0 for one per hardware thread
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+void setNumThreads(int n)
+{
+   if (n <= 0){
+      n = thread::hardware_concurrency();
+      if (n <= 0)
+         n = 1;
+   }
+
+   WorkerPool &p = pool();
+   lock_guard<mutex> running(p.jobLock);
+   stopWorkers(p);
+
+   numThreads = n;
+   for (int i = 1; i < numThreads; i++){
+      p.workers.push_back(thread(workerLoop, i, jobNumber));
+   }
+}
+
+//-----------------------------------------------------------------
+/*
+int getNumThreads()
+* PURPOSE : Number of threads, starting the pool on first use
+* INPUTS :  NONE
+* OUTPUTS : int, number of threads including the calling thread
+*/
+//-----------------------------------------------------------------
+
+int getNumThreads()
+{
+   if (numThreads == 0)
+      setNumThreads(0);
+
+   return numThreads;
+}
+
+//-----------------------------------------------------------------
+/*
+void parallelFor(int numChunks, const function<void(int, int)> &body)
+* PURPOSE : Run body over all chunks on the pool, the calling thread
+*           takes chunks too, as worker 0
+* INPUTS :  int numChunks, number of chunks of work
+*           body, function called as body(chunk, worker)
+* OUTPUTS : NONE, returns after every chunk is done
+*/
+//-----------------------------------------------------------------
+
+void parallelFor(int numChunks, const function<void(int chunk, int worker)> &body)
+{
+   if (numChunks <= 0)
+      return;
+
+   if (insideJob || getNumThreads() == 1 || numChunks == 1){	// Nothing to spread out
+      for (int c = 0; c < numChunks; c++){
+         body(c, 0);
+      }
+      return;
+   }
+
+   WorkerPool &p = pool();
+   lock_guard<mutex> running(p.jobLock);
+   {
+      unique_lock<mutex> lock(p.lock);
+      job = &body;
+      nextChunk = 0;
+      numChunksInJob = numChunks;
+      busyWorkers = numThreads - 1;
+      jobNumber = jobNumber + 1;
+   }
+   p.wakeup.notify_all();
+
+   runChunks(0);
+
+   unique_lock<mutex> lock(p.lock);
+   p.finished.wait(lock, []{return busyWorkers == 0;});
+   job = NULL;
+}
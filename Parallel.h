@@ -0,0 +1,26 @@
+/*
+* Parallel.h
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/5/2018
+* Version 1.0
+*/
+
+#ifndef __PARALLEL_H__
+#define __PARALLEL_H__
+
+#include <functional>
+
+// set the number of threads used by parallelFor, 0 uses one per hardware thread
+void setNumThreads(int n);
+
+// number of threads used by parallelFor, including the calling thread
+int getNumThreads();
+
+// call body(chunk, worker) for every chunk in 0 .. numChunks - 1, spreading
+// the chunks over the worker threads. worker is in 0 .. getNumThreads() - 1,
+// and no two chunks run at the same time with the same worker. Returns when
+// all chunks are done. Calls made from inside a body run serially.
+void parallelFor(int numChunks, const std::function<void(int chunk, int worker)> &body);
+
+#endif
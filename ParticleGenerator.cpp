@@ -13,19 +13,34 @@
 * common forms including spheres, points, and disks. A 
 * ParticleGenerator is not rendered in the scene, but does 
 * determine where and how the particles move throughout the scene.
-* Implemeted here is a spherical ParticleGenerator with particles
-* being generated at the surface of the sphere.
+* By default, particles are generated at the surface of a sphere.
+* Other shapes (points, disks, boxes, cylinders, and triangle meshes)
+* are provided by giving the generator an Emitter (see Emitter.h).
+* How many particles are generated over time is given by a RateCurve
+* (see RateCurve.h), by default on at generationRate between the start
+* and stop times, repeating after a delay.
+* Random numbers come from an Rng started fresh every step from the
+* generator's seed and the step number (see Rng.h), so a run can be
+* repeated exactly, however many threads it runs on.
+* Particles may themselves spawn particles, on death or during their
+* life, through the generator's SubEmitter rules (see SubEmitter.h).
 *
 */
 #include "ParticleGenerator.h"
 #include "Particle.h"
 #include "ParticleList.h"
 #include "Vector.h"
+#include "Emitter.h"
+#include "RateCurve.h"
+#include "SubEmitter.h"
+#include "Parallel.h"
 #include <math.h>
 
 
 using namespace std;
 
+#define SPAWNCHUNK 4096		// particles per chunk of the parallel kill pass
+
 //-----------------------------------------------------------------
 /*
 ParticleGenerator::ParticleGenerator();
@@ -45,12 +60,28 @@ ParticleGenerator::ParticleGenerator()
    timeStart = 0.0;
    timeStop = 0.0;
    generationRate = 0;
+   emitted = 0.0;
+
+   priority = 0;
+   rateScale = 1.0;
+   lifeScale = 1.0;
+   shed = 0.0;
 
    meanInitSpeed = 0.0;
    speedRange = 0.0;
    radius = 0.0;
    meanLifespan = 0.0;
    lifespanRange = 0.0;
+   emitter = NULL;
+
+   numSubEmitters = 0;
+   queues = NULL;
+   numQueues = 0;
+
+   seed = 1;
+   stepNumber = 0;
+   normals = NULL;
+   maxNormals = 0;
 
    plPointer = NULL;
 }
@@ -75,16 +106,121 @@ ParticleGenerator::ParticleGenerator(int numParticles, Vector3d x, float start_t
    
    position = x;
    radius = 1.0;		
+   emitter = NULL;		// emit from sphere of radius until given an emitter
 
    timeStart = start_t;	
    timeStop = stop_t;
    generationRate = gen_r;
-   f = 0.0;
+   emitted = 0.0;
+   buildSchedule();
+
+   priority = 0;
+   rateScale = 1.0;		// not throttled
+   lifeScale = 1.0;
+   shed = 0.0;
 
    meanInitSpeed = 0.5;	
    speedRange = 0.2;
    meanLifespan = 1.0;	
    lifespanRange = 0.3;
+
+   numSubEmitters = 0;		// particles do not spawn particles until given rules
+   queues = NULL;
+   numQueues = 0;
+
+   seed = 1;			// same random numbers every run, unless given another seed
+   stepNumber = 0;
+   normals = NULL;		// grown to the largest step
+   maxNormals = 0;
+}
+
+//-----------------------------------------------------------------
+/*
+ParticleGenerator::ParticleGenerator(const ParticleGenerator &g)
+ParticleGenerator::operator=(const ParticleGenerator &g)
+ParticleGenerator::~ParticleGenerator()
+*
+* PURPOSE : Copy a generator, and free it. The Model copies generators
+*           into place, so the spawn queues and normals, scratch space
+*           of a step that each generator allocates for itself, are not
+*           copied but left to be allocated by the copy, and freed with it.
+* INPUTS :  const ParticleGenerator &g, generator to copy
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+ParticleGenerator::ParticleGenerator(const ParticleGenerator &g)
+{
+   queues = NULL;
+   numQueues = 0;
+   normals = NULL;
+   maxNormals = 0;
+   copySettings(g);
+}
+
+ParticleGenerator& ParticleGenerator::operator=(const ParticleGenerator &g)
+{
+   if (this != &g)
+      copySettings(g);
+   return *this;
+}
+
+ParticleGenerator::~ParticleGenerator()
+{
+   delete [] queues;
+   delete [] normals;
+}
+
+//-----------------------------------------------------------------
+/*
+void ParticleGenerator::copySettings(const ParticleGenerator &g)
+* PURPOSE : Copy everything of a generator but its spawn queues and
+*           normals, which are emptied, to be allocated again on the
+*           next step
+* INPUTS :  const ParticleGenerator &g, generator to copy
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+void ParticleGenerator::copySettings(const ParticleGenerator &g)
+{
+   pl = g.pl;
+   plPointer = &pl;
+   position = g.position;
+   radius = g.radius;
+   emitter = g.emitter;
+
+   timeStart = g.timeStart;
+   timeStop = g.timeStop;
+   generationRate = g.generationRate;
+   emission = g.emission;
+   emitted = g.emitted;
+
+   priority = g.priority;
+   rateScale = g.rateScale;
+   lifeScale = g.lifeScale;
+   shed = g.shed;
+
+   meanInitSpeed = g.meanInitSpeed;
+   speedRange = g.speedRange;
+   meanLifespan = g.meanLifespan;
+   lifespanRange = g.lifespanRange;
+
+   startColor = g.startColor;
+   endColor = g.endColor;
+   for (int r = 0; r < MAXSUBEMITTERS; r++)
+      subEmitters[r] = g.subEmitters[r];
+   numSubEmitters = g.numSubEmitters;
+   delete [] queues;
+   queues = NULL;
+   numQueues = 0;
+
+   seed = g.seed;
+   stepNumber = g.stepNumber;
+   rng = g.rng;
+   delete [] normals;
+   normals = NULL;
+   maxNormals = 0;
 }
 
 //-----------------------------------------------------------------
@@ -97,8 +233,14 @@ ParticleGenerator::ParticleGenerator(int numParticles, Vector3d x, float start_t
 * INPUTS :  SpeedParams - mean, range - defines gaussian randomization for particle speed
 	    LifespanParams - mean, range - defines gaussian randomization for particle lifespan
  	    Radius - rad - defines radius of spherical generator
+	    Emitter - e - shape to emit from instead of the sphere, NULL for the sphere
 	    Position - pos - defines center position of generator
 	    StartStopTimes - start, stop - times to turn generator on/off
+	    RateCurve - curve - keyframed emission rate, replaces the start/stop schedule
+	    Colors - start, end - RGBA streak colors given to new particles, turns
+	             on the COLOR_CHANNEL of the particle list
+	    SubEmitter - rule - add a rule for particles spawning particles, returns
+	             false if the generator already has MAXSUBEMITTERS rules
 * OUTPUTS : NONE
 */
 //-----------------------------------------------------------------
@@ -119,6 +261,11 @@ void ParticleGenerator::setRadius(float rad)
    radius = rad;
 }
 
+void ParticleGenerator::setEmitter(Emitter *e)
+{
+   emitter = e;
+}
+
 void ParticleGenerator::setPosition(Vector3d pos)
 {
    position = pos;
@@ -128,6 +275,67 @@ void ParticleGenerator::setStartStopTimes(float start, float stop)
 {
    timeStart = start;
    timeStop = stop;
+   buildSchedule();
+}
+
+void ParticleGenerator::setRateCurve(RateCurve curve)
+{
+   emission = curve;
+}
+
+void ParticleGenerator::setColors(Vector4d start, Vector4d end)
+{
+   startColor = start;
+   endColor = end;
+   pl.requestChannel(COLOR_CHANNEL);
+}
+
+bool ParticleGenerator::addSubEmitter(SubEmitter rule)
+{
+   if (numSubEmitters == MAXSUBEMITTERS)
+      return false;
+
+   subEmitters[numSubEmitters] = rule;
+   numSubEmitters++;
+   return true;
+}
+
+//-----------------------------------------------------------------
+/*
+void ParticleGenerator::buildSchedule()
+* PURPOSE : Build the emission RateCurve for a generator that is on at
+*           generationRate from timeStart to timeStop. After the first
+*           period (of length timeStop - timeStart) the schedule loops,
+*           coming back on a delay after the start of each period.
+* INPUTS :  NONE, uses timeStart, timeStop, and generationRate
+* OUTPUTS : NONE, defines emission
+*/
+//-----------------------------------------------------------------
+
+void ParticleGenerator::buildSchedule()
+{
+   float delay = 2.0;			// time off at the start of each repeat
+   float duration = timeStop - timeStart;
+   float rate = generationRate;
+
+   emission.clear();
+   if (duration <= 0.0)
+      return;
+
+   float on = Min(timeStart + delay, duration);	// on and off times within a period
+   float off = Min(timeStop, duration);
+
+   emission.addKey(timeStart, rate);		// first period
+   emission.addKey(off, rate);
+   emission.addKey(off, 0.0);
+
+   if (on < off){				// repeats
+      emission.addKey(duration + on, 0.0);
+      emission.addKey(duration + on, rate);
+      emission.addKey(duration + off, rate);
+      emission.addKey(duration + off, 0.0);
+   }
+   emission.setLoop(duration, 2 * duration);
 }
 
 //-----------------------------------------------------------------
@@ -219,7 +427,7 @@ double ParticleGenerator::uniform(double min, double max)
 
 double ParticleGenerator::uniform(double min, double max)
 {
-   double r = ((max - min) * drand48() + min);	// drand48() returns value between 0 and 1
+   double r = rng.uniform(min, max);	// drawn from the generator's stream for this step
    return r;
 }
 
@@ -251,7 +459,8 @@ Vector3d ParticleGenerator::randSphereVec()
 /*
 bool ParticleGenerator::shouldGenerate(float t)
 * PURPOSE : Determines whether or not the ParticleGenerator should
-*	    be currently generating particles into the scene
+*	    be currently generating particles into the scene, i.e. whether
+*	    its emission rate is above zero
 * INPUTS :  float t, current time in the simulation
 * OUTPUTS : bool, true if ParticleGenerator should be generating
 *		  false if ParticleGenerator shouldn't be generating
@@ -259,73 +468,218 @@ bool ParticleGenerator::shouldGenerate(float t)
 //-----------------------------------------------------------------
 
 bool ParticleGenerator::shouldGenerate(float t){
-
-   bool generating = false;
-   bool restart = false;
-   float delay = 2.0;
-   float duration = timeStop - timeStart;
-   if (t <= duration){
-      if ((t >= timeStart) && (t < timeStop)){
-         generating = true;
-      }
-   }
-   else{
-      if ((fmod(t, duration)>= (timeStart + delay)) && (fmod(t, duration) < timeStop)){
-         generating = true;
-      }
-
-   }
-
-   return generating;
+   return emission.rate(t) > 0.0;
 }
 
 //-----------------------------------------------------------------
 /*
-ParticleGenerator::generateParticles(ParticleList pl, float t, float h)
+ParticleGenerator::generateParticles(float t, float h)
 * PURPOSE : Generate randomized particles and add them to the scene.
 *	    These particles will come from the pre-allocated ParticleList
-*           and are initialized with random values.
-* INPUTS :  ParticleList pl, ParticleList which holds all the particles
-*           that are available for the scene.
-*	    float t, current time in simulation
+*           and are initialized with random values. Called after the
+*           particles already in the scene have been integrated to t + h.
+*	    Each particle is born at its own time within the step, where
+*	    the integrated emission rate passes its count, and is advanced
+*	    from its birth position by its age at t + h, so a stream stays
+*	    smooth instead of leaving in a shell each step. The particles
+*	    are reserved from the ParticleList in one block and filled in
+*	    directly. If the Budget has throttled the generator, only
+*	    rateScale of the emission is kept, and lifespans are scaled
+*	    by lifeScale. The speeds and lifespans of the step are drawn
+*	    up front, in one batch each.
+* INPUTS :  float t, time at the start of the step
 *	    float h, timestep in simulation
 * OUTPUTS : NONE, update particle attributes
 */
 //-----------------------------------------------------------------
 
 void ParticleGenerator::generateParticles(float t, float h){
-   if (shouldGenerate(t) == true){		// Is the generator on?
-
-      //std::cout << "IC1: " << pl.inactiveCount << std::endl;
-      int n = floor(generationRate * h);      	// Get number of particles to generate
-      
-      f = f + ((generationRate * h) - n);	// Update accumulative fraction (leftover)
-      if (f > 1){
-         n = n + 1;
-         f = f - 1.0;
+   rng = Rng(seed, Rng::stream(stepNumber, 0));	// random numbers depend only on seed and step
+   stepNumber++;
+
+   double total = emission.integral(t + h);	// Particles that should exist by the end of the step
+   double before = emitted - shed;		// less those the Budget throttled
+   shed = shed + (total - emitted) * (1.0 - rateScale);
+   emitted = total;
+   total = total - shed;
+   int n = (int)(floor(total) - floor(before));	// Get number of particles to generate
+
+   int *slots;
+   n = pl.reserveParticles(n, slots);		// As many as there are still particles left to activate..
+   double first = floor(before) + 1.0 - before;	// emission until the first birth in the step
+   double step = total - before;			// emission over the whole step
+   float *colors = (float *)pl.getChannel(COLOR_CHANNEL);
+
+   if (2 * n > maxNormals){			// grow the batch of normal numbers
+      delete [] normals;
+      maxNormals = Max(2 * n, 2 * maxNormals);
+      normals = new float[maxNormals];
+   }
+   float *speeds = normals;
+   float *lifespans = normals + n;
+   rng.gauss(speeds, n, meanInitSpeed, speedRange/3);	// Randomize initial values
+   rng.gauss(lifespans, n, meanLifespan, lifespanRange/3);
+
+   for(int i = 0; i < n; i ++){		// For number of particles to be generated
+      // birth time, as a fraction of the step, assuming the rate is constant over the step
+      double frac = (first + i) / step;
+      float age = (1.0 - frac) * h;
+      // speed
+      float s = speeds[i];
+      // direction and position
+      Vector3d u, x;
+      if (emitter != NULL){
+         Vector3d offset;
+         emitter->sample(offset, u, rng);
+         x = position + offset;
+      }
+      else{
+         u = randSphereVec();
+         x = position + (radius * u);
       }
+      //velocity
+      Vector3d v = fabs(s) * u;
+
+      Particle &p = pl.particles[slots[i]];
+      p.prev_position = x;
+      p.position = x + (age * v);
+      p.velocity = v;
+      p.lifespan = lifeScale * lifespans[i];	// lifespan
+      p.timestamp = t + h - age;
+      p.isActive = true;
+
+      if (colors != NULL){			// optional attributes
+         float *c = colors + 8 * slots[i];
+         for (int k = 0; k < 4; k++){
+            c[k] = startColor[k];
+            c[4 + k] = endColor[k];
+         }
+      }
+   }
 
+}
 
+//-----------------------------------------------------------------
+/*
+ParticleGenerator::testAndDeactivate(float h, float t)
+* PURPOSE : Deactivate particles that have died, and queue the children
+*	    their sub-emitter rules spawn. Without rules this is just the
+*	    ParticleList's kill pass. With rules, the particle list is split
+*	    into chunks that are tested in parallel, each chunk queuing its
+*	    deaths and spawns. Deaths are then pushed onto the inactiveStack
+*	    in chunk order, the same order as the serial pass, and the
+*	    spawns are flushed.
+* INPUTS :  float h, timestep of the simulation
+*	    float t, current time in simulation
+* OUTPUTS : NONE, particles, inactiveStack, and inactiveCount are
+*	    updated, children are activated
+*/
+//-----------------------------------------------------------------
 
-      for(int i = 0; i < n; i ++){		// For number of particles to be generated
-         
-         if (pl.inactiveCount > 0){			// As long as there are still particles left to activate..
-	    // speed
-            float s = gauss(meanInitSpeed, speedRange/3, 1);	// Randomize initial values
-	    // direction 
-	    Vector3d u = randSphereVec();
-            //velocity
-            Vector3d v = fabs(s) * u;
-	    // position
-            Vector3d x = position + (radius * u);
-	    // lifespan 
-	    float l = gauss(meanLifespan, lifespanRange/3, 2);
+void ParticleGenerator::testAndDeactivate(float h, float t){
+   if (numSubEmitters == 0){
+      pl.testAndDeactivate(h, t);
+      return;
+   }
 
-	    pl.activateTopParticle(x, v, l, t);
+   int np = pl.getNumParticles();
+   int chunks = (np + SPAWNCHUNK - 1) / SPAWNCHUNK;
+   if (numQueues < chunks){			// queues keep their storage from step to step
+      delete [] queues;
+      queues = new SpawnQueue[chunks];
+      numQueues = chunks;
+   }
+
+   parallelFor(chunks, [this, np, h, t](int c, int worker){
+      SpawnQueue &q = queues[c];
+      q.spawns.clear();
+      q.dead.clear();
+      Rng chunkRng(seed, Rng::stream(stepNumber, 1, c));	// same numbers for any number of threads
+
+      int last = Min((c + 1) * SPAWNCHUNK, np);
+      for (int i = c * SPAWNCHUNK; i < last; i++){
+         Particle &p = pl.particles[i];
+         if (p.isActive == false)
+            continue;
+
+         bool dies = pl.shouldKill(p, t);
+         for (int r = 0; r < numSubEmitters; r++){
+            if ((subEmitters[r].trigger == ON_DEATH) != dies)
+               continue;
+            int n = subEmitters[r].numChildren(h, chunkRng);
+            if (n > 0){
+               Spawn spawn = {p.position, p.velocity, r, n};
+               q.spawns.push_back(spawn);
+            }
+         }
 
+         if (dies){
+            p.isActive = false;
+            q.dead.push_back(i);
          }
       }
+   });
+
+   for (int c = 0; c < chunks; c++){		// push to inactive stack
+      for (size_t j = 0; j < queues[c].dead.size(); j++){
+         pl.inactiveStack[pl.inactiveCount] = queues[c].dead[j];
+         pl.inactiveCount = pl.inactiveCount + 1;
+      }
    }
 
+   flushSpawns(t);
 }
 
+//-----------------------------------------------------------------
+/*
+ParticleGenerator::flushSpawns(float t)
+* PURPOSE : Activate the children queued by the kill pass. For each rule,
+*	    the slots for all of its children are reserved from the target
+*	    list at once, and each chunk fills in its share in parallel. If
+*	    the target list runs out of particles, the last spawns are dropped.
+* INPUTS :  float t, current time in simulation
+* OUTPUTS : NONE, children are activated
+*/
+//-----------------------------------------------------------------
+
+void ParticleGenerator::flushSpawns(float t){
+   int chunks = (pl.getNumParticles() + SPAWNCHUNK - 1) / SPAWNCHUNK;
+
+   for (int r = 0; r < numSubEmitters; r++){
+      ParticleList *target = subEmitters[r].target;
+      if (target == NULL)
+         continue;
+
+      int total = 0;				// each chunk's place in the block
+      for (int c = 0; c < chunks; c++){
+         queues[c].offset = total;
+         for (size_t j = 0; j < queues[c].spawns.size(); j++){
+            if (queues[c].spawns[j].rule == r)
+               total = total + queues[c].spawns[j].count;
+         }
+      }
+
+      int *slots;
+      int reserved = target->reserveParticles(total, slots);
+      if (reserved == 0)
+         continue;
+      float *colors = (float *)target->getChannel(COLOR_CHANNEL);
+
+      parallelFor(chunks, [this, r, t, target, slots, reserved, colors](int c, int worker){
+         SpawnQueue &q = queues[c];
+         Rng chunkRng(seed, Rng::stream(stepNumber, 2 + r, c));
+
+         int k = q.offset;
+         for (size_t j = 0; j < q.spawns.size() && k < reserved; j++){
+            if (q.spawns[j].rule != r)
+               continue;
+            for (int m = 0; m < q.spawns[j].count && k < reserved; m++){
+               int slot = slots[k];
+               subEmitters[r].emit(q.spawns[j], target->particles[slot],
+                                   (colors != NULL)? colors + 8 * slot : NULL, t, chunkRng);
+               k++;
+            }
+         }
+      });
+   }
+}
@@ -12,6 +12,12 @@
 #include "Vector.h"
 #include "Particle.h"
 #include "ParticleList.h"
+#include "Emitter.h"
+#include "RateCurve.h"
+#include "SubEmitter.h"
+#include "Rng.h"
+
+#define MAXSUBEMITTERS 4	// most sub-emitter rules a generator may have
 
 class ParticleGenerator{
    private:
@@ -20,27 +26,61 @@ class ParticleGenerator{
       ParticleList* plPointer;
       Vector3d position;	// center position of generator
       float radius;		// radius of spherical generator
+      Emitter* emitter;		// shape particles are emitted from, NULL for the sphere of radius
 
       float timeStart; 		// time when generator should start generating particles
       float timeStop;		// time when generator should stop generating particles
       int generationRate;	// rate of generation of particles per second
-      float f; 			// accumulated fraction of particles
+      RateCurve emission;	// particles per second over time, built from the above unless set
+      double emitted;		// integral of the emission rate up to the end of the last step
+
+      int priority;		// higher priority generators are throttled last by the Budget
+      float rateScale;		// fraction of the emission rate kept by the Budget
+      float lifeScale;		// fraction of lifespan kept by the Budget
+      double shed;		// particles not emitted because of rateScale
 
       float meanInitSpeed;	// average initial speed of particles
       float speedRange;		// range of particle speeds
       float meanLifespan;	// average lifespan of particles
       float lifespanRange;
 
+      Vector4d startColor;	// color of each particle's streak at its previous position
+      Vector4d endColor;	// and at its current position, used if the COLOR_CHANNEL is on
+      SubEmitter subEmitters[MAXSUBEMITTERS];	// rules for particles spawning particles
+      int numSubEmitters;
+      SpawnQueue* queues;	// deaths and spawns found in each chunk of the kill pass
+      int numQueues;
+
+      unsigned long long seed;	// seed of all of the generator's random numbers
+      unsigned long long stepNumber;	// steps generated so far, picks the random stream of a step
+      Rng rng;			// random numbers of the current step
+      float *normals;		// speeds and lifespans of a step, drawn in one batch
+      int maxNormals;
+
+      void buildSchedule();
+      void flushSpawns(float t);
+      void copySettings(const ParticleGenerator &g);
 
    public:
       ParticleGenerator();
       ParticleGenerator( int numParticles, Vector3d x, float start_t, float stop_t, int gen_r);
+      ParticleGenerator(const ParticleGenerator &g);
+      ParticleGenerator& operator=(const ParticleGenerator &g);
+      ~ParticleGenerator();
 
       void setSpeedParams(float mean, float range);
       void setLifespanParams(float mean, float range);
       void setRadius(float rad);
+      void setEmitter(Emitter *e);
       void setPosition(Vector3d pos);
       void setStartStopTimes(float start, float stop);
+      void setRateCurve(RateCurve curve);
+      void setColors(Vector4d start, Vector4d end);
+      bool addSubEmitter(SubEmitter rule);
+      void setSeed(unsigned long long s){seed = s;}
+      void setPriority(int p){priority = p;}
+      void setThrottle(float rate, float life){rateScale = rate; lifeScale = life;}
+      RateCurve* getRateCurve(){return &emission;}
 
       double gauss(double mean, double std, int seed);
       double uniform(double min, double max);
@@ -48,12 +88,19 @@ class ParticleGenerator{
       bool shouldGenerate(float t);
       void generateParticles(float t, float h);
       
-      void testAndDeactivate(float h, float t){pl.testAndDeactivate(h, t);}
-      void computeAccelerations(float drag){pl.computeAccelerations(drag);}
+      void testAndDeactivate(float h, float t);
+      void computeAccelerations(float drag, Turbulence *turb, float t){pl.computeAccelerations(drag, turb, t);}
       void integrate(float h){pl.integrate(h);}
+      void collide(Collider *c){pl.collide(c);}
+      int reorderMorton(){return pl.reorderMorton();}
 
       ParticleList* getParticleList(){plPointer = &pl; return plPointer;}
       int getNumParticles(){return pl.getNumParticles();}
+      int getActiveCount(){return pl.getNumParticles() - pl.getInactiveCount();}
+      int getPriority(){return priority;}
+      float getRateScale(){return rateScale;}
+      float getLifeScale(){return lifeScale;}
+      double getShed(){return shed;}
 };
 
 #endif
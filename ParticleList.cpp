@@ -49,12 +49,41 @@
 * active particles, so when particles need to be accessed, you must loop through
 * the entire particles list. 
 *
+* Because particles are activated in whatever order their indeces come off
+* the inactiveStack, particles that are close together in space end up
+* scattered through memory. reorderMorton() may be called every few steps to
+* sort the active particles by their 3D Morton (Z-order) code and pack them at
+* the front of the particles list, so that spatially coherent passes touch
+* memory in order. The mapping from old to new indeces is kept in remap so
+* that anything holding particle indeces can be updated.
+*
+* Attributes that only some generators or renderers need (color, size,
+* ID, temperature, and user floats) are not stored in Particle, but in
+* separate arrays, one per AttributeChannel, that are only allocated when
+* requested. A list that never uses them pays nothing for them. Channels
+* are indexed the same as particles: whoever activates a particle fills
+* in its channels, and reorderMorton() moves them along with the particles.
+* The table of channels is allocated with the list, so that copies of the
+* list see channels requested through any of them.
+*
+* Because slots are recycled through the inactiveStack, a slot index does
+* not say which particle is in it. If enableIDs() is called, each
+* activation is given a 64 bit ID, kept in the ID_CHANNEL: the low 32
+* bits are a handle, and the high 32 bits count how many times that
+* handle has been activated. Every slot owns a handle, which moves with
+* the particle when the list is reordered, and a table from handle to
+* slot finds the particle with a given ID in O(1), or reports that it
+* has died.
+*
 ***********************************************************************************************/
 
 #include "Particle.h"
 #include "ParticleList.h"
 #include "Vector.h"
+#include "Collider.h"
+#include "Turbulence.h"
 #include <assert.h>
+#include <string.h>
 
 using namespace std;
 
@@ -74,6 +103,14 @@ ParticleList::ParticleList()
    inactiveStack = NULL;
    inactiveCount = 0;
 
+   scratch = NULL;
+   keys = NULL;
+   order = NULL;
+   remap = NULL;
+
+   channels = NULL;
+   channelScratch = NULL;
+   ids = NULL;
 }
 		
 //-----------------------------------------------------------------
@@ -92,6 +129,22 @@ ParticleList::ParticleList(int np)
    inactiveStack = new int[numParticles];
    inactiveCount = numParticles;
 
+   scratch = NULL;			  // Reordering buffers are only allocated if reorderMorton() is used
+   keys = NULL;
+   order = NULL;
+   remap = NULL;
+
+   channels = new void*[NUMCHANNELS];	  // Attribute channels are only allocated if requested
+   for (int c = 0; c < NUMCHANNELS; c++){
+      channels[c] = NULL;
+   }
+   channelScratch = NULL;
+
+   ids = new IDTable;			  // Stable IDs are only allocated if enabled
+   ids->slotHandle = NULL;
+   ids->handleSlot = NULL;
+   ids->generation = NULL;
+
    for (int i=0; i < numParticles; i++){  // Construct list of particles
       particles[i] = Particle();	  // Use default constructor, all particles are inactive
       inactiveStack[i] = i;		  // B/c all particles are inactive, fill inactive stack with all indeces
@@ -201,16 +254,18 @@ void ParticleList::testAndDeactivate(float h, float t)
 
 //-----------------------------------------------------------------
 /*
-ParticleList::computeAccelerations(float drag)
+ParticleList::computeAccelerations(float drag, Turbulence *turb, float t)
 * PURPOSE : Ask each active particle to calculate and store current
 *           acceleration based on the forces in the scene and 
 *           the particle's current velocity
 * INPUTS :  float drag, property that defines air resistance
+*           Turbulence *turb, turbulent acceleration field, NULL if none
+*           float t, current time, scrolls the turbulence
 * OUTPUTS : NONE, updates Particle acceleration values
 */
 //-----------------------------------------------------------------
 
-void ParticleList::computeAccelerations(float drag)
+void ParticleList::computeAccelerations(float drag, Turbulence *turb, float t)
 {
    Vector3d Fg, Fa, Fair;						
    Fa.set(0.0, -9.8, 0.0);				// Force of gravity defined here
@@ -222,6 +277,9 @@ void ParticleList::computeAccelerations(float drag)
          Vector3d Ftotal = Fg + Fair;			// Forces present here include gravity and air resistance
  
          particles[i].acceleration = Ftotal/particles[i].mass;  // Update acceleration
+
+         if (turb != NULL)				// Turbulence is an acceleration, like gravity
+            particles[i].acceleration = particles[i].acceleration + turb->acceleration(particles[i].position, t);
       }
    }
 }
@@ -251,6 +309,25 @@ void ParticleList::integrate(float h){
    }
 }
 
+//-----------------------------------------------------------------
+/*
+ParticleList::collide(Collider *c)
+* PURPOSE : Resolve collisions of active particles with a collider,
+*           called after integrate so each particle's motion over the
+*           timestep runs from prev_position to position
+* INPUTS :  Collider *c, object in the scene to collide with
+* OUTPUTS : NONE, updates Particle position and velocity
+*/
+//-----------------------------------------------------------------
+
+void ParticleList::collide(Collider *c){
+   for (int i = 0; i < numParticles; i++){
+      if(particles[i].isActive == true){
+         c->collide(particles[i]);
+      }
+   }
+}
+
 //-----------------------------------------------------------------
 /*
 ParticleList::popInactiveStack()
@@ -278,15 +355,17 @@ int ParticleList::topInactiveStack(){
 
 //-----------------------------------------------------------------
 /*
-ParticleList::activateParticle(int pIndex, Vector3d pos, Vector3d vel, float ls)
+ParticleList::activateTopParticle(Vector3d pos, Vector3d prev, Vector3d vel, float ls, float ts)
 * PURPOSE : Activate particle at the top of the inactivestack
-* INPUTS :  int 
-* OUTPUTS : int, index of next available inactive particle in particles
-*           list
+* INPUTS :  Vector3d pos, position of the particle
+*           Vector3d prev, where the particle moved to pos from during
+*           this timestep (its birth position), swept by colliders
+*           Vector3d vel, velocity, float ls, lifespan, float ts, birth time
+* OUTPUTS : NONE
 */
 //-----------------------------------------------------------------
 
-void ParticleList::activateTopParticle(Vector3d pos, Vector3d vel, float ls, float ts)
+void ParticleList::activateTopParticle(Vector3d pos, Vector3d prev, Vector3d vel, float ls, float ts)
 {
    //std::cout << "IC2: " << inactiveCount << std::endl;
 
@@ -294,14 +373,353 @@ void ParticleList::activateTopParticle(Vector3d pos, Vector3d vel, float ls, flo
       int pIndex = inactiveStack[inactiveCount-1];
       
       particles[pIndex].position = pos;
+      particles[pIndex].prev_position = prev;
       particles[pIndex].velocity = vel;
       particles[pIndex].lifespan = ls;
       particles[pIndex].timestamp = ts;
       particles[pIndex].isActive = true;
+      assignIDs(&pIndex, 1);
       
       inactiveCount = inactiveCount - 1;
    }
    //std::cout << "IC3: " << inactiveCount << std::endl;
 }
 
+//-----------------------------------------------------------------
+/*
+int ParticleList::reserveParticles(int k, int* &slots)
+* PURPOSE : Pop up to k particles off the inactive stack at once, for
+*           bursts where activating one particle at a time would cost
+*           a call and a bounds check per particle. The indeces popped
+*           are the top k entries of the inactiveStack, which are
+*           contiguous, so they are handed back in place. The caller
+*           must fill in every particle in the span, including setting
+*           isActive, before the next testAndDeactivate, which reuses
+*           that part of the stack.
+* INPUTS :  int k, number of particles wanted
+*           int* &slots, set to the indeces of the reserved particles
+* OUTPUTS : int, number of particles reserved, less than k if there
+*           are not enough inactive particles left
+*/
+//-----------------------------------------------------------------
+
+int ParticleList::reserveParticles(int k, int* &slots)
+{
+   if (k > inactiveCount)
+      k = inactiveCount;
+   if (k < 0)
+      k = 0;
+
+   inactiveCount = inactiveCount - k;
+   slots = inactiveStack + inactiveCount;
+   assignIDs(slots, k);
 
+   return k;
+}
+
+//-----------------------------------------------------------------
+/*
+static int ParticleList::channelSize(AttributeChannel c)
+* PURPOSE : Number of bytes each particle takes in an attribute channel
+* INPUTS :  AttributeChannel c, which channel
+* OUTPUTS : int, bytes per particle
+*/
+//-----------------------------------------------------------------
+
+int ParticleList::channelSize(AttributeChannel c)
+{
+   switch (c){
+      case COLOR_CHANNEL:
+         return 8 * sizeof(float);
+      case ID_CHANNEL:
+         return sizeof(unsigned long long);
+      case USER_CHANNEL:
+         return USERFLOATS * sizeof(float);
+      default:
+         return sizeof(float);
+   }
+}
+
+//-----------------------------------------------------------------
+/*
+void* ParticleList::requestChannel(AttributeChannel c)
+* PURPOSE : Get an attribute channel, allocating it (zeroed) the first
+*           time it is requested
+* INPUTS :  AttributeChannel c, which channel
+* OUTPUTS : void*, array of numParticles entries of channelSize(c)
+*           bytes, NULL if the list is empty
+*/
+//-----------------------------------------------------------------
+
+void* ParticleList::requestChannel(AttributeChannel c)
+{
+   if (channels == NULL){
+      return NULL;
+   }
+
+   if (channels[c] == NULL){
+      int size = channelSize(c);
+      char *data = new char[(size_t)numParticles * size];
+      memset(data, 0, (size_t)numParticles * size);
+      channels[c] = data;
+   }
+
+   return channels[c];
+}
+
+//-----------------------------------------------------------------
+/*
+void ParticleList::enableIDs()
+* PURPOSE : Start giving every particle activated a stable ID. Each
+*           slot starts out owning the handle with its own index.
+* INPUTS :  NONE
+* OUTPUTS : NONE, allocates the handle tables and the ID_CHANNEL
+*/
+//-----------------------------------------------------------------
+
+void ParticleList::enableIDs()
+{
+   if (ids == NULL || ids->slotHandle != NULL){
+      return;
+   }
+
+   ids->slotHandle = new int[numParticles];
+   ids->handleSlot = new int[numParticles];
+   ids->generation = new unsigned int[numParticles];
+   for (int i = 0; i < numParticles; i++){
+      ids->slotHandle[i] = i;
+      ids->handleSlot[i] = i;
+      ids->generation[i] = 0;
+   }
+   requestChannel(ID_CHANNEL);
+}
+
+//-----------------------------------------------------------------
+/*
+void ParticleList::assignIDs(int *slots, int k)
+* PURPOSE : Give new IDs to particles just activated, by bumping the
+*           generation of the handle each slot owns
+* INPUTS :  int *slots, indeces of the particles, int k, how many
+* OUTPUTS : NONE, updates the ID_CHANNEL
+*/
+//-----------------------------------------------------------------
+
+void ParticleList::assignIDs(int *slots, int k)
+{
+   if (ids == NULL || ids->slotHandle == NULL){
+      return;
+   }
+
+   unsigned long long *id = (unsigned long long *)channels[ID_CHANNEL];
+   for (int j = 0; j < k; j++){
+      int handle = ids->slotHandle[slots[j]];
+      unsigned int gen = ++ids->generation[handle];
+      id[slots[j]] = ((unsigned long long)gen << 32) | (unsigned int)handle;
+   }
+}
+
+//-----------------------------------------------------------------
+/*
+unsigned long long ParticleList::getID(int slot)
+int ParticleList::findID(unsigned long long id)
+* PURPOSE : Get the stable ID of the particle in a slot, and find the
+*           slot of the particle with a given ID
+* INPUTS :  int slot, index in particles, unsigned long long id, ID
+* OUTPUTS : unsigned long long, ID, 0 (never a valid ID) if the slot
+*           is inactive or IDs are not enabled
+*           int, slot, -1 if that particle has died
+*/
+//-----------------------------------------------------------------
+
+unsigned long long ParticleList::getID(int slot)
+{
+   if (ids == NULL || ids->slotHandle == NULL || particles[slot].isActive == false){
+      return 0;
+   }
+
+   return ((unsigned long long *)channels[ID_CHANNEL])[slot];
+}
+
+int ParticleList::findID(unsigned long long id)
+{
+   if (ids == NULL || ids->slotHandle == NULL){
+      return -1;
+   }
+
+   unsigned int handle = (unsigned int)(id & 0xFFFFFFFFu);
+   if (handle >= (unsigned int)numParticles){
+      return -1;
+   }
+
+   int slot = ids->handleSlot[handle];
+   if (particles[slot].isActive == false || ((unsigned long long *)channels[ID_CHANNEL])[slot] != id){
+      return -1;
+   }
+
+   return slot;
+}
+
+//-----------------------------------------------------------------
+/*
+static unsigned int spreadBits(unsigned int v)
+* PURPOSE : Spread the low 10 bits of v out so that there are two
+*           zero bits between each of them, used to interleave three
+*           coordinates into a Morton code
+* INPUTS :  unsigned int v, 10 bit quantized coordinate
+* OUTPUTS : unsigned int, 30 bit spread value
+*/
+//-----------------------------------------------------------------
+
+static unsigned int spreadBits(unsigned int v)
+{
+   v = (v | (v << 16)) & 0x030000FF;
+   v = (v | (v << 8)) & 0x0300F00F;
+   v = (v | (v << 4)) & 0x030C30C3;
+   v = (v | (v << 2)) & 0x09249249;
+
+   return v;
+}
+
+//-----------------------------------------------------------------
+/*
+int ParticleList::reorderMorton()
+* PURPOSE : Sort the active particles by the Morton code of their
+*           position within the bounding box of all active particles,
+*           and pack them at the front of the particles list in that
+*           order. The inactiveStack is rebuilt so that the next
+*           particles activated come from the slots just after the
+*           packed block. Uses an LSD radix sort (3 passes of 10 bits).
+* INPUTS :  NONE
+* OUTPUTS : int, number of active particles. particles, attribute
+*           channels, inactiveStack, inactiveCount are updated, and
+*           remap holds the old -> new index of every particle (-1 for
+*           inactive particles)
+*/
+//-----------------------------------------------------------------
+
+int ParticleList::reorderMorton()
+{
+   const int radixBits = 10;
+   const int buckets = 1 << radixBits;
+
+   if (numParticles == 0){
+      return 0;
+   }
+
+   if (scratch == NULL){			// Allocate buffers the first time they are needed
+      scratch = new Particle[numParticles];
+      keys = new unsigned int[2 * numParticles];
+      order = new int[2 * numParticles];
+      remap = new int[numParticles];
+   }
+
+   int numActive = 0;				// Gather active particles and their bounds
+   Vector3d lo, hi;
+   for (int i = 0; i < numParticles; i++){
+      remap[i] = -1;
+      if (particles[i].isActive == true){
+         Vector3d &x = particles[i].position;
+         if (numActive == 0){
+            lo = x;
+            hi = x;
+         }
+         else{
+            lo.set(Min(lo.x, x.x), Min(lo.y, x.y), Min(lo.z, x.z));
+            hi.set(Max(hi.x, x.x), Max(hi.y, x.y), Max(hi.z, x.z));
+         }
+         order[numActive] = i;
+         numActive = numActive + 1;
+      }
+   }
+
+   Vector3d extent = hi - lo;			// Quantize positions to 10 bits per axis
+   double scale = 1023.0 / Max(Max(extent.x, extent.y), Max(extent.z, SMALLNUMBER));
+   for (int j = 0; j < numActive; j++){
+      Vector3d d = particles[order[j]].position - lo;
+      unsigned int qx = (unsigned int)(d.x * scale);
+      unsigned int qy = (unsigned int)(d.y * scale);
+      unsigned int qz = (unsigned int)(d.z * scale);
+      keys[j] = (spreadBits(qz) << 2) | (spreadBits(qy) << 1) | spreadBits(qx);
+   }
+
+   unsigned int *keysIn = keys;			// Radix sort (key, index) pairs, ping-ponging buffers
+   unsigned int *keysOut = keys + numParticles;
+   int *orderIn = order;
+   int *orderOut = order + numParticles;
+   int count[buckets];
+
+   for (int pass = 0; pass < 3; pass++){
+      int shift = pass * radixBits;
+      memset(count, 0, sizeof(count));
+      for (int j = 0; j < numActive; j++){
+         count[(keysIn[j] >> shift) & (buckets - 1)]++;
+      }
+      int sum = 0;
+      for (int b = 0; b < buckets; b++){
+         int c = count[b];
+         count[b] = sum;
+         sum = sum + c;
+      }
+      for (int j = 0; j < numActive; j++){
+         int dest = count[(keysIn[j] >> shift) & (buckets - 1)]++;
+         keysOut[dest] = keysIn[j];
+         orderOut[dest] = orderIn[j];
+      }
+      unsigned int *kt = keysIn; keysIn = keysOut; keysOut = kt;
+      int *ot = orderIn; orderIn = orderOut; orderOut = ot;
+   }
+
+   for (int j = 0; j < numActive; j++){	// Gather into sorted order and copy back in place,
+      scratch[j] = particles[orderIn[j]];	// the particles array itself may be shared by copies
+      remap[orderIn[j]] = j;
+   }
+   for (int j = 0; j < numActive; j++){
+      particles[j] = scratch[j];
+   }
+
+   for (int c = 0; c < NUMCHANNELS; c++){	// Attribute channels move with their particles
+      if (channels == NULL || channels[c] == NULL){
+         continue;
+      }
+      int size = channelSize((AttributeChannel)c);
+      char *data = (char *)channels[c];
+      if (channelScratch == NULL){		// Big enough for the largest channel
+         int largest = 0;
+         for (int k = 0; k < NUMCHANNELS; k++){
+            largest = Max(largest, channelSize((AttributeChannel)k));
+         }
+         channelScratch = new char[(size_t)numParticles * largest];
+      }
+      for (int j = 0; j < numActive; j++){
+         memcpy(channelScratch + (size_t)j * size, data + (size_t)orderIn[j] * size, size);
+      }
+      memcpy(data, channelScratch, (size_t)numActive * size);
+   }
+   for (int i = numActive; i < numParticles; i++){
+      particles[i].isActive = false;
+   }
+
+   if (ids != NULL && ids->slotHandle != NULL){	// Handles move with their particles,
+      int *handles = orderOut;			// those of inactive slots fill in behind
+      for (int j = 0; j < numActive; j++){
+         handles[j] = ids->slotHandle[orderIn[j]];
+      }
+      int k = numActive;
+      for (int i = 0; i < numParticles; i++){
+         if (remap[i] == -1){
+            handles[k++] = ids->slotHandle[i];
+         }
+      }
+      for (int i = 0; i < numParticles; i++){
+         ids->slotHandle[i] = handles[i];
+         ids->handleSlot[handles[i]] = i;
+      }
+   }
+
+   inactiveCount = numParticles - numActive;	// Rebuild stack so the lowest free slot is on top
+   for (int k = 0; k < inactiveCount; k++){
+      inactiveStack[k] = numParticles - 1 - k;
+   }
+
+   return numActive;
+}
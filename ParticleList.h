@@ -11,10 +11,41 @@
 
 #include "Vector.h"
 #include "Particle.h"
+#include "Collider.h"
+#include "Turbulence.h"
+
+#define USERFLOATS 4	// number of floats per particle in the USER_CHANNEL
+
+enum AttributeChannel{		// Optional per-particle attributes, allocated only when requested
+   COLOR_CHANNEL,		// 8 floats, RGBA at prev_position then RGBA at position
+   SIZE_CHANNEL,		// 1 float
+   ID_CHANNEL,			// 1 unsigned long long
+   TEMPERATURE_CHANNEL,		// 1 float
+   USER_CHANNEL,		// USERFLOATS floats, free for any use
+   NUMCHANNELS
+};
+
+struct IDTable{			// Stable particle IDs, see ParticleList::enableIDs()
+   int* slotHandle;		// slotHandle, handle owned by each slot of particles
+   int* handleSlot;		// handleSlot, slot each handle is currently at
+   unsigned int* generation;	// generation, times each handle has been activated
+};
 
 class ParticleList{
 	private:
 		int numParticles;	// total number of particles in system
+
+		Particle* scratch;	// scratch, reordering buffer, allocated on first reorder
+		unsigned int* keys;	// keys, Morton codes of active particles, used while reordering
+		int* order;		// order, indeces of active particles, sorted by Morton code
+		int* remap;		// remap, old index -> new index after the last reorder, -1 if inactive
+
+		void** channels;	// channels, attribute arrays indexed by AttributeChannel, NULL until requested
+		char* channelScratch;	// channelScratch, reordering buffer for attribute channels
+
+		IDTable* ids;		// ids, handle tables for stable IDs, arrays NULL until enabled
+
+		void assignIDs(int *slots, int k);
 		
 	public:
 		ParticleList();			
@@ -30,10 +61,23 @@ class ParticleList{
 		bool inStack(int i);
                 bool shouldKill(Particle p, float t);
 		void testAndDeactivate(float h, float t);
-		void computeAccelerations(float drag);
+		void computeAccelerations(float drag, Turbulence *turb, float t);
 		void integrate(float h);
+		void collide(Collider *c);
 		int topInactiveStack();
-	        void activateTopParticle(Vector3d pos, Vector3d vel, float ls, float ts);
+	        void activateTopParticle(Vector3d pos, Vector3d prev, Vector3d vel, float ls, float ts);
+		int reserveParticles(int k, int* &slots);
+		int reorderMorton();
+		int* getRemap(){return remap;}
+
+		static int channelSize(AttributeChannel c);
+		void* requestChannel(AttributeChannel c);
+		void* getChannel(AttributeChannel c){return (channels == NULL)? NULL : channels[c];}
+		bool hasChannel(AttributeChannel c){return getChannel(c) != NULL;}
+
+		void enableIDs();
+		unsigned long long getID(int slot);
+		int findID(unsigned long long id);
 
 };	
 
@@ -0,0 +1,614 @@
+/*
+* ParticleRenderer.cpp
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/17/2018
+* Version 1.0
+*
+* The ParticleRenderer draws each active particle as a streak from its
+* previous position to its current one. Drawing a streak at a time with
+* glBegin/glVertex/glEnd costs several driver calls per particle, which
+* limits the frame rate long before the graphics card does. Instead,
+* every frame the streaks of a RenderSnapshot, already packed in the
+* layout of a vertex, are copied into a single vertex buffer, and drawn
+* with one glDrawArrays.
+*
+* Streaks outside the camera's view are culled before they are copied,
+* so the copy and the draw cost only as much as what can be seen. The
+* streaks are culled in parallel over fixed size chunks, against the
+* planes of a Frustum, which tells which streaks of each chunk are
+* visible and how many. That gives each chunk where its visible streaks
+* start in the sort.
+*
+* The streaks fade to clear along their length, and are blended, so
+* they are drawn farthest first. The visible streaks of all the lists
+* are sorted together by the distance of their midpoints in front of
+* the camera, with a parallel radix sort (see DepthSort), and packed in
+* that order in parallel. The View blends them without writing depth.
+*
+* The buffer is orphaned each frame (glBufferData with no data) before it
+* is mapped, so the driver hands back fresh storage instead of waiting
+* for the GPU to finish drawing last frame's vertices.
+*
+* With millions of streaks the copy is most of the cost, so where it can
+* they are packed in a compact format, 8 bytes a vertex instead of 28:
+* the color is left to a shader, and the position is quantized to 16
+* bits across the bounds of the visible streaks of its group. Every
+* streak a generator emits goes from the same start color to the same
+* end color (see ParticleGenerator::setColors()), so a list has one pair
+* of colors, or a few where sub-emitters emit into it. The streaks of a
+* list with the same colors make a group, and the vertex carries only
+* its group and whether it is the start or end; the shader looks up the
+* group's bounds and colors. While culling, each chunk sorts its visible
+* streaks into up to CHUNKGROUPS groups by color, and finds the bounds
+* of each, and the groups of the chunks of each list are merged. If
+* there are more than MAXCOMPACTGROUPS, the frame is drawn in floats.
+* The compact format needs shaders (OpenGL 2.0); the float format needs
+* only buffer objects (OpenGL 1.5) and client state vertex arrays, so
+* this runs on anything from Mesa's software renderer up.
+*/
+
+#define GL_GLEXT_PROTOTYPES		// buffer object entry points
+
+#include "ParticleRenderer.h"
+#include "Parallel.h"
+#include "Utility.h"
+
+#ifdef __APPLE__
+#  pragma clang diagnostic ignored "-Wdeprecated-declarations"
+#  include <GLUT/glut.h>
+#else
+#  include <GL/glut.h>
+#endif
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
+using namespace std;
+
+#define RENDERCHUNK 16384		// streaks per chunk when culling
+
+// the compact format's vertex shader, with room for MAXCOMPACTGROUPS groups
+static const char *compactShader =
+   "#version 110\n"
+   "uniform vec3 origin[%d];\n"		// bounds of each group
+   "uniform vec3 extent[%d];\n"
+   "uniform vec4 startColor[%d];\n"	// colors of each group
+   "uniform vec4 endColor[%d];\n"
+   "attribute vec3 quantized;\n"		// position, 0 to 1 across the bounds
+   "attribute vec2 rampGroup;\n"		// ramp, 0 to 255, and group
+   "void main(){\n"
+   "   int g = int(rampGroup.y);\n"
+   "   vec3 p = origin[g] + quantized * extent[g];\n"
+   "   gl_Position = gl_ModelViewProjectionMatrix * vec4(p, 1.0);\n"
+   "   gl_FrontColor = mix(startColor[g], endColor[g], rampGroup.x / 255.0);\n"
+   "}\n";
+
+static const char *colorShader =
+   "#version 110\n"
+   "void main(){\n"
+   "   gl_FragColor = gl_Color;\n"
+   "}\n";
+
+// whether a streak goes from color0 to color1, colors being the start then end color of a group
+static inline bool sameColors(const float *colors, const float *color0, const float *color1)
+{
+   return memcmp(colors, color0, 4 * sizeof(float)) == 0 && memcmp(colors + 4, color1, 4 * sizeof(float)) == 0;
+}
+
+//-----------------------------------------------------------------
+/*
+ParticleRenderer::ParticleRenderer()
+* PURPOSE : Constructor, no GL calls are made until the first draw,
+*           since there may not be a GL context yet
+* INPUTS :  NONE
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+ParticleRenderer::ParticleRenderer()
+{
+   buffer = 0;
+   capacity = 0;
+
+   visible = NULL;
+   maxStreaks = 0;
+   chunkBegin = NULL;
+   chunkEnd = NULL;
+   chunkStart = NULL;
+   maxChunks = 0;
+   listChunks = NULL;
+   maxLists = 0;
+   viewDepth[0] = viewDepth[1] = viewDepth[3] = 0.0;	// down -z, until a camera is set
+   viewDepth[2] = -1.0;
+   compactOn = true;
+   compactable = false;
+   streakGroup = NULL;
+   chunkGroups = NULL;
+   chunkBounds = NULL;
+   chunkColors = NULL;
+   chunkRemap = NULL;
+   numGroups = 0;
+   program = 0;
+   programState = 0;
+   originLoc = extentLoc = startColorLoc = endColorLoc = -1;
+   staging = NULL;
+   stagingSize = 0;
+   numDrawn = 0;
+}
+
+//-----------------------------------------------------------------
+/*
+void ParticleRenderer::setCamera(const Camera &camera, int w, int h)
+* PURPOSE : Cull streaks to what a camera sees, and sort them by their
+*           distance from it
+* INPUTS :  const Camera &camera, the camera drawn through
+*           int w, h, size of the viewport
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+void ParticleRenderer::setCamera(const Camera &camera, int w, int h)
+{
+   frustum.set(camera, w, h);
+
+   // the camera looks down -z, distance in front of it is minus the third row
+   double view[16];
+   camera.ViewMatrix(view);
+   for (int k = 0; k < 4; k++){
+      viewDepth[k] = -view[4 * k + 2];
+   }
+}
+
+//-----------------------------------------------------------------
+/*
+void ParticleRenderer::pack(const RenderSnapshot &snapshot, StreakVertex *dest)
+* PURPOSE : Copy the visible streaks, as prepared, in the order they
+*           were sorted in
+* INPUTS :  const RenderSnapshot &snapshot, the streaks, as prepared
+*           StreakVertex *dest, where to pack them
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+void ParticleRenderer::pack(const RenderSnapshot &snapshot, StreakVertex *dest)
+{
+   const StreakVertex *vertices = snapshot.getVertices();
+   const int *order = depthSort.getValues();
+   int numChunks = (numDrawn + RENDERCHUNK - 1) / RENDERCHUNK;
+   parallelFor(numChunks, [&](int c, int worker){
+      int end = Min((c + 1) * RENDERCHUNK, numDrawn);
+      for (int k = c * RENDERCHUNK; k < end; k++){
+         dest[2 * k] = vertices[2 * order[k]];
+         dest[2 * k + 1] = vertices[2 * order[k] + 1];
+      }
+   });
+}
+
+//-----------------------------------------------------------------
+/*
+void ParticleRenderer::packCompact(const RenderSnapshot &snapshot, CompactVertex *dest)
+* PURPOSE : Copy the visible streaks, as prepared, in the order they
+*           were sorted in, in the compact format. Only when
+*           isCompactable().
+* INPUTS :  const RenderSnapshot &snapshot, the streaks, as prepared
+*           CompactVertex *dest, where to pack them
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+void ParticleRenderer::packCompact(const RenderSnapshot &snapshot, CompactVertex *dest)
+{
+   const StreakVertex *vertices = snapshot.getVertices();
+   const int *order = depthSort.getValues();
+
+   float scale[3 * MAXCOMPACTGROUPS];		// quanta per unit of each group
+   for (int g = 0; g < numGroups; g++){
+      for (int j = 0; j < 3; j++){
+         scale[3 * g + j] = 65535.0f / extent[3 * g + j];
+      }
+   }
+
+   int numChunks = (numDrawn + RENDERCHUNK - 1) / RENDERCHUNK;
+   parallelFor(numChunks, [&](int c, int worker){
+      int end = Min((c + 1) * RENDERCHUNK, numDrawn);
+      for (int k = c * RENDERCHUNK; k < end; k++){
+         int i = order[k];
+         int g = streakGroup[i];
+#ifdef __SSE2__
+         // both ends at once, 32768 off center, so the signed saturating
+         // pack clamps to 0 .. 65535 once the sign bit is flipped back
+         __m128 o = _mm_setr_ps(origin[3 * g], origin[3 * g + 1], origin[3 * g + 2], 0.0f);
+         __m128 q = _mm_setr_ps(scale[3 * g], scale[3 * g + 1], scale[3 * g + 2], 0.0f);
+         __m128 center = _mm_set1_ps(32768.0f);
+         __m128 p0 = _mm_loadu_ps(vertices[2 * i].position);		// and color[0], dropped
+         __m128 p1 = _mm_loadu_ps(vertices[2 * i + 1].position);
+         __m128i u0 = _mm_cvtps_epi32(_mm_sub_ps(_mm_mul_ps(_mm_sub_ps(p0, o), q), center));
+         __m128i u1 = _mm_cvtps_epi32(_mm_sub_ps(_mm_mul_ps(_mm_sub_ps(p1, o), q), center));
+         __m128i w = _mm_xor_si128(_mm_packs_epi32(u0, u1), _mm_set1_epi16((short)0x8000));
+         w = _mm_and_si128(w, _mm_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0));
+         w = _mm_or_si128(w, _mm_setr_epi16(0, 0, 0, g << 8, 0, 0, 0, 255 | (g << 8)));	// ramp and group
+         _mm_storeu_si128((__m128i *)(dest + 2 * k), w);
+#else
+         for (int e = 0; e < 2; e++){
+            const float *p = vertices[2 * i + e].position;
+            CompactVertex &v = dest[2 * k + e];
+            for (int j = 0; j < 3; j++){
+               int u = (int)((p[j] - origin[3 * g + j]) * scale[3 * g + j] + 0.5f);	// at least 0, the bounds hold p
+               v.position[j] = Min(u, 65535);
+            }
+            v.ramp = e? 255 : 0;
+            v.group = g;
+         }
+#endif
+      }
+   });
+}
+
+//-----------------------------------------------------------------
+/*
+void ParticleRenderer::unpackCompact(const CompactVertex &v, float position[3],
+                                     float color[4])
+* PURPOSE : Unpack a vertex of the compact format as the shader does, to
+*           check how far it is from the vertex it was packed from
+* INPUTS :  const CompactVertex &v, the vertex, from packCompact()
+*           float position[3], float color[4], where to unpack it
+* OUTPUTS : NONE, sets position and color
+*/
+//-----------------------------------------------------------------
+
+void ParticleRenderer::unpackCompact(const CompactVertex &v, float position[3], float color[4])
+{
+   int g = v.group;
+   for (int j = 0; j < 3; j++){
+      position[j] = origin[3 * g + j] + (v.position[j] / 65535.0f) * extent[3 * g + j];
+   }
+   float t = v.ramp / 255.0f;
+   for (int k = 0; k < 4; k++){
+      color[k] = startColor[4 * g + k] + t * (endColor[4 * g + k] - startColor[4 * g + k]);
+   }
+}
+
+//-----------------------------------------------------------------
+/*
+int ParticleRenderer::prepare(const RenderSnapshot &snapshot)
+* PURPOSE : Cull the streaks of every list of the snapshot to the
+*           camera's view, and sort the rest farthest first, ready to
+*           pack. If the compact format is on, find whether they can be
+*           packed in it, and the bounds and colors of each group.
+* INPUTS :  const RenderSnapshot &snapshot, the particles to draw
+* OUTPUTS : int, number of streaks to draw
+*/
+//-----------------------------------------------------------------
+
+int ParticleRenderer::prepare(const RenderSnapshot &snapshot)
+{
+   int numStreaks = snapshot.getNumVertices() / 2;
+   int numLists = snapshot.getNumLists();
+   numDrawn = 0;
+   compactable = false;
+   if (numStreaks == 0)
+      return 0;
+
+   if (numStreaks > maxStreaks){
+      delete [] visible;
+      delete [] streakGroup;
+      maxStreaks = Max(numStreaks, 2 * maxStreaks);
+      visible = new unsigned char[maxStreaks];
+      streakGroup = new unsigned char[maxStreaks];
+   }
+   if (numLists + 1 > maxLists){
+      delete [] listChunks;
+      maxLists = numLists + 1;
+      listChunks = new int[maxLists];
+   }
+
+   // split the streaks of each list into chunks
+   listChunks[0] = 0;
+   for (int l = 0; l < numLists; l++){
+      int count = snapshot.getCount(l) / 2;
+      listChunks[l + 1] = listChunks[l] + (count + RENDERCHUNK - 1) / RENDERCHUNK;
+   }
+   int numChunks = listChunks[numLists];
+   if (numChunks + 1 > maxChunks){
+      delete [] chunkBegin;
+      delete [] chunkEnd;
+      delete [] chunkStart;
+      delete [] chunkGroups;
+      delete [] chunkBounds;
+      delete [] chunkColors;
+      delete [] chunkRemap;
+      maxChunks = numChunks + 1;
+      chunkBegin = new int[maxChunks];
+      chunkEnd = new int[maxChunks];
+      chunkStart = new int[maxChunks];
+      chunkGroups = new int[maxChunks];
+      chunkBounds = new float[6 * CHUNKGROUPS * maxChunks];
+      chunkColors = new float[8 * CHUNKGROUPS * maxChunks];
+      chunkRemap = new unsigned char[CHUNKGROUPS * maxChunks];
+   }
+   for (int l = 0; l < numLists; l++){
+      int first = snapshot.getFirst(l) / 2;
+      int end = first + snapshot.getCount(l) / 2;
+      for (int c = listChunks[l]; c < listChunks[l + 1]; c++){
+         chunkBegin[c] = first + (c - listChunks[l]) * RENDERCHUNK;
+         chunkEnd[c] = Min(chunkBegin[c] + RENDERCHUNK, end);
+      }
+   }
+
+   // cull each chunk, and sum the visible streaks to find where each chunk starts
+   const StreakVertex *vertices = snapshot.getVertices();
+   parallelFor(numChunks, [&](int c, int worker){
+      int begin = chunkBegin[c];
+      chunkStart[c + 1] = frustum.cullStreaks(vertices + 2 * begin, chunkEnd[c] - begin, visible + begin);
+   });
+   chunkStart[0] = 0;
+   for (int c = 0; c < numChunks; c++){
+      chunkStart[c + 1] = chunkStart[c + 1] + chunkStart[c];
+   }
+
+   numDrawn = chunkStart[numChunks];
+   if (numDrawn == 0)
+      return 0;
+
+   // sort the visible streaks farthest first, by the depth of their midpoints,
+   // and sort them into groups by color, finding the bounds of each, for the
+   // compact format
+   bool compact = compactOn;
+   depthSort.reserve(numDrawn);
+   unsigned int *keys = depthSort.getKeys();
+   int *order = depthSort.getValues();
+   const float *D = viewDepth;
+   parallelFor(numChunks, [&](int c, int worker){
+      float *bounds = chunkBounds + 6 * CHUNKGROUPS * c;
+      float *colors = chunkColors + 8 * CHUNKGROUPS * c;
+      int groups = 0;
+      int g = 0;		// group of the last streak, most likely that of the next
+
+      int k = chunkStart[c];
+      for (int i = chunkBegin[c]; i < chunkEnd[c]; i++){
+         if (!visible[i])
+            continue;
+         const float *p0 = vertices[2 * i].position;
+         const float *p1 = vertices[2 * i + 1].position;
+         float distance = 0.5f * (D[0] * (p0[0] + p1[0]) + D[1] * (p0[1] + p1[1]) + D[2] * (p0[2] + p1[2])) + D[3];
+         keys[k] = DepthSort::backToFront(distance);
+         order[k] = i;
+         k++;
+
+         if (!compact || groups > CHUNKGROUPS)
+            continue;
+         const float *color0 = vertices[2 * i].color;
+         const float *color1 = vertices[2 * i + 1].color;
+         if (groups == 0 || !sameColors(colors + 8 * g, color0, color1)){
+            g = 0;
+            while (g < groups && !sameColors(colors + 8 * g, color0, color1))
+               g++;
+            if (g == groups){
+               groups++;
+               if (groups > CHUNKGROUPS)
+                  continue;		// too many, the frame is drawn in floats
+               memcpy(colors + 8 * g, color0, 4 * sizeof(float));
+               memcpy(colors + 8 * g + 4, color1, 4 * sizeof(float));
+               bounds[6 * g] = bounds[6 * g + 1] = bounds[6 * g + 2] = HUGE_VALF;
+               bounds[6 * g + 3] = bounds[6 * g + 4] = bounds[6 * g + 5] = -HUGE_VALF;
+            }
+         }
+         streakGroup[i] = g;
+         for (int j = 0; j < 3; j++){
+            bounds[6 * g + j] = Min(bounds[6 * g + j], Min(p0[j], p1[j]));
+            bounds[6 * g + 3 + j] = Max(bounds[6 * g + 3 + j], Max(p0[j], p1[j]));
+         }
+      }
+      chunkGroups[c] = groups;
+   });
+   depthSort.sort(numDrawn);
+
+   if (!compact)
+      return numDrawn;
+
+   // merge the groups of the chunks of each list that have the same colors
+   float bounds[6 * MAXCOMPACTGROUPS];
+   numGroups = 0;
+   for (int l = 0; l < numLists; l++){
+      int firstGroup = numGroups;
+      for (int c = listChunks[l]; c < listChunks[l + 1]; c++){
+         if (chunkGroups[c] > CHUNKGROUPS)
+            return numDrawn;
+         for (int g = 0; g < chunkGroups[c]; g++){
+            const float *colors = chunkColors + 8 * (CHUNKGROUPS * c + g);
+            int h = firstGroup;
+            while (h < numGroups && !(memcmp(startColor + 4 * h, colors, 4 * sizeof(float)) == 0 &&
+                                      memcmp(endColor + 4 * h, colors + 4, 4 * sizeof(float)) == 0))
+               h++;
+            if (h == numGroups){
+               if (numGroups == MAXCOMPACTGROUPS)
+                  return numDrawn;
+               memcpy(startColor + 4 * h, colors, 4 * sizeof(float));
+               memcpy(endColor + 4 * h, colors + 4, 4 * sizeof(float));
+               bounds[6 * h] = bounds[6 * h + 1] = bounds[6 * h + 2] = HUGE_VALF;
+               bounds[6 * h + 3] = bounds[6 * h + 4] = bounds[6 * h + 5] = -HUGE_VALF;
+               numGroups++;
+            }
+            const float *b = chunkBounds + 6 * (CHUNKGROUPS * c + g);
+            for (int j = 0; j < 3; j++){
+               bounds[6 * h + j] = Min(bounds[6 * h + j], b[j]);
+               bounds[6 * h + 3 + j] = Max(bounds[6 * h + 3 + j], b[3 + j]);
+            }
+            chunkRemap[CHUNKGROUPS * c + g] = h;
+         }
+      }
+   }
+
+   for (int g = 0; g < numGroups; g++){
+      for (int j = 0; j < 3; j++){
+         origin[3 * g + j] = bounds[6 * g + j];
+         extent[3 * g + j] = bounds[6 * g + 3 + j] - bounds[6 * g + j];
+         if (extent[3 * g + j] <= 0.0f)
+            extent[3 * g + j] = 1.0f;	// every streak at the same place, any extent does
+      }
+   }
+
+   // from the groups of each chunk to those of the snapshot
+   parallelFor(numChunks, [&](int c, int worker){
+      const unsigned char *remap = chunkRemap + CHUNKGROUPS * c;
+      for (int i = chunkBegin[c]; i < chunkEnd[c]; i++){
+         if (visible[i])
+            streakGroup[i] = remap[streakGroup[i]];
+      }
+   });
+   compactable = true;
+
+   return numDrawn;
+}
+
+//-----------------------------------------------------------------
+/*
+bool ParticleRenderer::makeProgram()
+* PURPOSE : Make the shader that unpacks the compact format, on first
+*           use. Without OpenGL 2.0, or if it does not build, the
+*           compact format is not used.
+* INPUTS :  NONE
+* OUTPUTS : bool, true if the program is ready
+*/
+//-----------------------------------------------------------------
+
+bool ParticleRenderer::makeProgram()
+{
+   if (programState != 0)
+      return programState > 0;
+   programState = -1;
+
+   int major = 0;
+   const char *version = (const char *)glGetString(GL_VERSION);
+   if (version == NULL || sscanf(version, "%d", &major) != 1 || major < 2)
+      return false;
+
+   char vertexSource[1024];
+   snprintf(vertexSource, sizeof(vertexSource), compactShader,
+            MAXCOMPACTGROUPS, MAXCOMPACTGROUPS, MAXCOMPACTGROUPS, MAXCOMPACTGROUPS);
+   const char *sources[2] = {vertexSource, colorShader};
+   GLenum types[2] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER};
+
+   program = glCreateProgram();
+   for (int k = 0; k < 2; k++){
+      GLuint shader = glCreateShader(types[k]);
+      glShaderSource(shader, 1, &sources[k], NULL);
+      glCompileShader(shader);
+      GLint compiled;
+      glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+      if (!compiled){
+         char log[1024];
+         glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+         error("ParticleRenderer:", "compact format shader did not compile, drawing in floats", log);
+         glDeleteShader(shader);
+         return false;
+      }
+      glAttachShader(program, shader);
+      glDeleteShader(shader);		// deleted along with the program
+   }
+
+   glBindAttribLocation(program, 0, "quantized");
+   glBindAttribLocation(program, 1, "rampGroup");
+   glLinkProgram(program);
+   GLint linked;
+   glGetProgramiv(program, GL_LINK_STATUS, &linked);
+   if (!linked){
+      char log[1024];
+      glGetProgramInfoLog(program, sizeof(log), NULL, log);
+      error("ParticleRenderer:", "compact format shader did not link, drawing in floats", log);
+      return false;
+   }
+
+   originLoc = glGetUniformLocation(program, "origin");
+   extentLoc = glGetUniformLocation(program, "extent");
+   startColorLoc = glGetUniformLocation(program, "startColor");
+   endColorLoc = glGetUniformLocation(program, "endColor");
+   programState = 1;
+   return true;
+}
+
+//-----------------------------------------------------------------
+/*
+void ParticleRenderer::draw(const RenderSnapshot &snapshot)
+* PURPOSE : Draw the streaks of every list of the snapshot as lines,
+*           farthest first, leaving out those outside the camera's view,
+*           in the compact format if it is on and the snapshot allows
+* INPUTS :  const RenderSnapshot &snapshot, the particles to draw
+* OUTPUTS : NONE, draws
+*/
+//-----------------------------------------------------------------
+
+void ParticleRenderer::draw(const RenderSnapshot &snapshot)
+{
+   if (prepare(snapshot) == 0)
+      return;
+
+   bool compact = compactable && makeProgram();
+   int numVertices = 2 * numDrawn;
+   size_t bytes = numVertices * (compact? sizeof(CompactVertex) : sizeof(StreakVertex));
+   if (bytes > capacity)
+      capacity = Max(bytes, 2 * capacity);
+
+   if (buffer == 0)
+      glGenBuffers(1, &buffer);
+   glBindBuffer(GL_ARRAY_BUFFER, buffer);
+   glBufferData(GL_ARRAY_BUFFER, capacity, NULL, GL_STREAM_DRAW);	// orphan last frame's storage
+
+   void *data = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+   if (data != NULL){
+      if (compact)
+         packCompact(snapshot, (CompactVertex *)data);
+      else
+         pack(snapshot, (StreakVertex *)data);
+   }
+   if (data == NULL || glUnmapBuffer(GL_ARRAY_BUFFER) == GL_FALSE){
+      // mapping failed, or the storage was lost while mapped, copy it in instead
+      if (bytes > stagingSize){
+         delete [] staging;
+         stagingSize = Max(bytes, 2 * stagingSize);
+         staging = new unsigned char[stagingSize];
+      }
+      if (compact)
+         packCompact(snapshot, (CompactVertex *)staging);
+      else
+         pack(snapshot, (StreakVertex *)staging);
+      glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, staging);
+   }
+
+   if (compact){
+      glUseProgram(program);
+      glUniform3fv(originLoc, numGroups, origin);
+      glUniform3fv(extentLoc, numGroups, extent);
+      glUniform4fv(startColorLoc, numGroups, startColor);
+      glUniform4fv(endColorLoc, numGroups, endColor);
+
+      glEnableVertexAttribArray(0);
+      glEnableVertexAttribArray(1);
+      glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactVertex), (void *)offsetof(CompactVertex, position));
+      glVertexAttribPointer(1, 2, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(CompactVertex), (void *)offsetof(CompactVertex, ramp));
+
+      glDrawArrays(GL_LINES, 0, numVertices);
+
+      glDisableVertexAttribArray(1);
+      glDisableVertexAttribArray(0);
+      glUseProgram(0);
+   }
+   else{
+      glEnableClientState(GL_VERTEX_ARRAY);
+      glEnableClientState(GL_COLOR_ARRAY);
+      glVertexPointer(3, GL_FLOAT, sizeof(StreakVertex), (void *)offsetof(StreakVertex, position));
+      glColorPointer(4, GL_FLOAT, sizeof(StreakVertex), (void *)offsetof(StreakVertex, color));
+
+      glDrawArrays(GL_LINES, 0, numVertices);
+
+      glDisableClientState(GL_COLOR_ARRAY);
+      glDisableClientState(GL_VERTEX_ARRAY);
+   }
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
@@ -0,0 +1,86 @@
+/*
+* ParticleRenderer.h
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/17/2018
+* Version 1.0
+*/
+
+#ifndef __PARTICLERENDERER_H__
+#define __PARTICLERENDERER_H__
+
+#include "RenderSnapshot.h"
+#include "Frustum.h"
+#include "DepthSort.h"
+#include "Camera.h"
+
+#include <cstddef>
+
+#define MAXCOMPACTGROUPS 16	// most groups of streaks drawn in the compact format, more are drawn in floats
+#define CHUNKGROUPS 4		// most groups a chunk of streaks may have in the compact format
+
+struct CompactVertex{		// One end of a streak in the compact format, 8 bytes against 28
+   unsigned short position[3];	// 0 to 65535 across the bounds of its group's visible streaks
+   unsigned char ramp;		// 0 at the start of the streak, 255 at the end, picks its color
+   unsigned char group;		// group of streaks of one list and colors it is in, picks its bounds and colors
+};
+
+class ParticleRenderer{		// Draws a RenderSnapshot from one vertex buffer per frame
+   private:
+      unsigned int buffer;	// GL buffer object, made on the first draw
+      size_t capacity;		// bytes allocated for the buffer
+
+      Frustum frustum;		// view volume of the camera, streaks outside it are not drawn
+      unsigned char *visible;	// whether each streak of the snapshot is inside the frustum
+      int maxStreaks;
+      int *chunkBegin;		// streaks of each chunk culled together, no chunk spans two lists
+      int *chunkEnd;
+      int *chunkStart;		// where each chunk's visible streaks start in the sort
+      int maxChunks;
+      int *listChunks;		// first chunk of each list
+      int maxLists;
+
+      float viewDepth[4];	// distance in front of the camera is a x + b y + c z + d
+      DepthSort depthSort;	// orders the visible streaks farthest first
+
+      bool compactOn;		// whether to draw in the compact format when the snapshot allows
+      bool compactable;		// whether the streaks last prepared can be packed compact
+      unsigned char *streakGroup;	// group of each visible streak, of its chunk and then of the snapshot
+      int *chunkGroups;		// groups of each chunk, more than CHUNKGROUPS if too many
+      float *chunkBounds;	// min then max corner of each group of each chunk
+      float *chunkColors;	// start then end color of each group of each chunk
+      unsigned char *chunkRemap;	// group of the snapshot of each group of each chunk
+      int numGroups;		// groups of the snapshot
+      float origin[3 * MAXCOMPACTGROUPS];	// bounds of the visible streaks of each group
+      float extent[3 * MAXCOMPACTGROUPS];
+      float startColor[4 * MAXCOMPACTGROUPS];	// colors of the streaks of each group
+      float endColor[4 * MAXCOMPACTGROUPS];
+      unsigned int program;	// shader that unpacks the compact format, made on first use
+      int programState;		// 0 not yet made, 1 made, -1 failed, draw in floats
+      int originLoc, extentLoc, startColorLoc, endColorLoc;	// uniforms of the program
+
+      unsigned char *staging;	// packed streaks, when the buffer cannot be mapped
+      size_t stagingSize;
+      int numDrawn;		// streaks drawn last frame
+
+      bool makeProgram();
+
+   public:
+      ParticleRenderer();
+
+      void setCamera(const Camera &camera, int w, int h);
+      void setCompact(bool on){compactOn = on;}
+      bool getCompact(){return compactOn;}
+
+      int prepare(const RenderSnapshot &snapshot);
+      bool isCompactable(){return compactable;}
+      void pack(const RenderSnapshot &snapshot, StreakVertex *dest);
+      void packCompact(const RenderSnapshot &snapshot, CompactVertex *dest);
+      void unpackCompact(const CompactVertex &v, float position[3], float color[4]);
+
+      void draw(const RenderSnapshot &snapshot);
+
+      int getNumDrawn(){return numDrawn;}
+};
+
+#endif
@@ -0,0 +1,318 @@
+/*
+* PerfHUD.cpp
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/23/2018
+* Version 1.0
+*
+* When the animation stutters, the PerfHUD shows where the time goes. It
+* is drawn over the window, in its top left corner: the frame rate, the
+* simulation steps taken each frame, the active particles of each
+* generator against its capacity, and a rolling graph of the last
+* HUDFRAMES frames of each of
+*   - the time between frames,
+*   - the steps taken between frames,
+*   - the time spent in each stage of those steps (see SimStage),
+*   - the time the View spent drawing the frame.
+* The simulation runs on a thread of its own, so the Model adds up the
+* time spent in each stage, and each RenderSnapshot carries the totals as
+* of its step; the time spent between two frames is the difference of
+* their snapshots' totals. The Model times the stages only while the HUD
+* is shown, and the View does not time or draw anything for it otherwise,
+* so it costs nothing while hidden. Each graph is scaled to its peak over
+* the frames shown, and labeled with its mean and peak.
+*/
+
+#include "PerfHUD.h"
+#include "Utility.h"
+
+#ifdef __APPLE__
+#  pragma clang diagnostic ignored "-Wdeprecated-declarations"
+#  include <GLUT/glut.h>
+#else
+#  include <GL/glut.h>
+#endif
+
+#include <cstdio>
+
+using namespace std;
+
+#define HUDMARGIN	8	// pixels around the panel and between its rows
+#define HUDROW		22	// pixels from one row of the panel to the next
+#define HUDLABEL	170	// pixels of the labels, left of the graphs
+
+// name and color of each graph
+static const char *graphNames[NUMGRAPHS] = {
+   "frame", "steps", "update", "emit", "collide", "reorder", "capture", "draw"
+};
+static const float graphColors[NUMGRAPHS][3] = {
+   {1.0, 1.0, 1.0}, {0.6, 0.8, 1.0}, {0.4, 1.0, 0.4}, {1.0, 0.8, 0.3},
+   {1.0, 0.4, 0.4}, {0.8, 0.5, 1.0}, {0.4, 0.9, 0.9}, {1.0, 0.6, 0.8}
+};
+
+//-----------------------------------------------------------------
+/*
+PerfHUD::PerfHUD()
+* PURPOSE : Constructor, no frames taken yet
+* INPUTS :  NONE
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+PerfHUD::PerfHUD()
+{
+   active = NULL;
+   capacity = NULL;
+   numLists = 0;
+   maxLists = 0;
+   reset();
+}
+
+//-----------------------------------------------------------------
+/*
+void PerfHUD::reset()
+* PURPOSE : Forget the frames taken, when the HUD is shown again, so the
+*           time it was hidden does not show as one long frame
+* INPUTS :  NONE
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+void PerfHUD::reset()
+{
+   next = 0;
+   numSamples = 0;
+   lastFrame = 0.0;
+   counting = false;
+   lastSteps = 0;
+   for (int s = 0; s < NUMSIMSTAGES; s++)
+      lastStageTime[s] = 0.0;
+   numLists = 0;
+}
+
+//-----------------------------------------------------------------
+/*
+void PerfHUD::update(const RenderSnapshot *snapshot, double drawMs)
+* PURPOSE : Take a sample of each graph for the frame just drawn. The
+*           first frame after a reset only starts the clock.
+* INPUTS :  const RenderSnapshot *snapshot, the snapshot the frame drew,
+*           NULL if it drew none, which counts as no steps taken
+*           double drawMs, milliseconds the View spent drawing the frame
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+void PerfHUD::update(const RenderSnapshot *snapshot, double drawMs)
+{
+   double now = wallclock();
+   bool counted = counting && snapshot != NULL;	// steps and stage times since the last frame are known
+   long long steps = 0;
+   double stageTime[NUMSIMSTAGES];
+   for (int s = 0; s < NUMSIMSTAGES; s++)
+      stageTime[s] = (snapshot != NULL)? snapshot->getStageTime(s) : 0.0;
+   if (snapshot != NULL)
+      steps = snapshot->getSteps();
+
+   if (lastFrame != 0.0){
+      float *sample[NUMGRAPHS];
+      for (int g = 0; g < NUMGRAPHS; g++)
+         sample[g] = &samples[g][next];
+
+      *sample[GRAPH_FRAME] = 1000.0 * (now - lastFrame);
+      *sample[GRAPH_STEPS] = counted? Max(steps - lastSteps, 0LL) : 0;
+      for (int s = 0; s < NUMSIMSTAGES; s++)
+         *sample[GRAPH_STAGES + s] = counted? Max(1000.0 * (stageTime[s] - lastStageTime[s]), 0.0) : 0.0;
+      *sample[GRAPH_DRAW] = drawMs;
+
+      next = (next + 1) % HUDFRAMES;
+      numSamples = Min(numSamples + 1, HUDFRAMES);
+   }
+
+   lastFrame = now;
+   counting = snapshot != NULL;
+   lastSteps = steps;
+   for (int s = 0; s < NUMSIMSTAGES; s++)
+      lastStageTime[s] = stageTime[s];
+
+   numLists = (snapshot != NULL)? snapshot->getNumLists() : 0;
+   if (numLists > maxLists){
+      delete [] active;
+      delete [] capacity;
+      maxLists = numLists;
+      active = new int[maxLists];
+      capacity = new int[maxLists];
+   }
+   for (int l = 0; l < numLists; l++){
+      active[l] = snapshot->getCount(l) / 2;
+      capacity[l] = snapshot->getCapacity(l);
+   }
+}
+
+//-----------------------------------------------------------------
+/*
+float PerfHUD::mean(int graph)
+float PerfHUD::peak(int graph)
+* PURPOSE : Mean and peak of a graph's samples
+* INPUTS :  int graph, a HUDGraph
+* OUTPUTS : float, the mean or peak, 0 if there are no samples
+*/
+//-----------------------------------------------------------------
+
+float PerfHUD::mean(int graph)
+{
+   float sum = 0.0;
+   for (int k = 0; k < numSamples; k++)
+      sum = sum + samples[graph][k];
+   return (numSamples > 0)? sum / numSamples : 0.0;
+}
+
+float PerfHUD::peak(int graph)
+{
+   float most = 0.0;
+   for (int k = 0; k < numSamples; k++)
+      most = Max(most, samples[graph][k]);
+   return most;
+}
+
+//-----------------------------------------------------------------
+/*
+void PerfHUD::drawText(float x, float y, const char *text)
+* PURPOSE : Draw a line of text in the current color
+* INPUTS :  float x, y, pixels of the left end of its baseline
+*           const char *text, the text
+* OUTPUTS : NONE, draws
+*/
+//-----------------------------------------------------------------
+
+void PerfHUD::drawText(float x, float y, const char *text)
+{
+   glRasterPos2f(x, y);
+   for (const char *c = text; *c != '\0'; c++)
+      glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, *c);
+}
+
+//-----------------------------------------------------------------
+/*
+void PerfHUD::drawGraph(int graph, float x, float y, float w, float h)
+* PURPOSE : Draw a graph's samples, oldest on the left, newest on the
+*           right, scaled so its peak reaches the top
+* INPUTS :  int graph, a HUDGraph
+*           float x, y, pixels of its lower left corner
+*           float w, h, its width, HUDFRAMES, and height in pixels
+* OUTPUTS : NONE, draws
+*/
+//-----------------------------------------------------------------
+
+void PerfHUD::drawGraph(int graph, float x, float y, float w, float h)
+{
+   glColor4f(1.0, 1.0, 1.0, 0.15);
+   glBegin(GL_QUADS);
+   glVertex2f(x, y);
+   glVertex2f(x + w, y);
+   glVertex2f(x + w, y + h);
+   glVertex2f(x, y + h);
+   glEnd();
+
+   float scale = h / Max(peak(graph), 1.0f);	// at least 1 ms, or 1 step, to the top
+   glColor3fv(graphColors[graph]);
+   glBegin(GL_LINE_STRIP);
+   for (int k = 0; k < numSamples; k++){
+      int oldest = (numSamples < HUDFRAMES)? 0 : next;
+      float v = samples[graph][(oldest + k) % HUDFRAMES];
+      glVertex2f(x + w - numSamples + k + 0.5f, y + v * scale);
+   }
+   glEnd();
+}
+
+//-----------------------------------------------------------------
+/*
+void PerfHUD::draw(int width, int height)
+* PURPOSE : Draw the HUD over the viewport, in its top left corner. The
+*           OpenGL state it changes is put back.
+* INPUTS :  int width, height, size of the viewport in pixels
+* OUTPUTS : NONE, draws
+*/
+//-----------------------------------------------------------------
+
+void PerfHUD::draw(int width, int height)
+{
+   glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_LINE_BIT | GL_COLOR_BUFFER_BIT);
+   glDisable(GL_LIGHTING);
+   glDisable(GL_DEPTH_TEST);
+   glEnable(GL_BLEND);
+   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+   glLineWidth(1.0);
+
+   // pixel coordinates, bottom left at 0, 0
+   glMatrixMode(GL_PROJECTION);
+   glPushMatrix();
+   glLoadIdentity();
+   glOrtho(0, width, 0, height, -1, 1);
+   glMatrixMode(GL_MODELVIEW);
+   glPushMatrix();
+   glLoadIdentity();
+
+   int rows = 1 + NUMGRAPHS + numLists;
+   float panelWidth = 3 * HUDMARGIN + HUDLABEL + HUDFRAMES;
+   float panelHeight = HUDMARGIN + rows * HUDROW;
+   float left = HUDMARGIN;
+   float top = height - HUDMARGIN;
+   glColor4f(0.0, 0.0, 0.0, 0.6);
+   glBegin(GL_QUADS);
+   glVertex2f(left, top - panelHeight);
+   glVertex2f(left + panelWidth, top - panelHeight);
+   glVertex2f(left + panelWidth, top);
+   glVertex2f(left, top);
+   glEnd();
+
+   float x = left + HUDMARGIN;
+   float graphX = x + HUDLABEL + HUDMARGIN;
+   float graphHeight = HUDROW - 4;
+   float y = top - HUDROW;		// baseline of the row
+   char text[128];
+
+   float frameMs = mean(GRAPH_FRAME);
+   snprintf(text, sizeof(text), "%.1f fps, %.2f steps/frame",
+            (frameMs > 0.0)? 1000.0 / frameMs : 0.0, mean(GRAPH_STEPS));
+   glColor3f(1.0, 1.0, 1.0);
+   drawText(x, y + 6, text);
+
+   for (int g = 0; g < NUMGRAPHS; g++){
+      y = y - HUDROW;
+      if (g == GRAPH_STEPS)
+         snprintf(text, sizeof(text), "%s %.2f / %.0f", graphNames[g], mean(g), peak(g));
+      else
+         snprintf(text, sizeof(text), "%s %.2f / %.2f ms", graphNames[g], mean(g), peak(g));
+      glColor3fv(graphColors[g]);
+      drawText(x, y + 6, text);
+      drawGraph(g, graphX, y, HUDFRAMES, graphHeight);
+   }
+
+   // active particles of each generator, and a bar of how full its list is
+   for (int l = 0; l < numLists; l++){
+      y = y - HUDROW;
+      snprintf(text, sizeof(text), "gen %d %d / %d", l + 1, active[l], capacity[l]);
+      glColor3f(1.0, 1.0, 1.0);
+      drawText(x, y + 6, text);
+
+      float full = (capacity[l] > 0)? float(active[l]) / capacity[l] : 0.0;
+      glColor4f(1.0, 1.0, 1.0, 0.15);
+      glBegin(GL_QUADS);
+      glVertex2f(graphX, y + 4);
+      glVertex2f(graphX + HUDFRAMES, y + 4);
+      glVertex2f(graphX + HUDFRAMES, y + graphHeight - 4);
+      glVertex2f(graphX, y + graphHeight - 4);
+      glColor4f(0.4, 1.0, 0.4, 0.8);
+      glVertex2f(graphX, y + 4);
+      glVertex2f(graphX + full * HUDFRAMES, y + 4);
+      glVertex2f(graphX + full * HUDFRAMES, y + graphHeight - 4);
+      glVertex2f(graphX, y + graphHeight - 4);
+      glEnd();
+   }
+
+   glPopMatrix();
+   glMatrixMode(GL_PROJECTION);
+   glPopMatrix();
+   glMatrixMode(GL_MODELVIEW);
+   glPopAttrib();
+}
@@ -0,0 +1,53 @@
+/*
+* PerfHUD.h
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/23/2018
+* Version 1.0
+*/
+
+#ifndef __PERFHUD_H__
+#define __PERFHUD_H__
+
+#include "RenderSnapshot.h"
+
+#define HUDFRAMES 120		// frames shown in each graph, a pixel each
+
+enum HUDGraph{			// Rolling graphs of the HUD, a sample each frame
+   GRAPH_FRAME,			// milliseconds since the last frame
+   GRAPH_STEPS,			// simulation steps since the last frame
+   GRAPH_STAGES,		// milliseconds spent in each SimStage since the last frame, NUMSIMSTAGES graphs
+   GRAPH_DRAW = GRAPH_STAGES + NUMSIMSTAGES,	// milliseconds the View spent drawing the frame
+   NUMGRAPHS
+};
+
+class PerfHUD{			// Shows the frame rate, particle counts and time spent in each stage over the window
+   private:
+      float samples[NUMGRAPHS][HUDFRAMES];	// last HUDFRAMES samples of each graph, oldest at next
+      int next;			// where the next sample goes
+      int numSamples;		// samples taken, up to HUDFRAMES
+
+      double lastFrame;		// wall clock time of the last frame, 0 before the first
+      bool counting;		// whether the last frame drew a snapshot to count steps from
+      long long lastSteps;	// steps and stage times of the snapshot of the last frame
+      double lastStageTime[NUMSIMSTAGES];
+
+      int *active;		// active particles of each list of the last snapshot
+      int *capacity;		// particles each list has room for
+      int numLists;
+      int maxLists;
+
+      float mean(int graph);
+      float peak(int graph);
+      void drawText(float x, float y, const char *text);
+      void drawGraph(int graph, float x, float y, float w, float h);
+
+   public:
+      PerfHUD();
+
+      void reset();
+      void update(const RenderSnapshot *snapshot, double drawMs);
+      void draw(int width, int height);
+};
+
+#endif
@@ -0,0 +1,263 @@
+/*
+* RateCurve.cpp
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/13/2018
+* Version 1.0
+*
+* A RateCurve is the schedule a ParticleGenerator emits on, given as
+* keys of (time, particles per second) with the rate linear between
+* keys. Two keys at the same time make a jump, so on/off schedules are
+* just pairs of keys. The rate is zero before the first key, and holds
+* at the last key's rate after it, unless the curve loops, in which case
+* the section [loopStart, loopEnd) repeats forever after loopEnd.
+*
+* The generator does not ask for the rate, but for the integral of the
+* rate since the first key, which is the number of particles that should
+* have been emitted by time t. The number to emit in a step is then the
+* difference of the integral at either end, rounded down, and no
+* fraction is ever lost between steps. The integral at each key is kept
+* in a table, and the segment found by the last lookup is remembered, so
+* since the simulation time only moves forward each lookup is O(1).
+*/
+
+#include "RateCurve.h"
+#include "Utility.h"
+
+#include <cmath>
+#include <cstddef>
+
+using namespace std;
+
+//-----------------------------------------------------------------
+/*
+RateCurve::RateCurve()
+RateCurve::RateCurve(float rate)
+*
+* PURPOSE : Constructors, an empty curve (no emission), or a curve
+*           with a constant rate from time 0
+* INPUTS :  float rate, particles per second
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+RateCurve::RateCurve()
+{
+   times = NULL;
+   rates = NULL;
+   cumulative = NULL;
+   numKeys = 0;
+   maxKeys = 0;
+
+   loopStart = 0.0;
+   loopEnd = 0.0;
+   loopCount = 0.0;
+   cursor = -1;
+}
+
+RateCurve::RateCurve(float rate)
+{
+   times = NULL;
+   rates = NULL;
+   cumulative = NULL;
+   numKeys = 0;
+   maxKeys = 0;
+
+   loopStart = 0.0;
+   loopEnd = 0.0;
+   loopCount = 0.0;
+   cursor = -1;
+
+   addKey(0.0, rate);
+}
+
+//-----------------------------------------------------------------
+/*
+void RateCurve::clear()
+* PURPOSE : Remove all keys and the loop, the curve no longer emits.
+*           Storage for the keys is kept to be reused.
+* INPUTS :  NONE
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+void RateCurve::clear()
+{
+   numKeys = 0;
+   loopStart = 0.0;
+   loopEnd = 0.0;
+   loopCount = 0.0;
+   cursor = -1;
+}
+
+//-----------------------------------------------------------------
+/*
+void RateCurve::addKey(float t, float rate)
+* PURPOSE : Add a key to the curve. Keys may be added in any order,
+*           a key at the same time as an existing one goes after it,
+*           making a jump in the rate.
+* INPUTS :  float t, time of the key
+*           float rate, particles per second at that time
+* OUTPUTS : NONE, updates the integral table
+*/
+//-----------------------------------------------------------------
+
+void RateCurve::addKey(float t, float rate)
+{
+   if (numKeys == maxKeys){			// grow the arrays
+      maxKeys = (maxKeys == 0)? 8 : 2 * maxKeys;
+      float *newTimes = new float[maxKeys];
+      float *newRates = new float[maxKeys];
+      double *newCumulative = new double[maxKeys];
+      for (int i = 0; i < numKeys; i++){
+         newTimes[i] = times[i];
+         newRates[i] = rates[i];
+         newCumulative[i] = cumulative[i];
+      }
+      delete [] times;
+      delete [] rates;
+      delete [] cumulative;
+      times = newTimes;
+      rates = newRates;
+      cumulative = newCumulative;
+   }
+
+   int k = numKeys;
+   while (k > 0 && times[k - 1] > t){		// insert in time order
+      times[k] = times[k - 1];
+      rates[k] = rates[k - 1];
+      k--;
+   }
+   times[k] = t;
+   rates[k] = rate;
+   numKeys++;
+
+   // integral is trapezoids of the linear segments
+   for (int i = k; i < numKeys; i++){
+      if (i == 0)
+         cumulative[i] = 0.0;
+      else
+         cumulative[i] = cumulative[i - 1] +
+                         0.5 * (rates[i - 1] + rates[i]) * (times[i] - times[i - 1]);
+   }
+
+   cursor = -1;
+   setLoop(loopStart, loopEnd);
+}
+
+//-----------------------------------------------------------------
+/*
+void RateCurve::setLoop(float start, float end)
+* PURPOSE : Repeat the section of the curve from start to end forever
+*           once the time passes end
+* INPUTS :  float start, end, times bounding the loop, end <= start
+*           turns looping off
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+void RateCurve::setLoop(float start, float end)
+{
+   loopStart = start;
+   loopEnd = end;
+   loopCount = (loopEnd > loopStart)? integralBase(loopEnd) - integralBase(loopStart) : 0.0;
+}
+
+//-----------------------------------------------------------------
+/*
+void RateCurve::locate(double t)
+* PURPOSE : Move the cursor to the segment containing t. Segment i runs
+*           from key i to key i + 1, -1 is before the first key, and
+*           numKeys - 1 after the last. Starting from the last segment
+*           found, this is usually no or one step.
+* INPUTS :  double t, time on the curve (not past the loop)
+* OUTPUTS : NONE, updates cursor
+*/
+//-----------------------------------------------------------------
+
+void RateCurve::locate(double t)
+{
+   while (cursor >= 0 && t < times[cursor])
+      cursor--;
+   while (cursor + 1 < numKeys && t >= times[cursor + 1])
+      cursor++;
+}
+
+//-----------------------------------------------------------------
+/*
+double RateCurve::integralBase(double t)
+* PURPOSE : Integral of the rate from the first key to t, ignoring
+*           the loop
+* INPUTS :  double t, time on the curve
+* OUTPUTS : double, number of particles emitted by time t
+*/
+//-----------------------------------------------------------------
+
+double RateCurve::integralBase(double t)
+{
+   locate(t);
+   if (cursor < 0)
+      return 0.0;
+
+   int i = cursor;
+   double dt = t - times[i];
+   if (i == numKeys - 1)				// past the last key, rate holds
+      return cumulative[i] + rates[i] * dt;
+
+   double slope = (rates[i + 1] - rates[i]) / (times[i + 1] - times[i]);
+   return cumulative[i] + dt * (rates[i] + 0.5 * slope * dt);
+}
+
+//-----------------------------------------------------------------
+/*
+double RateCurve::rate(double t)
+double RateCurve::integral(double t)
+* PURPOSE : Evaluate the emission rate at time t, and the number of
+*           particles emitted from the first key up to time t. Past
+*           the end of the loop, t is wrapped back into the loop, and
+*           the integral adds one loop's worth for each time around.
+* INPUTS :  double t, simulation time
+* OUTPUTS : double, particles per second or number of particles
+*/
+//-----------------------------------------------------------------
+
+double RateCurve::rate(double t)
+{
+   if (numKeys == 0)
+      return 0.0;
+
+   if (loopEnd > loopStart && t >= loopEnd){
+      double length = loopEnd - loopStart;
+      t = loopStart + fmod(t - loopStart, length);
+   }
+
+   locate(t);
+   if (cursor < 0)
+      return 0.0;
+
+   int i = cursor;
+   if (i == numKeys - 1)
+      return rates[i];
+
+   double u = (t - times[i]) / (times[i + 1] - times[i]);
+   return (1.0 - u) * rates[i] + u * rates[i + 1];
+}
+
+double RateCurve::integral(double t)
+{
+   if (numKeys == 0)
+      return 0.0;
+
+   if (loopEnd > loopStart && t >= loopEnd){
+      double length = loopEnd - loopStart;
+      double loops = floor((t - loopStart) / length);
+      double u = t - loops * length;
+      if (u >= loopEnd){				// guard against roundoff
+         u -= length;
+         loops += 1.0;
+      }
+      return integralBase(Max(u, (double)loopStart)) + loops * loopCount;
+   }
+
+   return integralBase(t);
+}
@@ -0,0 +1,43 @@
+/*
+* RateCurve.h
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/13/2018
+* Version 1.0
+*/
+
+#ifndef __RATECURVE_H__
+#define __RATECURVE_H__
+
+class RateCurve{			// Emission rate (particles per second) keyframed over time
+   private:
+      float *times;		// times of the keys, in increasing order
+      float *rates;		// rate at each key, linear in between
+      double *cumulative;	// number of particles emitted from the first key to each key
+      int numKeys;
+      int maxKeys;
+
+      float loopStart;		// after loopEnd, the curve repeats [loopStart, loopEnd)
+      float loopEnd;		// loopEnd <= loopStart means no loop
+      double loopCount;		// number of particles emitted in one loop
+
+      int cursor;		// segment of the last lookup, usually where the next one is
+
+      void locate(double t);
+      double integralBase(double t);
+
+   public:
+      RateCurve();
+      RateCurve(float rate);
+
+      void clear();
+      void addKey(float t, float rate);
+      void setLoop(float start, float end);
+
+      int getNumKeys(){return numKeys;}
+
+      double rate(double t);
+      double integral(double t);
+};
+
+#endif
@@ -0,0 +1,211 @@
+/*
+* RenderSnapshot.cpp
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/17/2018
+* Version 1.0
+*
+* A RenderSnapshot is everything the View needs to draw the particles,
+* copied out of the particle lists at the end of a step: the two ends of
+* the streak of every active particle, with their colors, packed list
+* after list in the layout of the vertex buffer. The Model keeps three,
+* and captures each step into one the View is not reading, then
+* publishes it. So the View never reads particle arrays that are being
+* changed, and never copies a ParticleGenerator to get at them.
+*
+* Capturing is done in two parallel passes over fixed size chunks of
+* the particles: the first counts the active particles of each chunk,
+* which gives each chunk where its vertices start, and the second
+* writes them.
+*/
+
+#include "RenderSnapshot.h"
+#include "Parallel.h"
+#include "Utility.h"
+
+#include <cstddef>
+
+using namespace std;
+
+#define SNAPSHOTCHUNK 16384		// particles per chunk when capturing
+
+static const float white[8] = {1, 1, 1, 1, 1, 1, 1, 0};	// streak color of lists without colors
+
+//-----------------------------------------------------------------
+/*
+RenderSnapshot::RenderSnapshot()
+* PURPOSE : Constructor, an empty snapshot
+* INPUTS :  NONE
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+RenderSnapshot::RenderSnapshot()
+{
+   vertices = NULL;
+   maxVertices = 0;
+   listStart = NULL;
+   listCapacity = NULL;
+   numLists = 0;
+   maxLists = 0;
+   chunkStart = NULL;
+   maxChunks = 0;
+   time = 0.0;
+   steps = 0;
+   for (int s = 0; s < NUMSIMSTAGES; s++)
+      stageTime[s] = 0.0;
+}
+
+//-----------------------------------------------------------------
+/*
+void RenderSnapshot::clear()
+* PURPOSE : Empty the snapshot, nothing is drawn from it. Storage is
+*           kept to be reused.
+* INPUTS :  NONE
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+void RenderSnapshot::clear()
+{
+   numLists = 0;
+   time = 0.0;
+}
+
+//-----------------------------------------------------------------
+/*
+static void chunkRange(ParticleList **lists, int numLists, int *listChunks,
+                       int c, int &l, int &begin, int &end)
+* PURPOSE : Find the list and range of particles of a chunk, chunks of
+*           every list are numbered one after the other
+* INPUTS :  lists, numLists, the lists, listChunks, first chunk of each
+*           list, and the total number of chunks after the last
+*           int c, chunk
+* OUTPUTS : int &l, list the chunk is in, begin, end, its particles
+*/
+//-----------------------------------------------------------------
+
+static void chunkRange(ParticleList **lists, int numLists, int *listChunks,
+                       int c, int &l, int &begin, int &end)
+{
+   l = 0;
+   while (l + 1 < numLists && c >= listChunks[l + 1])
+      l++;
+   begin = (c - listChunks[l]) * SNAPSHOTCHUNK;
+   end = Min(begin + SNAPSHOTCHUNK, lists[l]->getNumParticles());
+}
+
+//-----------------------------------------------------------------
+/*
+void RenderSnapshot::capture(ParticleList **lists, int n, float t)
+* PURPOSE : Copy the streak of every active particle of the lists,
+*           from its previous to its current position, colored from
+*           the list's COLOR_CHANNEL, or white if it has none
+* INPUTS :  ParticleList **lists, the lists to capture
+*           int n, how many
+*           float t, simulation time they are at
+* OUTPUTS : NONE, replaces the snapshot
+*/
+//-----------------------------------------------------------------
+
+void RenderSnapshot::capture(ParticleList **lists, int n, float t)
+{
+   if (n + 1 > maxLists){
+      delete [] listStart;
+      delete [] listCapacity;
+      maxLists = n + 1;
+      listStart = new int[maxLists];
+      listCapacity = new int[maxLists];
+   }
+
+   int *listChunks = new int[n + 1];		// first chunk of each list
+   listChunks[0] = 0;
+   for (int l = 0; l < n; l++){
+      int np = lists[l]->getNumParticles();
+      listCapacity[l] = np;
+      listChunks[l + 1] = listChunks[l] + (np + SNAPSHOTCHUNK - 1) / SNAPSHOTCHUNK;
+   }
+   int numChunks = listChunks[n];
+
+   if (numChunks + 1 > maxChunks){
+      delete [] chunkStart;
+      maxChunks = numChunks + 1;
+      chunkStart = new int[maxChunks];
+   }
+
+   // count the streaks of each chunk, and sum to find where each chunk starts
+   parallelFor(numChunks, [&](int c, int worker){
+      int l, begin, end;
+      chunkRange(lists, n, listChunks, c, l, begin, end);
+      Particle *particles = lists[l]->particles;
+
+      int count = 0;
+      for (int i = begin; i < end; i++){
+         if (particles[i].isActive)
+            count++;
+      }
+      chunkStart[c + 1] = 2 * count;
+   });
+   chunkStart[0] = 0;
+   for (int c = 0; c < numChunks; c++){
+      chunkStart[c + 1] = chunkStart[c + 1] + chunkStart[c];
+   }
+   for (int l = 0; l <= n; l++){
+      listStart[l] = chunkStart[listChunks[l]];
+   }
+
+   if (listStart[n] > maxVertices){
+      delete [] vertices;
+      maxVertices = Max(listStart[n], 2 * maxVertices);
+      vertices = new StreakVertex[maxVertices];
+   }
+
+   // write the streaks
+   parallelFor(numChunks, [&](int c, int worker){
+      int l, begin, end;
+      chunkRange(lists, n, listChunks, c, l, begin, end);
+      Particle *particles = lists[l]->particles;
+      float *colors = (float *)lists[l]->getChannel(COLOR_CHANNEL);
+
+      StreakVertex *v = vertices + chunkStart[c];
+      for (int i = begin; i < end; i++){
+         if (!particles[i].isActive)
+            continue;
+         const float *color = (colors != NULL)? colors + 8 * i : white;
+
+         v[0].position[0] = particles[i].prev_position.x;
+         v[0].position[1] = particles[i].prev_position.y;
+         v[0].position[2] = particles[i].prev_position.z;
+         v[1].position[0] = particles[i].position.x;
+         v[1].position[1] = particles[i].position.y;
+         v[1].position[2] = particles[i].position.z;
+         for (int k = 0; k < 4; k++){
+            v[0].color[k] = color[k];
+            v[1].color[k] = color[4 + k];
+         }
+         v = v + 2;
+      }
+   });
+
+   delete [] listChunks;
+   numLists = n;
+   time = t;
+}
+
+//-----------------------------------------------------------------
+/*
+void RenderSnapshot::setStepTimes(long long numSteps, const double *stageSeconds)
+* PURPOSE : Record how many steps the Model has taken, and the time it
+*           has spent in each stage of them, for the HUD
+* INPUTS :  long long numSteps, steps taken up to the one captured
+*           const double *stageSeconds, seconds spent in each SimStage
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+void RenderSnapshot::setStepTimes(long long numSteps, const double *stageSeconds)
+{
+   steps = numSteps;
+   for (int s = 0; s < NUMSIMSTAGES; s++)
+      stageTime[s] = stageSeconds[s];
+}
@@ -0,0 +1,62 @@
+/*
+* RenderSnapshot.h
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/17/2018
+* Version 1.0
+*/
+
+#ifndef __RENDERSNAPSHOT_H__
+#define __RENDERSNAPSHOT_H__
+
+#include "ParticleList.h"
+
+#include <cstddef>
+
+enum SimStage{			// Stages of a simulation step, timed while the HUD is shown
+   STAGE_UPDATE,		// deactivating, accelerating and integrating particles
+   STAGE_EMIT,			// generating new particles
+   STAGE_COLLIDE,		// bouncing off of the colliders
+   STAGE_REORDER,		// sorting particles into Morton order, now and then
+   STAGE_CAPTURE,		// capturing a snapshot
+   NUMSIMSTAGES
+};
+
+struct StreakVertex{		// One end of a particle's streak, as drawn
+   float position[3];
+   float color[4];
+};
+
+class RenderSnapshot{		// What the View draws of the particle lists, as of one step
+   private:
+      StreakVertex *vertices;	// previous then current position of every active particle, list after list
+      int maxVertices;
+      int *listStart;		// first vertex of each list, and the number of vertices after the last
+      int *listCapacity;	// particles each list has room for
+      int numLists;
+      int maxLists;
+      int *chunkStart;		// first vertex of each chunk of particles while capturing
+      int maxChunks;
+      float time;		// simulation time of the step captured
+      long long steps;		// steps taken by the Model up to this one
+      double stageTime[NUMSIMSTAGES];	// seconds spent in each stage up to this step, while timed
+
+   public:
+      RenderSnapshot();
+
+      void clear();
+      void capture(ParticleList **lists, int n, float t);
+      void setStepTimes(long long numSteps, const double *stageSeconds);
+
+      int getNumLists() const {return numLists;}
+      int getNumVertices() const {return (numLists == 0)? 0 : listStart[numLists];}
+      int getFirst(int l) const {return listStart[l];}
+      int getCount(int l) const {return listStart[l + 1] - listStart[l];}
+      const StreakVertex* getVertices() const {return vertices;}
+      int getCapacity(int l) const {return listCapacity[l];}
+      float getTime() const {return time;}
+      long long getSteps() const {return steps;}
+      double getStageTime(int s) const {return stageTime[s];}
+};
+
+#endif
@@ -0,0 +1,227 @@
+/*
+* Rng.cpp
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/16/2018
+* Version 1.0
+*
+* Random numbers that do not depend on the order things happen in. The
+* n'th number drawn from an Rng is a hash of its key and n, and the key
+* is a hash of a seed and a stream number, so a generator that starts
+* an Rng with its own seed and the step number (and the chunk, when work
+* is split over threads) draws exactly the same numbers however many
+* threads are running and whatever order they run in. drand48(), with
+* one global state, cannot do that. The hash is the splitmix64 finalizer,
+* which passes the usual statistical tests when fed a counter.
+*
+* Normally distributed numbers use the Ziggurat method (Marsaglia and
+* Tsang, in the form given by Doornik): the normal curve is covered by
+* ZIGLAYERS horizontal layers of equal area. One 64 bit draw picks a
+* layer and a point across it, and in about 99% of draws the point is
+* inside the curve without any further test, so a sample costs one hash,
+* a compare, and a multiply. Rarely, points near the edge of a layer are
+* tested against the curve, and points in the bottom layer are drawn
+* from the exact tail beyond ZIGR, so unlike a table of the inverse
+* distribution, the tails are not clipped.
+*/
+
+#include "Rng.h"
+#include "Vector.h"
+
+#include <cmath>
+
+using namespace std;
+
+#define ZIGLAYERS	128			// layers of the Ziggurat
+#define ZIGR		3.442619855899		// start of the tail, for 128 layers
+#define ZIGV		9.91256303526217e-3	// area of each layer
+
+//-----------------------------------------------------------------
+/*
+static unsigned long long mix(unsigned long long z)
+* PURPOSE : splitmix64 finalizer, scrambles every bit of z into every
+*           bit of the result
+* INPUTS :  unsigned long long z, value to hash
+* OUTPUTS : unsigned long long, hash of z
+*/
+//-----------------------------------------------------------------
+
+static unsigned long long mix(unsigned long long z)
+{
+   z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+   z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+   return z ^ (z >> 31);
+}
+
+//-----------------------------------------------------------------
+/*
+Rng::Rng()
+Rng::Rng(unsigned long long seed, unsigned long long stream)
+* PURPOSE : Constructors, start the sequence for a seed and stream
+* INPUTS :  unsigned long long seed, seed of the generator or simulation
+*           unsigned long long stream, which of the seed's sequences,
+*           e.g. from Rng::stream(step, chunk)
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+Rng::Rng()
+{
+   key = mix(0x9E3779B97F4A7C15ull);
+   counter = 0;
+}
+
+Rng::Rng(unsigned long long seed, unsigned long long stream)
+{
+   key = mix(mix(seed + 0x9E3779B97F4A7C15ull) ^ stream);
+   counter = 0;
+}
+
+//-----------------------------------------------------------------
+/*
+static unsigned long long Rng::stream(a, b, c)
+* PURPOSE : Combine up to three numbers (e.g. step, stage, and chunk)
+*           into one stream number
+* INPUTS :  unsigned long long a, b, c, numbers to combine
+* OUTPUTS : unsigned long long, stream number
+*/
+//-----------------------------------------------------------------
+
+unsigned long long Rng::stream(unsigned long long a, unsigned long long b, unsigned long long c)
+{
+   return mix(mix(mix(a) + b) + c);
+}
+
+//-----------------------------------------------------------------
+/*
+static ZigguratTables buildZiggurat()
+* PURPOSE : Build the Ziggurat tables: x[i] is the right edge of layer i
+*           (x[0] is the width the bottom layer would have as a
+*           rectangle), and r[i] = x[i + 1] / x[i] is the part of layer
+*           i that lies under the layer above, where every point is
+*           inside the curve. Built once, on first use, as a local
+*           static, which is safe even if threads race to first use.
+* INPUTS :  NONE
+* OUTPUTS : ZigguratTables, the tables
+*/
+//-----------------------------------------------------------------
+
+struct ZigguratTables{
+   double x[ZIGLAYERS + 1];
+   double r[ZIGLAYERS];
+};
+
+static ZigguratTables buildZiggurat()
+{
+   ZigguratTables t;
+
+   double f = exp(-0.5 * ZIGR * ZIGR);
+   t.x[0] = ZIGV / f;
+   t.x[1] = ZIGR;
+   t.x[ZIGLAYERS] = 0.0;
+   for (int i = 2; i < ZIGLAYERS; i++){
+      t.x[i] = sqrt(-2.0 * log(ZIGV / t.x[i - 1] + f));
+      f = exp(-0.5 * t.x[i] * t.x[i]);
+   }
+   for (int i = 0; i < ZIGLAYERS; i++){
+      t.r[i] = t.x[i + 1] / t.x[i];
+   }
+
+   return t;
+}
+
+static const ZigguratTables &zigguratTables()
+{
+   static const ZigguratTables tables = buildZiggurat();
+   return tables;
+}
+
+//-----------------------------------------------------------------
+/*
+static double ziggurat(Rng &rng, const double *x, const double *r)
+* PURPOSE : Draw one standard normal number by the Ziggurat method
+* INPUTS :  Rng &rng, random numbers, x, r, Ziggurat tables
+* OUTPUTS : double, normally distributed, mean 0, standard deviation 1
+*/
+//-----------------------------------------------------------------
+
+static double ziggurat(Rng &rng, const double *x, const double *r)
+{
+   while (true){
+      unsigned long long bits = rng.next();
+      int i = (int)(bits & (ZIGLAYERS - 1));				// low bits pick the layer
+      double u = 2.0 * ((bits >> 11) * (1.0 / 9007199254740992.0)) - 1.0;	// top bits across it
+
+      if (fabs(u) < r[i])		// under the layer above, inside the curve
+         return u * x[i];
+
+      if (i == 0){			// bottom layer, sample the tail beyond ZIGR
+         double a, b;
+         do{
+            a = log(1.0 - rng.uniform()) / ZIGR;
+            b = log(1.0 - rng.uniform());
+         } while (-2.0 * b < a * a);
+         return (u < 0)? a - ZIGR : ZIGR - a;
+      }
+
+      double v = u * x[i];		// edge of a layer, test against the curve
+      double f0 = exp(-0.5 * (x[i] * x[i] - v * v));
+      double f1 = exp(-0.5 * (x[i + 1] * x[i + 1] - v * v));
+      if (f1 + rng.uniform() * (f0 - f1) < 1.0)
+         return v;
+   }
+}
+
+//-----------------------------------------------------------------
+/*
+* Rng draws
+*
+* PURPOSE : Draw the next number of the sequence, as 64 random bits,
+*           a uniform double, a normally distributed double or array
+*           of floats (Ziggurat), or a uniformly distributed unit vector
+* INPUTS :  min, max, range of uniform, mean, std, of gaussian
+*           values, n, array to fill with n normally distributed numbers
+* OUTPUTS : the number drawn
+*/
+//-----------------------------------------------------------------
+
+unsigned long long Rng::next()
+{
+   counter = counter + 1;
+   return mix(key + counter * 0x9E3779B97F4A7C15ull);
+}
+
+double Rng::uniform()
+{
+   return (next() >> 11) * (1.0 / 9007199254740992.0);	// top 53 bits
+}
+
+double Rng::uniform(double min, double max)
+{
+   return min + (max - min) * uniform();
+}
+
+double Rng::gauss(double mean, double std)
+{
+   const ZigguratTables &z = zigguratTables();
+
+   return mean + std * ziggurat(*this, z.x, z.r);
+}
+
+void Rng::gauss(float *values, int n, double mean, double std)
+{
+   const ZigguratTables &z = zigguratTables();
+
+   for (int k = 0; k < n; k++){
+      values[k] = mean + std * ziggurat(*this, z.x, z.r);
+   }
+}
+
+Vector3d Rng::direction()
+{
+   double theta = 2.0 * PI * uniform();	// azimuth angle
+   double y = 2.0 * uniform() - 1.0;	// height
+   double r = sqrt(1.0 - y * y);
+
+   return Vector3d(r * cos(theta), y, -r * sin(theta));
+}
@@ -0,0 +1,33 @@
+/*
+* Rng.h
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/16/2018
+* Version 1.0
+*/
+
+#ifndef __RNG_H__
+#define __RNG_H__
+
+#include "Vector.h"
+
+class Rng{			// Counter based random numbers, see Rng.cpp
+   private:
+      unsigned long long key;		// key, mix of the seed and stream
+      unsigned long long counter;	// counter, number of draws so far
+
+   public:
+      Rng();
+      Rng(unsigned long long seed, unsigned long long stream);
+
+      static unsigned long long stream(unsigned long long a, unsigned long long b, unsigned long long c = 0);
+
+      unsigned long long next();		// 64 random bits
+      double uniform();				// in [0, 1)
+      double uniform(double min, double max);	// in [min, max)
+      double gauss(double mean, double std);	// normally distributed
+      void gauss(float *values, int n, double mean, double std);	// fill values with n of them
+      Vector3d direction();			// uniform on the unit sphere
+};
+
+#endif
@@ -0,0 +1,496 @@
+/*
+* SDFCollider.cpp
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/8/2018
+* Version 1.0
+*
+* An SDFCollider collides particles with a triangle mesh that has been
+* baked into a signed distance field: a dense grid holding, at each grid
+* point, the distance to the closest point on the mesh, positive on the
+* side the triangle normals face and negative on the other. Once baked,
+* a collision test costs one trilinear lookup of the grid (which also
+* gives the gradient, the direction away from the surface) no matter how
+* many triangles the mesh has.
+*
+* Baking takes one BVH closest point query per grid point, spread over
+* all threads. Since that is slow for fine grids, the field may be
+* cached in a file and read back on the next run. The cache records a
+* hash of the mesh and the grid resolution, so a stale cache is ignored
+* and rebaked.
+*
+* The closest point may be on a vertex or an edge shared by triangles
+* facing different ways, where the normal of whichever triangle the
+* query returned can give the wrong sign. So the sign is taken from the
+* angle weighted pseudonormal of the vertex, edge, or face the closest
+* point is on (Baerentzen and Aanaes, "Signed Distance Computation Using
+* the Angle Weighted Pseudonormal"), which is right everywhere around a
+* closed mesh.
+*
+* Unlike MeshCollider this is a discrete test, made only at the end of
+* each timestep. To let open meshes (floors, single sided walls) be hit
+* from either side, a particle is kept on whichever side of the surface
+* its previous position was on.
+*/
+
+#include "SDFCollider.h"
+#include "Collider.h"
+#include "Particle.h"
+#include "Mesh.h"
+#include "BVH.h"
+#include "Parallel.h"
+#include "Vector.h"
+#include "Utility.h"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+#define PADDING 3		// grid points around the mesh's bounding box
+#define CACHEVERSION 2		// version of the cache file layout, or of how it is baked
+#define FEATURETOL 1e-6		// barycentric coordinate below which a closest point is on an edge
+
+//-----------------------------------------------------------------
+/*
+static unsigned long long meshHash(Mesh *mesh)
+* PURPOSE : Compute a 64 bit FNV-1a hash of a mesh's vertices and
+*           triangles, used to tell whether a cached field is stale
+* INPUTS :  Mesh *mesh, mesh to hash
+* OUTPUTS : unsigned long long, hash value
+*/
+//-----------------------------------------------------------------
+
+static unsigned long long meshHash(Mesh *mesh)
+{
+   unsigned long long hash = 14695981039346656037ULL;
+   const unsigned char *bytes[2] = {(const unsigned char *)mesh->vertices, (const unsigned char *)mesh->indices};
+   size_t sizes[2] = {3 * mesh->numVertices * sizeof(float), 3 * mesh->numTriangles * sizeof(int)};
+
+   for (int a = 0; a < 2; a++){
+      for (size_t i = 0; i < sizes[a]; i++){
+         hash = (hash ^ bytes[a][i]) * 1099511628211ULL;
+      }
+   }
+
+   return hash;
+}
+
+//-----------------------------------------------------------------
+/*
+static void pseudonormals(Mesh *mesh, Vector3d *faceNormals, Vector3d *edgeNormals, Vector3d *vertexNormals)
+* PURPOSE : Compute the angle weighted pseudonormals of a mesh. A face's
+*           is its unit normal, an edge's is the sum of the normals of
+*           the faces sharing it, and a vertex's is the sum of the
+*           normals of the faces around it, each weighted by the
+*           face's angle at the vertex. Degenerate faces add nothing.
+*           Vertices at the same position (meshes built from quads,
+*           seams of loaded meshes) are treated as one vertex.
+* INPUTS :  Mesh *mesh, mesh to compute them for
+*           Vector3d *faceNormals, room for one per triangle
+*           Vector3d *edgeNormals, room for three per triangle, edge k
+*           of triangle t, from its vertex k to vertex k + 1, at 3t + k
+*           Vector3d *vertexNormals, room for one per vertex
+* OUTPUTS : NONE, fills in the three arrays
+*/
+//-----------------------------------------------------------------
+
+static void pseudonormals(Mesh *mesh, Vector3d *faceNormals, Vector3d *edgeNormals, Vector3d *vertexNormals)
+{
+   // Weld the vertices: sort them by position, and number each run of
+   // vertices at the same position after the first (lowest) of them
+   int *weld = new int[mesh->numVertices];
+   for (int i = 0; i < mesh->numVertices; i++)
+      weld[i] = i;
+   const float *v = mesh->vertices;
+   sort(weld, weld + mesh->numVertices, [v](int a, int b){
+      for (int k = 0; k < 3; k++){
+         if (v[3 * a + k] != v[3 * b + k])
+            return v[3 * a + k] < v[3 * b + k];
+      }
+      return a < b;
+   });
+   int *same = new int[mesh->numVertices];
+   for (int r = 0; r < mesh->numVertices; r++){
+      int i = weld[r];
+      int j = (r > 0)? weld[r - 1] : i;
+      bool repeat = r > 0 && v[3 * i] == v[3 * j] && v[3 * i + 1] == v[3 * j + 1] && v[3 * i + 2] == v[3 * j + 2];
+      same[i] = repeat? same[j] : i;
+   }
+   delete [] weld;
+
+   for (int i = 0; i < mesh->numVertices; i++)
+      vertexNormals[i].set(0, 0, 0);
+
+   for (int t = 0; t < mesh->numTriangles; t++){
+      Vector3d p[3];
+      for (int k = 0; k < 3; k++)
+         p[k] = mesh->triangleVertex(t, k);
+      Vector3d n = (p[1] - p[0]) % (p[2] - p[0]);
+      if (n.norm() <= SMALLNUMBER * (p[1] - p[0]).norm() * (p[2] - p[0]).norm()){
+         faceNormals[t].set(0, 0, 0);
+         continue;
+      }
+      faceNormals[t] = n.normalize();
+
+      for (int k = 0; k < 3; k++){
+         Vector3d e1 = p[(k + 1) % 3] - p[k];
+         Vector3d e2 = p[(k + 2) % 3] - p[k];
+         double cosine = (e1 * e2) / (e1.norm() * e2.norm());
+         double angle = acos(Max(-1.0, Min(1.0, cosine)));
+         int i = same[mesh->indices[3 * t + k]];
+         vertexNormals[i] = vertexNormals[i] + angle * faceNormals[t];
+      }
+   }
+   for (int i = 0; i < mesh->numVertices; i++)		// same[i] <= i, so it is already summed
+      vertexNormals[i] = vertexNormals[same[i]];
+
+   // Sort the edges by their vertices, so the edges shared by faces are
+   // next to each other, and sum the normals of each run
+   int numEdges = 3 * mesh->numTriangles;
+   pair<long long, int> *edges = new pair<long long, int>[numEdges];	// vertices of the edge, and its index
+   for (int e = 0; e < numEdges; e++){
+      int a = same[mesh->indices[e]];
+      int b = same[mesh->indices[(e % 3 == 2)? e - 2 : e + 1]];
+      edges[e] = make_pair((long long)Min(a, b) * mesh->numVertices + Max(a, b), e);
+   }
+   sort(edges, edges + numEdges);
+
+   int first = 0;
+   while (first < numEdges){
+      int last = first;
+      Vector3d sum(0, 0, 0);
+      while (last < numEdges && edges[last].first == edges[first].first){
+         sum = sum + faceNormals[edges[last].second / 3];
+         last++;
+      }
+      for (int e = first; e < last; e++)
+         edgeNormals[edges[e].second] = sum;
+      first = last;
+   }
+
+   delete [] edges;
+   delete [] same;
+}
+
+//-----------------------------------------------------------------
+/*
+static Vector3d closestPseudonormal(Mesh *mesh, int tri, const Vector3d &c, ...)
+* PURPOSE : Find whether a closest point is on a vertex, an edge, or
+*           inside of its triangle, from its barycentric coordinates,
+*           and return the pseudonormal of that feature
+* INPUTS :  Mesh *mesh, the mesh
+*           int tri, triangle the point is on
+*           Vector3d c, the point
+*           Vector3d *faceNormals, *edgeNormals, *vertexNormals, the
+*           mesh's pseudonormals, from pseudonormals()
+* OUTPUTS : Vector3d, pseudonormal, not normalized
+*/
+//-----------------------------------------------------------------
+
+static Vector3d closestPseudonormal(Mesh *mesh, int tri, const Vector3d &c, const Vector3d *faceNormals,
+                                    const Vector3d *edgeNormals, const Vector3d *vertexNormals)
+{
+   Vector3d a = mesh->triangleVertex(tri, 0);
+   Vector3d ab = mesh->triangleVertex(tri, 1) - a;
+   Vector3d ac = mesh->triangleVertex(tri, 2) - a;
+   Vector3d ap = c - a;
+   double d00 = ab * ab, d01 = ab * ac, d11 = ac * ac;
+   double d20 = ap * ab, d21 = ap * ac;
+   double denom = d00 * d11 - d01 * d01;
+   if (denom <= SMALLNUMBER * SMALLNUMBER * d00 * d11)		// Degenerate, no better normal to use
+      return faceNormals[tri];
+
+   double bary[3];
+   bary[1] = (d11 * d20 - d01 * d21) / denom;
+   bary[2] = (d00 * d21 - d01 * d20) / denom;
+   bary[0] = 1.0 - bary[1] - bary[2];
+
+   int numZero = 0, zero = 0, nonzero = 0;
+   for (int k = 0; k < 3; k++){
+      if (bary[k] < FEATURETOL){
+         numZero++;
+         zero = k;
+      }
+      else
+         nonzero = k;
+   }
+
+   if (numZero >= 2)						// On vertex nonzero
+      return vertexNormals[mesh->indices[3 * tri + nonzero]];
+   if (numZero == 1)						// On the edge opposite vertex zero
+      return edgeNormals[3 * tri + (zero + 1) % 3];
+   return faceNormals[tri];
+}
+
+//-----------------------------------------------------------------
+/*
+SDFCollider::SDFCollider(Mesh *mesh, int resolution, const char *cachefile)
+* PURPOSE : Variable constructor, reads the field from the cache file
+*           if it holds this mesh at this resolution, otherwise bakes
+*           the field and writes the cache file
+* INPUTS :  Mesh *mesh, mesh to bake, only used during construction
+*           int resolution, number of grid cells along the longest
+*           side of the mesh's bounding box
+*           const char *cachefile, name of cache file, NULL for none
+* OUTPUTS : NONE, initializes the distance field
+*/
+//-----------------------------------------------------------------
+
+SDFCollider::SDFCollider(Mesh *mesh, int resolution, const char *cachefile)
+{
+   phi = NULL;
+   unsigned long long hash = meshHash(mesh);
+
+   if (cachefile != NULL && readCache(cachefile, hash, resolution)){
+      status("Read distance field from", cachefile);
+   }
+   else{
+      bake(mesh, resolution);
+      if (cachefile != NULL)
+         writeCache(cachefile, hash, resolution);
+   }
+
+   skin = 0.25 * cell;
+}
+
+//-----------------------------------------------------------------
+/*
+SDFCollider::bake(Mesh *mesh, int resolution)
+* PURPOSE : Fill the grid with the signed distance to the mesh. The
+*           sign comes from the angle weighted pseudonormal of the
+*           vertex, edge, or face of the mesh the closest point is on.
+* INPUTS :  Mesh *mesh, mesh to bake
+*           int resolution, cells along longest side of bounding box
+* OUTPUTS : NONE, sets grid dimensions and fills phi
+*/
+//-----------------------------------------------------------------
+
+void SDFCollider::bake(Mesh *mesh, int resolution)
+{
+   Vector3d lo(HUGENUMBER, HUGENUMBER, HUGENUMBER);
+   Vector3d hi(-HUGENUMBER, -HUGENUMBER, -HUGENUMBER);
+   for (int i = 0; i < mesh->numVertices; i++){
+      Vector3d v = mesh->getVertex(i);
+      lo.set(Min(lo.x, v.x), Min(lo.y, v.y), Min(lo.z, v.z));
+      hi.set(Max(hi.x, v.x), Max(hi.y, v.y), Max(hi.z, v.z));
+   }
+   if (mesh->numVertices == 0){
+      lo.set(0, 0, 0);
+      hi.set(0, 0, 0);
+   }
+
+   Vector3d extent = hi - lo;
+   double longest = Max(Max(extent.x, extent.y), extent.z);
+   cell = (longest > 0)? longest / Max(resolution, 1) : 1.0;
+
+   origin = lo - (PADDING * cell) * Vector3d(1, 1, 1);
+   nx = (int)ceil(extent.x / cell) + 1 + 2 * PADDING;
+   ny = (int)ceil(extent.y / cell) + 1 + 2 * PADDING;
+   nz = (int)ceil(extent.z / cell) + 1 + 2 * PADDING;
+
+   delete [] phi;
+   phi = new float[nx * ny * nz];
+
+   BVH bvh;
+   bvh.build(mesh);
+
+   double start = wallclock();
+   Vector3d *faceNormals = new Vector3d[mesh->numTriangles];
+   Vector3d *edgeNormals = new Vector3d[3 * mesh->numTriangles];
+   Vector3d *vertexNormals = new Vector3d[mesh->numVertices];
+   pseudonormals(mesh, faceNormals, edgeNormals, vertexNormals);
+
+   parallelFor(nz, [this, &bvh, mesh, faceNormals, edgeNormals, vertexNormals](int k, int worker){	// One z slice per chunk
+      for (int j = 0; j < ny; j++){
+         for (int i = 0; i < nx; i++){
+            Vector3d x = origin + cell * Vector3d(i, j, k);
+            Vector3d c;
+            int tri;
+            float d = HUGENUMBER;
+            if (bvh.closestPoint(x, HUGENUMBER, c, tri)){
+               d = (x - c).norm();
+               if ((x - c) * closestPseudonormal(mesh, tri, c, faceNormals, edgeNormals, vertexNormals) < 0)
+                  d = -d;
+            }
+            phi[(k * ny + j) * nx + i] = d;
+         }
+      }
+   });
+
+   delete [] faceNormals;
+   delete [] edgeNormals;
+   delete [] vertexNormals;
+
+   char msg[256];
+   snprintf(msg, sizeof(msg), "%d x %d x %d grid, %d triangles, %.1f ms",
+            nx, ny, nz, mesh->numTriangles, 1000.0 * (wallclock() - start));
+   status("Baked distance field:", msg);
+}
+
+//-----------------------------------------------------------------
+/*
+bool SDFCollider::readCache(const char *filename, unsigned long long hash, int resolution)
+void SDFCollider::writeCache(const char *filename, unsigned long long hash, int resolution)
+* PURPOSE : Read or write the baked field. The file holds a short
+*           header (magic number, version, mesh hash, resolution, grid
+*           dimensions, origin, and cell size) followed by phi.
+* INPUTS :  const char *filename, name of cache file
+*           unsigned long long hash, hash of the mesh
+*           int resolution, resolution the field is baked at
+* OUTPUTS : readCache returns true if the file holds a field for this
+*           mesh and resolution, and reads it
+*/
+//-----------------------------------------------------------------
+
+bool SDFCollider::readCache(const char *filename, unsigned long long hash, int resolution)
+{
+   FILE *fp = fopen(filename, "rb");
+   if (fp == NULL)
+      return false;
+
+   char magic[4];
+   int version, res, dims[3];
+   unsigned long long fileHash;
+   double o[3];
+   float c;
+   bool ok = fread(magic, 1, 4, fp) == 4 && memcmp(magic, "PSDF", 4) == 0 &&
+             fread(&version, sizeof(int), 1, fp) == 1 && version == CACHEVERSION &&
+             fread(&fileHash, sizeof(fileHash), 1, fp) == 1 && fileHash == hash &&
+             fread(&res, sizeof(int), 1, fp) == 1 && res == resolution &&
+             fread(dims, sizeof(int), 3, fp) == 3 &&
+             fread(o, sizeof(double), 3, fp) == 3 &&
+             fread(&c, sizeof(float), 1, fp) == 1 &&
+             dims[0] > 0 && dims[1] > 0 && dims[2] > 0;
+
+   if (ok){
+      size_t n = (size_t)dims[0] * dims[1] * dims[2];
+      float *values = new float[n];
+      if (fread(values, sizeof(float), n, fp) == n){
+         delete [] phi;
+         phi = values;
+         nx = dims[0];
+         ny = dims[1];
+         nz = dims[2];
+         origin.set(o[0], o[1], o[2]);
+         cell = c;
+      }
+      else{
+         delete [] values;
+         ok = false;
+      }
+   }
+
+   fclose(fp);
+   return ok;
+}
+
+void SDFCollider::writeCache(const char *filename, unsigned long long hash, int resolution)
+{
+   FILE *fp = fopen(filename, "wb");
+   if (fp == NULL){
+      error("cannot write distance field cache", filename);
+      return;
+   }
+
+   int version = CACHEVERSION;
+   int dims[3] = {nx, ny, nz};
+   double o[3] = {origin.x, origin.y, origin.z};
+   fwrite("PSDF", 1, 4, fp);
+   fwrite(&version, sizeof(int), 1, fp);
+   fwrite(&hash, sizeof(hash), 1, fp);
+   fwrite(&resolution, sizeof(int), 1, fp);
+   fwrite(dims, sizeof(int), 3, fp);
+   fwrite(o, sizeof(double), 3, fp);
+   fwrite(&cell, sizeof(float), 1, fp);
+   fwrite(phi, sizeof(float), (size_t)nx * ny * nz, fp);
+
+   fclose(fp);
+}
+
+//-----------------------------------------------------------------
+/*
+float SDFCollider::sample(const Vector3d &x, Vector3d *gradient)
+* PURPOSE : Trilinearly interpolate the distance field at a point, and
+*           the gradient of the interpolant from the same 8 grid points
+* INPUTS :  Vector3d x, point to sample
+*           Vector3d *gradient, filled in with the gradient if not NULL
+* OUTPUTS : float, signed distance, HUGENUMBER outside of the grid
+*/
+//-----------------------------------------------------------------
+
+float SDFCollider::sample(const Vector3d &x, Vector3d *gradient)
+{
+   double gx = (x.x - origin.x) / cell;
+   double gy = (x.y - origin.y) / cell;
+   double gz = (x.z - origin.z) / cell;
+   int i = (int)floor(gx);
+   int j = (int)floor(gy);
+   int k = (int)floor(gz);
+
+   if (i < 0 || j < 0 || k < 0 || i >= nx - 1 || j >= ny - 1 || k >= nz - 1){
+      if (gradient != NULL)
+         gradient->set(0, 0, 0);
+      return HUGENUMBER;
+   }
+
+   double fx = gx - i, fy = gy - j, fz = gz - k;
+   const float *p = &phi[(k * ny + j) * nx + i];
+   int dy = nx, dz = nx * ny;
+   double c000 = p[0], c100 = p[1], c010 = p[dy], c110 = p[dy + 1];
+   double c001 = p[dz], c101 = p[dz + 1], c011 = p[dz + dy], c111 = p[dz + dy + 1];
+
+   double c00 = c000 + fx * (c100 - c000);		// Interpolate along x, then y, then z
+   double c10 = c010 + fx * (c110 - c010);
+   double c01 = c001 + fx * (c101 - c001);
+   double c11 = c011 + fx * (c111 - c011);
+   double c0 = c00 + fy * (c10 - c00);
+   double c1 = c01 + fy * (c11 - c01);
+
+   if (gradient != NULL){
+      double ddx = (1 - fy) * (1 - fz) * (c100 - c000) + fy * (1 - fz) * (c110 - c010) +
+                   (1 - fy) * fz * (c101 - c001) + fy * fz * (c111 - c011);
+      double ddy = (1 - fz) * (c10 - c00) + fz * (c11 - c01);
+      double ddz = c1 - c0;
+      gradient->set(ddx / cell, ddy / cell, ddz / cell);
+   }
+
+   return c0 + fz * (c1 - c0);
+}
+
+//-----------------------------------------------------------------
+/*
+bool SDFCollider::collide(Particle &p)
+* PURPOSE : If the particle has come within skin of the surface from
+*           the side its previous position was on, push it back out to
+*           skin along the gradient, and bounce its velocity
+* INPUTS :  Particle &p, active particle that has just been integrated
+* OUTPUTS : bool, true if the particle hit the surface. p.position and
+*           p.velocity are updated
+*/
+//-----------------------------------------------------------------
+
+bool SDFCollider::collide(Particle &p)
+{
+   Vector3d gradient;
+   float d = sample(p.position, &gradient);
+   if (d >= HUGENUMBER)
+      return false;
+
+   float side = (sample(p.prev_position, NULL) < 0)? -1.0 : 1.0;	// Side particle came from
+   if (side * d >= skin)
+      return false;
+
+   double g = gradient.norm();
+   if (g < SMALLNUMBER)
+      return false;
+   Vector3d n = (side / g) * gradient;
+
+   p.position = p.position + (skin - side * d) * n;
+   if (p.velocity * n < 0)
+      p.velocity = bounce(p.velocity, n);
+
+   return true;
+}
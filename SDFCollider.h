@@ -0,0 +1,37 @@
+/*
+* SDFCollider.h
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/8/2018
+* Version 1.0
+*/
+
+#ifndef __SDFCOLLIDER_H__
+#define __SDFCOLLIDER_H__
+
+#include "Vector.h"
+#include "Particle.h"
+#include "Mesh.h"
+#include "Collider.h"
+
+class SDFCollider : public Collider{	// Collision against a mesh baked into a signed distance field
+   private:
+      int nx, ny, nz;		// nx, ny, nz, number of grid points along each axis
+      Vector3d origin;		// origin, position of grid point (0, 0, 0)
+      float cell;		// cell, spacing of grid points
+      float* phi;		// phi, signed distance at each grid point, x varies fastest
+      float skin;		// skin, distance particles are kept from the surface
+
+      void bake(Mesh *mesh, int resolution);
+      bool readCache(const char *filename, unsigned long long hash, int resolution);
+      void writeCache(const char *filename, unsigned long long hash, int resolution);
+      float sample(const Vector3d &x, Vector3d *gradient);
+
+   public:
+      SDFCollider(Mesh *mesh, int resolution, const char *cachefile = NULL);
+
+      bool collide(Particle &p);
+      float distance(const Vector3d &x){return sample(x, NULL);}
+};
+
+#endif
@@ -0,0 +1,455 @@
+/*
+* SoftRasterizer.cpp
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/18/2018
+* Version 1.0
+*
+* The SoftRasterizer draws the same streaks the View draws, on the CPU,
+* so frames can be rendered on machines without any OpenGL context. It
+* uses the matrices of the View's Camera, clips each streak to the near
+* and far planes, and draws it as an aliased line two pixels wide, as
+* glLineWidth(2) does, with its color interpolated along it, into a float
+* RGBA framebuffer. As in the View, the streaks are drawn farthest first
+* and blended over what is behind them, with the depth test on but
+* without writing depth.
+*
+* The framebuffer is cut into TILESIZE square tiles. Streaks are first
+* projected in parallel, then sorted by distance (see DepthSort), then
+* binned in parallel over fixed size chunks of the sorted streaks: each
+* chunk adds its streaks to the bin of every tile they overlap, in
+* order. Then the tiles are drawn in parallel, each tile going through
+* the bins of every chunk in order, so each streak is drawn in the same
+* order as OpenGL would draw it, no two threads ever write the same
+* pixel, and the image does not depend on the number of threads.
+*
+* Frames are written as binary PPM, or as PNG, by ImageFile.
+*/
+
+#include "SoftRasterizer.h"
+#include "ImageFile.h"
+#include "Parallel.h"
+#include "Utility.h"
+
+#include <cmath>
+#include <vector>
+
+using namespace std;
+
+#define TILESIZE	32	// pixels on a side of a tile
+#define RASTERCHUNK	16384	// streaks per chunk when binning
+#define LINEWIDTH	2	// pixels, as the View's glLineWidth
+
+//-----------------------------------------------------------------
+/*
+SoftRasterizer::SoftRasterizer(int w, int h)
+* PURPOSE : Constructor, a framebuffer of w by h pixels, cleared to
+*           black, viewed by a camera at the origin looking down -z
+* INPUTS :  int w, h, size in pixels
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+SoftRasterizer::SoftRasterizer(int w, int h)
+{
+   width = w;
+   height = h;
+   tilesX = (width + TILESIZE - 1) / TILESIZE;
+   tilesY = (height + TILESIZE - 1) / TILESIZE;
+   color = new float[4 * width * height];
+   depth = new float[width * height];
+
+   Camera camera;
+   setCamera(camera);
+
+   streaks = NULL;
+   visible = NULL;
+   maxStreaks = 0;
+   chunkStart = NULL;
+   maxChunks = 0;
+   bins = NULL;
+   numBins = 0;
+
+   clear(0, 0, 0, 0);
+}
+
+//-----------------------------------------------------------------
+/*
+void SoftRasterizer::setCamera(const Camera &camera)
+* PURPOSE : View through the camera, as the View does, with the
+*           camera's field of view fitted to the framebuffer
+* INPUTS :  const Camera &camera, the camera
+* OUTPUTS : NONE, sets viewProjection
+*/
+//-----------------------------------------------------------------
+
+void SoftRasterizer::setCamera(const Camera &camera)
+{
+   camera.ViewProjectionMatrix(width, height, viewProjection);
+}
+
+//-----------------------------------------------------------------
+/*
+void SoftRasterizer::clear(float r, float g, float b, float a)
+* PURPOSE : Fill the framebuffer with a color, and the far depth
+* INPUTS :  float r, g, b, a, the color
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+void SoftRasterizer::clear(float r, float g, float b, float a)
+{
+   parallelFor(height, [&](int y, int worker){
+      for (int x = y * width; x < (y + 1) * width; x++){
+         color[4 * x] = r;
+         color[4 * x + 1] = g;
+         color[4 * x + 2] = b;
+         color[4 * x + 3] = a;
+         depth[x] = 1.0;
+      }
+   });
+}
+
+//-----------------------------------------------------------------
+/*
+void SoftRasterizer::project(const StreakVertex *v, int i)
+* PURPOSE : Project streak i into pixels, clipping it to the near and
+*           far planes in homogeneous coordinates, and interpolating
+*           its colors, clamped to [0, 1] as OpenGL clamps vertex
+*           colors, to the clipped ends
+* INPUTS :  const StreakVertex *v, vertices of the snapshot
+*           int i, streak, from vertex 2i to vertex 2i + 1
+* OUTPUTS : NONE, sets streaks[i], and visible[i] to whether any of
+*           it is in view
+*/
+//-----------------------------------------------------------------
+
+void SoftRasterizer::project(const StreakVertex *v, int i)
+{
+   const double *M = viewProjection;
+   double clip[2][4];
+   for (int e = 0; e < 2; e++){
+      const float *p = v[2 * i + e].position;
+      for (int r = 0; r < 4; r++){
+         clip[e][r] = M[r] * p[0] + M[4 + r] * p[1] + M[8 + r] * p[2] + M[12 + r];
+      }
+   }
+
+   // near plane is z + w >= 0, far plane w - z >= 0
+   double t0 = 0.0, t1 = 1.0;
+   for (int plane = 0; plane < 2; plane++){
+      double sign = (plane == 0)? 1.0 : -1.0;
+      double d0 = clip[0][3] + sign * clip[0][2];
+      double d1 = clip[1][3] + sign * clip[1][2];
+      if (d0 < 0.0 && d1 < 0.0){
+         visible[i] = false;
+         return;
+      }
+      if (d0 < 0.0)
+         t0 = Max(t0, d0 / (d0 - d1));
+      else if (d1 < 0.0)
+         t1 = Min(t1, d0 / (d0 - d1));
+   }
+   if (t0 >= t1){
+      visible[i] = false;
+      return;
+   }
+
+   ScreenStreak &s = streaks[i];
+   float *ends[2][2] = {{&s.x0, s.color0}, {&s.x1, s.color1}};
+   double ts[2] = {t0, t1};
+   for (int e = 0; e < 2; e++){
+      double t = ts[e];
+      double x = clip[0][0] + t * (clip[1][0] - clip[0][0]);
+      double y = clip[0][1] + t * (clip[1][1] - clip[0][1]);
+      double z = clip[0][2] + t * (clip[1][2] - clip[0][2]);
+      double w = clip[0][3] + t * (clip[1][3] - clip[0][3]);
+
+      float *xyz = ends[e][0];			// x, y, z are consecutive
+      xyz[0] = (0.5 + 0.5 * x / w) * width;
+      xyz[1] = (0.5 - 0.5 * y / w) * height;	// top row first
+      xyz[2] = 0.5 + 0.5 * z / w;
+      for (int k = 0; k < 4; k++){
+         const float *c0 = v[2 * i].color;
+         const float *c1 = v[2 * i + 1].color;
+         float c = c0[k] + t * (c1[k] - c0[k]);
+         ends[e][1][k] = Min(Max(c, 0.0f), 1.0f);
+      }
+   }
+
+   float margin = LINEWIDTH;
+   visible[i] = Max(s.x0, s.x1) >= -margin && Min(s.x0, s.x1) <= width + margin &&
+                Max(s.y0, s.y1) >= -margin && Min(s.y0, s.y1) <= height + margin;
+}
+
+//-----------------------------------------------------------------
+/*
+static bool inDiamond(float x, float y)
+* PURPOSE : Whether a point is inside the diamond inscribed in its pixel,
+*           |x - xc| + |y - yc| < 1/2, which OpenGL uses to decide which
+*           pixels the ends of a line cover
+* INPUTS :  float x, y, point in pixels
+* OUTPUTS : bool, true if inside
+*/
+//-----------------------------------------------------------------
+
+static bool inDiamond(float x, float y)
+{
+   return fabs(x - floor(x) - 0.5f) + fabs(y - floor(y) - 0.5f) < 0.5f;
+}
+
+//-----------------------------------------------------------------
+/*
+void SoftRasterizer::drawTile(int tile, int numChunks)
+* PURPOSE : Draw every streak binned to a tile, in order, clipped to
+*           the tile. A line is stepped one pixel at a time along its
+*           major axis, and is LINEWIDTH pixels across along the minor
+*           axis, centered on the line.
+* INPUTS :  int tile, the tile
+*           int numChunks, number of chunks of bins
+* OUTPUTS : NONE, draws into the framebuffer
+*/
+//-----------------------------------------------------------------
+
+void SoftRasterizer::drawTile(int tile, int numChunks)
+{
+   int numTiles = tilesX * tilesY;
+   int tx0 = (tile % tilesX) * TILESIZE;
+   int ty0 = (tile / tilesX) * TILESIZE;
+   int tx1 = Min(tx0 + TILESIZE, width);
+   int ty1 = Min(ty0 + TILESIZE, height);
+
+   for (int c = 0; c < numChunks; c++){
+      const vector<int> &bin = bins[c * numTiles + tile];
+      for (size_t b = 0; b < bin.size(); b++){
+         const ScreenStreak &s = streaks[bin[b]];
+         float dx = s.x1 - s.x0;
+         float dy = s.y1 - s.y0;
+         bool xMajor = fabs(dx) >= fabs(dy);
+
+         float a0 = xMajor? s.x0 : s.y0;		// along the major axis
+         float a1 = xMajor? s.x1 : s.y1;
+         float b0 = xMajor? s.y0 : s.x0;		// and the minor
+         float b1 = xMajor? s.y1 : s.x1;
+         if (a0 == a1)
+            continue;
+
+         // pixels whose centers the line passes along the major axis, and
+         // by the diamond exit rule, the pixel the start is in but not the
+         // one the end is in, when they are inside the pixel's diamond
+         int lo = (int)ceil(Min(a0, a1) - 0.5f);
+         int hi = (int)ceil(Max(a0, a1) - 0.5f);
+         bool startIn = inDiamond(s.x0, s.y0);
+         bool endIn = inDiamond(s.x1, s.y1);
+         if (a1 > a0){
+            if (startIn)
+               lo = Min(lo, (int)floor(a0));
+            if (endIn)
+               hi = Min(hi, (int)floor(a1));
+         }
+         else{
+            if (startIn)
+               hi = Max(hi, (int)floor(a0) + 1);
+            if (endIn)
+               lo = Max(lo, (int)floor(a1) + 1);
+         }
+         lo = Max(lo, xMajor? tx0 : ty0);
+         hi = Min(hi, xMajor? tx1 : ty1);
+         int minorLo = xMajor? ty0 : tx0;
+         int minorHi = xMajor? ty1 : tx1;
+
+         for (int p = lo; p < hi; p++){
+            float t = (p + 0.5f - a0) / (a1 - a0);
+            float m = b0 + t * (b1 - b0);
+            float z = s.z0 + t * (s.z1 - s.z0);
+            int q0 = (int)floor(m - 0.5f * LINEWIDTH + 0.5f);
+
+            for (int q = Max(q0, minorLo); q < Min(q0 + LINEWIDTH, minorHi); q++){
+               int pixel = xMajor? q * width + p : p * width + q;
+               if (z >= depth[pixel])
+                  continue;
+
+               // blend over the pixel by the streak's alpha. Pixels at the
+               // ends may be centered past them, so clamp as OpenGL does
+               float *dest = color + 4 * pixel;
+               float alpha = s.color0[3] + t * (s.color1[3] - s.color0[3]);
+               alpha = Min(Max(alpha, 0.0f), 1.0f);
+               for (int k = 0; k < 4; k++){
+                  float c = s.color0[k] + t * (s.color1[k] - s.color0[k]);
+                  c = Min(Max(c, 0.0f), 1.0f);
+                  dest[k] = alpha * c + (1.0f - alpha) * dest[k];
+               }
+            }
+         }
+      }
+   }
+}
+
+//-----------------------------------------------------------------
+/*
+void SoftRasterizer::draw(const RenderSnapshot &snapshot)
+* PURPOSE : Draw every streak of a snapshot, farthest first
+* INPUTS :  const RenderSnapshot &snapshot, the particles to draw
+* OUTPUTS : NONE, draws into the framebuffer
+*/
+//-----------------------------------------------------------------
+
+void SoftRasterizer::draw(const RenderSnapshot &snapshot)
+{
+   int n = snapshot.getNumVertices() / 2;
+   if (n == 0)
+      return;
+   const StreakVertex *vertices = snapshot.getVertices();
+
+   if (n > maxStreaks){
+      delete [] streaks;
+      delete [] visible;
+      maxStreaks = Max(n, 2 * maxStreaks);
+      streaks = new ScreenStreak[maxStreaks];
+      visible = new bool[maxStreaks];
+   }
+
+   // project each chunk of streaks, and count those in view
+   int numChunks = (n + RASTERCHUNK - 1) / RASTERCHUNK;
+   if (numChunks + 1 > maxChunks){
+      delete [] chunkStart;
+      maxChunks = numChunks + 1;
+      chunkStart = new int[maxChunks];
+   }
+   parallelFor(numChunks, [&](int c, int worker){
+      int count = 0;
+      int end = Min((c + 1) * RASTERCHUNK, n);
+      for (int i = c * RASTERCHUNK; i < end; i++){
+         project(vertices, i);
+         if (visible[i])
+            count++;
+      }
+      chunkStart[c + 1] = count;
+   });
+   chunkStart[0] = 0;
+   for (int c = 0; c < numChunks; c++){
+      chunkStart[c + 1] = chunkStart[c + 1] + chunkStart[c];
+   }
+   int numVisible = chunkStart[numChunks];
+
+   // sort them farthest first, by the w of their midpoints, which is their
+   // distance in front of the camera
+   depthSort.reserve(numVisible);
+   unsigned int *keys = depthSort.getKeys();
+   int *order = depthSort.getValues();
+   const double *M = viewProjection;
+   parallelFor(numChunks, [&](int c, int worker){
+      int k = chunkStart[c];
+      int end = Min((c + 1) * RASTERCHUNK, n);
+      for (int i = c * RASTERCHUNK; i < end; i++){
+         if (!visible[i])
+            continue;
+         const float *p0 = vertices[2 * i].position;
+         const float *p1 = vertices[2 * i + 1].position;
+         float w = 0.5 * (M[3] * (p0[0] + p1[0]) + M[7] * (p0[1] + p1[1]) + M[11] * (p0[2] + p1[2])) + M[15];
+         keys[k] = DepthSort::backToFront(w);
+         order[k] = i;
+         k++;
+      }
+   });
+   depthSort.sort(numVisible);
+   order = depthSort.getValues();
+
+   // bin each chunk of the sorted streaks to the tiles they overlap
+   int numTiles = tilesX * tilesY;
+   numChunks = (numVisible + RASTERCHUNK - 1) / RASTERCHUNK;
+   if (numChunks * numTiles > numBins){
+      delete [] bins;
+      numBins = numChunks * numTiles;
+      bins = new vector<int>[numBins];
+   }
+   parallelFor(numChunks, [&](int c, int worker){
+      vector<int> *chunkBins = bins + c * numTiles;
+      for (int t = 0; t < numTiles; t++){
+         chunkBins[t].clear();
+      }
+
+      int end = Min((c + 1) * RASTERCHUNK, numVisible);
+      for (int k = c * RASTERCHUNK; k < end; k++){
+         const ScreenStreak &s = streaks[order[k]];
+         int x0 = (int)floor(Min(s.x0, s.x1)) - LINEWIDTH;
+         int x1 = (int)ceil(Max(s.x0, s.x1)) + LINEWIDTH;
+         int y0 = (int)floor(Min(s.y0, s.y1)) - LINEWIDTH;
+         int y1 = (int)ceil(Max(s.y0, s.y1)) + LINEWIDTH;
+
+         int bx0 = Max(x0, 0) / TILESIZE;
+         int bx1 = Min(x1, width - 1) / TILESIZE;
+         int by0 = Max(y0, 0) / TILESIZE;
+         int by1 = Min(y1, height - 1) / TILESIZE;
+         for (int by = by0; by <= by1; by++){
+            for (int bx = bx0; bx <= bx1; bx++){
+               chunkBins[by * tilesX + bx].push_back(order[k]);
+            }
+         }
+      }
+   });
+
+   // draw the tiles
+   parallelFor(numTiles, [&](int tile, int worker){
+      drawTile(tile, numChunks);
+   });
+}
+
+//-----------------------------------------------------------------
+/*
+static unsigned char toByte(float c)
+* PURPOSE : Convert a color component to 8 bits
+* INPUTS :  float c, component, clamped to [0, 1]
+* OUTPUTS : unsigned char, 0 to 255
+*/
+//-----------------------------------------------------------------
+
+static unsigned char toByte(float c)
+{
+   return (unsigned char)(Min(Max(c, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+//-----------------------------------------------------------------
+/*
+void SoftRasterizer::getImage(unsigned char *rgb)
+* PURPOSE : Convert the framebuffer to 8 bit RGB
+* INPUTS :  unsigned char *rgb, room for 3 * width * height bytes
+* OUTPUTS : NONE, fills rgb, top row first
+*/
+//-----------------------------------------------------------------
+
+void SoftRasterizer::getImage(unsigned char *rgb)
+{
+   parallelFor(height, [&](int y, int worker){
+      for (int x = 0; x < width; x++){
+         for (int k = 0; k < 3; k++){
+            rgb[3 * (y * width + x) + k] = toByte(color[4 * (y * width + x) + k]);
+         }
+      }
+   });
+}
+
+//-----------------------------------------------------------------
+/*
+bool SoftRasterizer::writePPM(const char *filename)
+bool SoftRasterizer::writePNG(const char *filename)
+* PURPOSE : Write the framebuffer as a binary (P6) PPM, or as a PNG
+*           image (see ImageFile)
+* INPUTS :  const char *filename, file to write
+* OUTPUTS : bool, false if the file could not be written
+*/
+//-----------------------------------------------------------------
+
+bool SoftRasterizer::writePPM(const char *filename)
+{
+   vector<unsigned char> rgb(3 * width * height);
+   getImage(&rgb[0]);
+   return ::writePPM(filename, &rgb[0], width, height, 3, false);
+}
+
+bool SoftRasterizer::writePNG(const char *filename)
+{
+   vector<unsigned char> rgb(3 * width * height);
+   getImage(&rgb[0]);
+   return ::writePNG(filename, &rgb[0], width, height, 3, false);
+}
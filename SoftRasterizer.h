@@ -0,0 +1,62 @@
+/*
+* SoftRasterizer.h
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/18/2018
+* Version 1.0
+*/
+
+#ifndef __SOFTRASTERIZER_H__
+#define __SOFTRASTERIZER_H__
+
+#include "RenderSnapshot.h"
+#include "DepthSort.h"
+#include "Camera.h"
+
+#include <vector>
+
+struct ScreenStreak{		// A streak after projection, in pixels, clipped to the view volume
+   float x0, y0, z0;		// start, z is depth in [0, 1]
+   float x1, y1, z1;		// end
+   float color0[4];
+   float color1[4];
+};
+
+class SoftRasterizer{		// Draws RenderSnapshots into a float framebuffer without OpenGL
+   private:
+      int width, height;
+      int tilesX, tilesY;	// the framebuffer is drawn in TILESIZE square tiles
+      float *color;		// RGBA of each pixel, top row first
+      float *depth;		// depth of each pixel, in [0, 1]
+
+      double viewProjection[16];	// projection times viewing matrix, column major
+
+      ScreenStreak *streaks;	// streaks of the snapshot being drawn
+      bool *visible;		// whether each streak is inside the view volume
+      int maxStreaks;
+      int *chunkStart;		// where each chunk's visible streaks start in the sort
+      int maxChunks;
+      DepthSort depthSort;	// orders the visible streaks farthest first
+      std::vector<int> *bins;	// streaks overlapping each tile, one set of bins per chunk of sorted streaks
+      int numBins;
+
+      void project(const StreakVertex *v, int i);
+      void drawTile(int tile, int numChunks);
+
+   public:
+      SoftRasterizer(int w, int h);
+
+      int getWidth(){return width;}
+      int getHeight(){return height;}
+      const float* getColor(){return color;}
+      void getImage(unsigned char *rgb);
+
+      void setCamera(const Camera &camera);
+      void clear(float r, float g, float b, float a);
+      void draw(const RenderSnapshot &snapshot);
+
+      bool writePPM(const char *filename);
+      bool writePNG(const char *filename);
+};
+
+#endif
@@ -0,0 +1,159 @@
+/*
+* SubEmitter.cpp
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/14/2018
+* Version 1.0
+*
+* A SubEmitter lets the particles of a ParticleGenerator spawn particles
+* of their own, for effects like fireworks (a burst of sparks when each
+* shell dies) or trails (sparks shed at a rate while a particle flies).
+* Children start at the parent's position, with some of the parent's
+* velocity plus a random velocity of their own, and are activated in
+* the target ParticleList, which may belong to another generator.
+*
+* Spawning happens in the generator's kill pass, which is run in
+* parallel over chunks of the particle list. Activating children from
+* inside the pass would need every thread to take particles off the
+* same inactiveStack, so instead each chunk queues its deaths and its
+* spawn requests, and after the pass the queues are flushed: one block
+* of slots is reserved per rule, and each chunk fills in its share of
+* the block, again in parallel. Queues are kept per chunk rather than
+* per thread so that the order particles come out in does not depend on
+* the number of threads.
+*/
+
+#include "SubEmitter.h"
+#include "Vector.h"
+#include "Particle.h"
+#include "ParticleList.h"
+#include "Rng.h"
+
+#include <cmath>
+
+using namespace std;
+
+//-----------------------------------------------------------------
+/*
+SubEmitter::SubEmitter()
+SubEmitter::SubEmitter(int trig, float n, ParticleList *into)
+* PURPOSE : Constructors
+* INPUTS :  int trig, ON_DEATH or DURING_LIFE
+*           float n, children per death, or per second of life
+*           ParticleList *into, list the children are activated in
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+SubEmitter::SubEmitter()
+{
+   trigger = ON_DEATH;
+   count = 0.0;
+   target = NULL;
+
+   meanSpeed = 0.0;
+   speedRange = 0.0;
+   inherit = 0.0;
+   meanLifespan = 0.0;
+   lifespanRange = 0.0;
+   startColor.set(1, 1, 1, 1);
+   endColor.set(1, 1, 1, 0);
+}
+
+SubEmitter::SubEmitter(int trig, float n, ParticleList *into)
+{
+   trigger = trig;
+   count = n;
+   target = into;
+
+   meanSpeed = 1.0;
+   speedRange = 0.5;
+   inherit = 0.5;
+   meanLifespan = 0.5;
+   lifespanRange = 0.2;
+   startColor.set(1, 1, 1, 1);
+   endColor.set(1, 1, 1, 0);
+}
+
+//-----------------------------------------------------------------
+/*
+* SubEmitter "Setter" Functions
+*
+* PURPOSE : Set the randomization of children
+* INPUTS :  SpeedParams - mean, range - gaussian randomization of speed,
+*	    inh - fraction of the parent's velocity kept
+*	    LifespanParams - mean, range - gaussian randomization of lifespan
+*	    Colors - start, end - RGBA streak colors
+* OUTPUTS : NONE
+*/
+//-----------------------------------------------------------------
+
+void SubEmitter::setSpeedParams(float mean, float range, float inh)
+{
+   meanSpeed = mean;
+   speedRange = range;
+   inherit = inh;
+}
+
+void SubEmitter::setLifespanParams(float mean, float range)
+{
+   meanLifespan = mean;
+   lifespanRange = range;
+}
+
+void SubEmitter::setColors(Vector4d start, Vector4d end)
+{
+   startColor = start;
+   endColor = end;
+}
+
+//-----------------------------------------------------------------
+/*
+int SubEmitter::numChildren(float h, Rng &rng)
+* PURPOSE : Number of children a parent spawns when the rule fires.
+*           A fractional count is rounded up or down at random, so
+*           that on average the right number come out.
+* INPUTS :  float h, timestep, used for DURING_LIFE rates
+*           Rng &rng, random numbers of the chunk
+* OUTPUTS : int, number of children
+*/
+//-----------------------------------------------------------------
+
+int SubEmitter::numChildren(float h, Rng &rng)
+{
+   double n = (trigger == DURING_LIFE)? count * h : count;
+
+   return (int)floor(n + rng.uniform());
+}
+
+//-----------------------------------------------------------------
+/*
+void SubEmitter::emit(const Spawn &parent, Particle &child, float *color, float t, Rng &rng)
+* PURPOSE : Initialize one child of a parent
+* INPUTS :  const Spawn &parent, position and velocity of the parent
+*           Particle &child, particle to fill in
+*           float *color, child's entry in the COLOR_CHANNEL, or NULL
+*           float t, current time
+*           Rng &rng, random numbers of the chunk
+* OUTPUTS : NONE, child is activated
+*/
+//-----------------------------------------------------------------
+
+void SubEmitter::emit(const Spawn &parent, Particle &child, float *color, float t, Rng &rng)
+{
+   float s = rng.gauss(meanSpeed, speedRange / 3);
+
+   child.position = parent.position;
+   child.prev_position = parent.position;
+   child.velocity = inherit * parent.velocity + fabs(s) * rng.direction();
+   child.lifespan = rng.gauss(meanLifespan, lifespanRange / 3);
+   child.timestamp = t;
+   child.isActive = true;
+
+   if (color != NULL){
+      for (int k = 0; k < 4; k++){
+         color[k] = startColor[k];
+         color[4 + k] = endColor[k];
+      }
+   }
+}
@@ -0,0 +1,60 @@
+/*
+* SubEmitter.h
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/14/2018
+* Version 1.0
+*/
+
+#ifndef __SUBEMITTER_H__
+#define __SUBEMITTER_H__
+
+#include "Vector.h"
+#include "Particle.h"
+#include "ParticleList.h"
+#include "Rng.h"
+
+#include <vector>
+
+#define ON_DEATH	0	// children are spawned when the parent dies
+#define DURING_LIFE	1	// children are spawned at a rate while the parent lives
+
+struct Spawn{			// A parent's request for children, queued until the flush
+   Vector3d position;
+   Vector3d velocity;
+   int rule;			// index of the SubEmitter
+   int count;			// number of children
+};
+
+class SubEmitter{		// Rule for particles of a generator spawning particles of their own
+   public:
+      int trigger;		// ON_DEATH or DURING_LIFE
+      float count;		// children per death, or per second of life
+      ParticleList *target;	// list children are activated in, must not be copied after
+
+      float meanSpeed;		// speed of children relative to the parent
+      float speedRange;
+      float inherit;		// fraction of the parent's velocity children keep
+      float meanLifespan;
+      float lifespanRange;
+      Vector4d startColor;	// streak colors, used if target has the COLOR_CHANNEL
+      Vector4d endColor;
+
+      SubEmitter();
+      SubEmitter(int trig, float n, ParticleList *into);
+
+      void setSpeedParams(float mean, float range, float inh);
+      void setLifespanParams(float mean, float range);
+      void setColors(Vector4d start, Vector4d end);
+
+      int numChildren(float h, Rng &rng);
+      void emit(const Spawn &parent, Particle &child, float *color, float t, Rng &rng);
+};
+
+struct SpawnQueue{		// Spawns and deaths found in one chunk of the particle list
+   std::vector<Spawn> spawns;
+   std::vector<int> dead;
+   int offset;			// first of this chunk's children among the slots reserved
+};
+
+#endif
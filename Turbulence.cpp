@@ -0,0 +1,328 @@
+/*
+* Turbulence.cpp
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/10/2018
+* Version 1.0
+*
+* Turbulence adds a swirling, divergence free acceleration to the
+* particles, computed as the curl of a vector of Perlin noise fields
+* (curl noise). Evaluating noise for every particle at every timestep
+* is far too slow, so the curl noise is computed once, at startup, on an
+* n x n x n grid covering one tile of space. The noise is periodic over
+* the tile, so the tile repeats seamlessly to fill all of space, and the
+* acceleration at any point is a trilinear lookup of the grid. To keep
+* the pattern from looking frozen, the lookup point is scrolled with time.
+*
+* Each grid point stores the acceleration as 4 floats (x, y, z, and 0
+* as padding) so the 8 corners of the lookup can be blended with SSE
+* instructions, all three components at once.
+*
+* The grid may be cached in a file and read back, rather than recomputed.
+*/
+
+#include "Turbulence.h"
+#include "Parallel.h"
+#include "Vector.h"
+#include "Utility.h"
+
+#include <cstdio>
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64)
+#  include <xmmintrin.h>
+#  define USE_SSE
+#endif
+
+using namespace std;
+
+#define NUMOCTAVES 2		// noise octaves summed into the potential
+#define BASEPERIOD 4		// lattice cells across the tile in the first octave
+#define CACHEVERSION 1		// version of the cache file layout
+
+//-----------------------------------------------------------------
+/*
+static unsigned int latticeHash(unsigned int a, unsigned int b, unsigned int c, unsigned int d)
+* PURPOSE : Mix four integers into a well scrambled 32 bit hash, used
+*           to give every noise lattice point its own random gradient
+* INPUTS :  unsigned int a, b, c, d, values to hash
+* OUTPUTS : unsigned int, hash value
+*/
+//-----------------------------------------------------------------
+
+static unsigned int latticeHash(unsigned int a, unsigned int b, unsigned int c, unsigned int d)
+{
+   unsigned int h = a * 0x8da6b343u ^ b * 0xd8163841u ^ c * 0xcb1ab31fu ^ d * 0x165667b1u;
+   h ^= h >> 16;
+   h *= 0x7feb352du;
+   h ^= h >> 15;
+   h *= 0x846ca68bu;
+   h ^= h >> 16;
+   return h;
+}
+
+//-----------------------------------------------------------------
+/*
+static Vector3d latticeGradient(int i, int j, int k, int stream)
+* PURPOSE : Random unit gradient at a noise lattice point
+* INPUTS :  int i, j, k, lattice point, already wrapped to the period
+*           int stream, selects the potential component, octave and seed
+* OUTPUTS : Vector3d, unit gradient
+*/
+//-----------------------------------------------------------------
+
+static Vector3d latticeGradient(int i, int j, int k, int stream)
+{
+   unsigned int h = latticeHash(i, j, k, stream);
+   double y = 2.0 * (h & 0xffff) / 65535.0 - 1.0;	// Uniform on the sphere
+   double theta = 2.0 * PI * (h >> 16) / 65535.0;
+   double r = sqrt(Max(0.0, 1.0 - y * y));
+
+   return Vector3d(r * cos(theta), y, r * sin(theta));
+}
+
+//-----------------------------------------------------------------
+/*
+static double periodicNoise(double x, double y, double z, int period, int stream)
+* PURPOSE : Gradient (Perlin) noise that repeats every period lattice
+*           cells along each axis
+* INPUTS :  double x, y, z, point in lattice coordinates
+*           int period, lattice cells before the noise repeats
+*           int stream, selects the set of lattice gradients
+* OUTPUTS : double, noise value, roughly in -1 to 1
+*/
+//-----------------------------------------------------------------
+
+static double periodicNoise(double x, double y, double z, int period, int stream)
+{
+   int i = (int)floor(x), j = (int)floor(y), k = (int)floor(z);
+   double fx = x - i, fy = y - j, fz = z - k;
+   double u = fx * fx * fx * (fx * (6 * fx - 15) + 10);	// Quintic fade curves
+   double v = fy * fy * fy * (fy * (6 * fy - 15) + 10);
+   double w = fz * fz * fz * (fz * (6 * fz - 15) + 10);
+
+   double value = 0;
+   for (int c = 0; c < 8; c++){
+      int di = c & 1, dj = (c >> 1) & 1, dk = (c >> 2) & 1;
+      Vector3d g = latticeGradient(((i + di) % period + period) % period,
+                                   ((j + dj) % period + period) % period,
+                                   ((k + dk) % period + period) % period, stream);
+      double dot = g * Vector3d(fx - di, fy - dj, fz - dk);
+      value += (di? u : 1 - u) * (dj? v : 1 - v) * (dk? w : 1 - w) * dot;
+   }
+
+   return value;
+}
+
+//-----------------------------------------------------------------
+/*
+Turbulence::Turbulence(int size, float tile, float str, int seed, const char *cachefile)
+* PURPOSE : Variable constructor, reads the noise grid from the cache
+*           file if there is one for this size and seed, otherwise
+*           computes it (and writes the cache file)
+* INPUTS :  int size, grid points along each side of the tile
+*           float tile, width of the tile in world units
+*           float str, rms magnitude of the acceleration
+*           int seed, selects the noise pattern
+*           const char *cachefile, name of cache file, NULL for none
+* OUTPUTS : NONE, initializes field
+*/
+//-----------------------------------------------------------------
+
+Turbulence::Turbulence(int size, float tile, float str, int seed, const char *cachefile)
+{
+   n = Max(size, 4);
+   tileSize = tile;
+   strength = str;
+   scroll.set(0, 0, 0);
+   field = NULL;
+
+   if (cachefile == NULL || readCache(cachefile, seed) == false){
+      precompute(seed);
+      if (cachefile != NULL)
+         writeCache(cachefile, seed);
+   }
+}
+
+//-----------------------------------------------------------------
+/*
+Turbulence::precompute(int seed)
+* PURPOSE : Fill the grid with curl noise. A vector potential is made
+*           of three independent periodic noise fields (each a sum of
+*           NUMOCTAVES octaves), and its curl is taken with central
+*           differences that wrap around the tile. The result is scaled
+*           to an rms magnitude of 1.
+* INPUTS :  int seed, selects the noise pattern
+* OUTPUTS : NONE, fills field
+*/
+//-----------------------------------------------------------------
+
+void Turbulence::precompute(int seed)
+{
+   int n3 = n * n * n;
+   float *potential = new float[3 * n3];
+
+   parallelFor(n, [this, potential, seed](int k, int worker){	// One z slice per chunk
+      for (int j = 0; j < n; j++){
+         for (int i = 0; i < n; i++){
+            for (int c = 0; c < 3; c++){
+               double value = 0, amplitude = 1;
+               int period = BASEPERIOD;
+               for (int o = 0; o < NUMOCTAVES; o++){
+                  double scale = (double)period / n;
+                  value += amplitude * periodicNoise(i * scale, j * scale, k * scale, period,
+                                                     (seed * NUMOCTAVES + o) * 3 + c);
+                  amplitude *= 0.5;
+                  period *= 2;
+               }
+               potential[3 * ((k * n + j) * n + i) + c] = value;
+            }
+         }
+      }
+   });
+
+   delete [] field;
+   field = new float[4 * n3];
+
+   double sumsqr = 0;
+   for (int k = 0; k < n; k++){			// Curl of potential, wrapping at the edges
+      for (int j = 0; j < n; j++){
+         for (int i = 0; i < n; i++){
+            int xp = (k * n + j) * n + (i + 1) % n, xm = (k * n + j) * n + (i + n - 1) % n;
+            int yp = (k * n + (j + 1) % n) * n + i, ym = (k * n + (j + n - 1) % n) * n + i;
+            int zp = (((k + 1) % n) * n + j) * n + i, zm = (((k + n - 1) % n) * n + j) * n + i;
+            float *P = potential;
+            float cx = (P[3 * yp + 2] - P[3 * ym + 2]) - (P[3 * zp + 1] - P[3 * zm + 1]);
+            float cy = (P[3 * zp] - P[3 * zm]) - (P[3 * xp + 2] - P[3 * xm + 2]);
+            float cz = (P[3 * xp + 1] - P[3 * xm + 1]) - (P[3 * yp] - P[3 * ym]);
+
+            float *f = &field[4 * ((k * n + j) * n + i)];
+            f[0] = cx;
+            f[1] = cy;
+            f[2] = cz;
+            f[3] = 0;
+            sumsqr += cx * cx + cy * cy + cz * cz;
+         }
+      }
+   }
+
+   float norm = (sumsqr > 0)? 1.0 / sqrt(sumsqr / n3) : 1.0;
+   for (int i = 0; i < 4 * n3; i++)
+      field[i] *= norm;
+
+   delete [] potential;
+}
+
+//-----------------------------------------------------------------
+/*
+bool Turbulence::readCache(const char *filename, int seed)
+void Turbulence::writeCache(const char *filename, int seed)
+* PURPOSE : Read or write the noise grid. The file holds a magic
+*           number, version, grid size and seed, followed by field.
+* INPUTS :  const char *filename, name of cache file
+*           int seed, seed the grid was computed with
+* OUTPUTS : readCache returns true if the file holds a grid of this
+*           size and seed, and reads it
+*/
+//-----------------------------------------------------------------
+
+bool Turbulence::readCache(const char *filename, int seed)
+{
+   FILE *fp = fopen(filename, "rb");
+   if (fp == NULL)
+      return false;
+
+   char magic[4];
+   int header[3];
+   bool ok = fread(magic, 1, 4, fp) == 4 && memcmp(magic, "PTRB", 4) == 0 &&
+             fread(header, sizeof(int), 3, fp) == 3 &&
+             header[0] == CACHEVERSION && header[1] == n && header[2] == seed;
+
+   if (ok){
+      float *values = new float[4 * n * n * n];
+      if (fread(values, sizeof(float), 4 * n * n * n, fp) == (size_t)(4 * n * n * n)){
+         delete [] field;
+         field = values;
+      }
+      else{
+         delete [] values;
+         ok = false;
+      }
+   }
+
+   fclose(fp);
+   return ok;
+}
+
+void Turbulence::writeCache(const char *filename, int seed)
+{
+   FILE *fp = fopen(filename, "wb");
+   if (fp == NULL){
+      error("cannot write turbulence cache", filename);
+      return;
+   }
+
+   int header[3] = {CACHEVERSION, n, seed};
+   fwrite("PTRB", 1, 4, fp);
+   fwrite(header, sizeof(int), 3, fp);
+   fwrite(field, sizeof(float), 4 * n * n * n, fp);
+
+   fclose(fp);
+}
+
+//-----------------------------------------------------------------
+/*
+Vector3d Turbulence::acceleration(const Vector3d &x, float t)
+* PURPOSE : Look up the turbulent acceleration at a point and time, by
+*           trilinear interpolation of the tiled noise grid, scrolled
+*           by scroll * t
+* INPUTS :  Vector3d x, position
+*           float t, current time
+* OUTPUTS : Vector3d, acceleration
+*/
+//-----------------------------------------------------------------
+
+Vector3d Turbulence::acceleration(const Vector3d &x, float t)
+{
+   double s = n / tileSize;				// Grid coordinates of scrolled point
+   double gx = (x.x - scroll.x * t) * s;
+   double gy = (x.y - scroll.y * t) * s;
+   double gz = (x.z - scroll.z * t) * s;
+   double fi = floor(gx), fj = floor(gy), fk = floor(gz);
+   float fx = gx - fi, fy = gy - fj, fz = gz - fk;
+
+   int i0 = ((long)fi % n + n) % n, i1 = (i0 + 1) % n;	// Wrap into the tile
+   int j0 = ((long)fj % n + n) % n, j1 = (j0 + 1) % n;
+   int k0 = ((long)fk % n + n) % n, k1 = (k0 + 1) % n;
+   const float *c000 = &field[4 * ((k0 * n + j0) * n + i0)], *c100 = &field[4 * ((k0 * n + j0) * n + i1)];
+   const float *c010 = &field[4 * ((k0 * n + j1) * n + i0)], *c110 = &field[4 * ((k0 * n + j1) * n + i1)];
+   const float *c001 = &field[4 * ((k1 * n + j0) * n + i0)], *c101 = &field[4 * ((k1 * n + j0) * n + i1)];
+   const float *c011 = &field[4 * ((k1 * n + j1) * n + i0)], *c111 = &field[4 * ((k1 * n + j1) * n + i1)];
+
+   float a[4];
+#ifdef USE_SSE
+   __m128 wx = _mm_set1_ps(fx), wy = _mm_set1_ps(fy), wz = _mm_set1_ps(fz);
+   __m128 v00 = _mm_loadu_ps(c000), v10 = _mm_loadu_ps(c010);
+   __m128 v01 = _mm_loadu_ps(c001), v11 = _mm_loadu_ps(c011);
+   v00 = _mm_add_ps(v00, _mm_mul_ps(wx, _mm_sub_ps(_mm_loadu_ps(c100), v00)));	// Blend along x
+   v10 = _mm_add_ps(v10, _mm_mul_ps(wx, _mm_sub_ps(_mm_loadu_ps(c110), v10)));
+   v01 = _mm_add_ps(v01, _mm_mul_ps(wx, _mm_sub_ps(_mm_loadu_ps(c101), v01)));
+   v11 = _mm_add_ps(v11, _mm_mul_ps(wx, _mm_sub_ps(_mm_loadu_ps(c111), v11)));
+   v00 = _mm_add_ps(v00, _mm_mul_ps(wy, _mm_sub_ps(v10, v00)));			// along y
+   v01 = _mm_add_ps(v01, _mm_mul_ps(wy, _mm_sub_ps(v11, v01)));
+   v00 = _mm_add_ps(v00, _mm_mul_ps(wz, _mm_sub_ps(v01, v00)));			// along z
+   _mm_storeu_ps(a, _mm_mul_ps(v00, _mm_set1_ps(strength)));
+#else
+   for (int c = 0; c < 3; c++){
+      float v00 = c000[c] + fx * (c100[c] - c000[c]);
+      float v10 = c010[c] + fx * (c110[c] - c010[c]);
+      float v01 = c001[c] + fx * (c101[c] - c001[c]);
+      float v11 = c011[c] + fx * (c111[c] - c011[c]);
+      float v0 = v00 + fy * (v10 - v00);
+      float v1 = v01 + fy * (v11 - v01);
+      a[c] = strength * (v0 + fz * (v1 - v0));
+   }
+#endif
+
+   return Vector3d(a[0], a[1], a[2]);
+}
@@ -0,0 +1,36 @@
+/*
+* Turbulence.h
+* CPSC 8170 Physically Based Animation
+* Author: Caroline Requierme (crequie@clemson.edu)
+* Date: 10/10/2018
+* Version 1.0
+*/
+
+#ifndef __TURBULENCE_H__
+#define __TURBULENCE_H__
+
+#include "Vector.h"
+
+class Turbulence{
+   private:
+      int n;			// n, number of grid points along each side of the tile
+      float tileSize;		// tileSize, width of one tile in world units
+      float strength;		// strength, magnitude (rms) of the turbulent acceleration
+      Vector3d scroll;		// scroll, velocity the noise pattern moves with
+      float* field;		// field, x, y, z, 0 of the curl noise at each grid point, x varies fastest
+
+      void precompute(int seed);
+      bool readCache(const char *filename, int seed);
+      void writeCache(const char *filename, int seed);
+
+   public:
+      Turbulence(int size, float tile, float str, int seed = 1, const char *cachefile = NULL);
+
+      void setStrength(float str){strength = str;}
+      void setScroll(Vector3d v){scroll = v;}
+      float getStrength(){return strength;}
+
+      Vector3d acceleration(const Vector3d &x, float t);
+};
+
+#endif
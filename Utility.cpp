@@ -10,6 +10,8 @@
 
 #include "Utility.h"
 
+#include <chrono>
+
 /*
   computes sqrt(a^2 + b^2) without destructive underflow or overflow
 */
@@ -28,6 +30,16 @@ double pythag(double a, double b)
     return 0;
 }
 
+/*
+  wall clock time in seconds, measured from an arbitrary fixed point
+*/
+double wallclock()
+{
+  using namespace std::chrono;
+
+  return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
 /*
   Utility message routines
 */
@@ -54,6 +54,11 @@ enum boolean{FALSE, TRUE};
 */
 double pythag(double a, double b);
 
+/*
+  wall clock time in seconds, for timing stages of the simulation
+*/
+double wallclock();
+
 /*
   Utility Error message routines
 */
@@ -9,6 +9,7 @@
 
 #include "View.h"
 #include "ParticleList.h"
+#include "Mesh.h"
 
 #ifdef __APPLE__
 #  pragma clang diagnostic ignored "-Wdeprecated-declarations"
@@ -74,6 +75,24 @@ View::View(Model *model):
   // point to the model
   themodel = model;
 
+  // particle vertex buffer is made on first draw
+  renderer = new ParticleRenderer();
+
+  // density image is resized to the viewport when drawn
+  splatter = new DensityRenderer(width, height);
+  SplatOn = false;
+
+  // frames are read back and written only while recording
+  recorder = new FrameCapture();
+
+  // nothing is timed for the HUD until it is shown
+  hud = new PerfHUD();
+  HudOn = false;
+
+  // collider display list is made on first draw
+  colliderList = 0;
+  colliderListMesh = NULL;
+
   // initialize current window dimensions to match default
   Width = width;
   Height = height;
@@ -187,63 +206,145 @@ void View::toggleBackColor(){
     glClearColor(0, 0, 0, 1);
 }
 
-// draw the box, and also the ball, if the simulation is running
-void View::drawModel(){
-  glDisable(GL_LIGHTING);
-  glLineWidth(2.f);
-  // nothing to do if the simulation is not running
-  if(themodel->isSimRunning()){
-    
+// toggle drawing the particles as streaks or splatting them into a density image
+void View::toggleSplatting(){
+  SplatOn = !SplatOn;
+}
 
-    ParticleGenerator pg = themodel->getGen1();
-    ParticleGenerator pg2 = themodel->getGen2();
-    ParticleGenerator pg3 = themodel->getGen3();
+// make the density image brighter (factor > 1) or darker (factor < 1)
+void View::scaleExposure(float factor){
+  splatter->setExposure(splatter->getExposure() * factor);
+}
 
-    ParticleList *pl = pg.getParticleList();
-    ParticleList *pl2 = pg2.getParticleList();
-    ParticleList *pl3 = pg3.getParticleList();
+// toggle uploading streaks in the compact vertex format or as floats
+void View::toggleCompact(){
+  renderer->setCompact(!renderer->getCompact());
+}
 
-    int n1 = pl->getNumParticles();
-    int n2 = pl2->getNumParticles();
-    int n3 = pl3->getNumParticles();
-    
-    for (int i = 0; i < n1; i++)
-    { 
-      if (pl->particles[i].isActive == true){
-          glBegin(GL_LINES);
-          glColor4f(1, 0.894, 0.2, 1.0);
-          glVertex3f(pl->particles[i].prev_position.x, pl->particles[i].prev_position.y, pl->particles[i].prev_position.z);
-          glColor4f(0.760, 0.043, 0, 0.0);
-          glVertex3f(pl->particles[i].position.x, pl->particles[i].position.y, pl->particles[i].position.z);
-          glEnd();
-      }    
-    }
+// show or hide the performance HUD, the model times the stages of its
+// steps only while it is shown
+void View::toggleHUD(){
+  HudOn = !HudOn;
+  hud->reset();
+  themodel->setStageTiming(HudOn);
+}
 
-    for (int j=0; j < n2; j++){
-        if (pl2->particles[j].isActive == true){
-          glBegin(GL_LINES);
-          glColor4f(0.231, 0.125, 0.796, 1.0);
-          glVertex3f(pl2->particles[j].prev_position.x, pl2->particles[j].prev_position.y, pl2->particles[j].prev_position.z);
-          glColor4f(0.705, 0.960, 0.619, 0.0);
-          glVertex3f(pl2->particles[j].position.x, pl2->particles[j].position.y, pl2->particles[j].position.z);
-          glEnd();
-      } 
-    }
+// name the images frames are recorded into, capture.png gives
+// capture0000.png, capture0001.png, ...
+void View::setCaptureFile(const char *filename){
+  recorder->setFilename(filename);
+}
 
-    for (int k=0; k < n2; k++){
-        if (pl3->particles[k].isActive == true){
-          glBegin(GL_LINES);
-          glColor4f(0.878, 0, 0.807, 1.0);
-          glVertex3f(pl3->particles[k].prev_position.x, pl3->particles[k].prev_position.y, pl3->particles[k].prev_position.z);
-          glColor4f(0.964, 0.713, 0.215, 0.0);
-          glVertex3f(pl3->particles[k].position.x, pl3->particles[k].position.y, pl3->particles[k].position.z);
-          glEnd();
-      } 
-    }
+// start or stop recording the frames drawn
+void View::toggleCapture(){
+  if(recorder->isRecording())
+    recorder->stop();
+  else
+    recorder->start();
+}
 
+// stop recording, and wait for the frames recorded to be written
+void View::finishCapture(){
+  recorder->finish();
+}
 
+// draw the collider geometry, shaded in the box color from both sides.
+// Collider meshes can be large, so they are compiled into a display list
+// which is remade only when the model's mesh changes
+void View::drawColliders(){
+  Mesh *mesh = themodel->getColliderMesh();
+  if(mesh == NULL)
+    return;
+
+  if(mesh == colliderListMesh){
+    glEnable(GL_LIGHTING);
+    glCallList(colliderList);
+    return;
+  }
 
+  if(colliderList == 0)
+    colliderList = glGenLists(1);
+  colliderListMesh = mesh;
+  glNewList(colliderList, GL_COMPILE_AND_EXECUTE);
+
+  float diffuse_color[4], specular_color[4];
+  for(int i = 0; i < 3; i++){
+    diffuse_color[i] = diffuse_fraction * box_color[i];
+    specular_color[i] = specular_fraction * highlight_color[i];
+  }
+  diffuse_color[3] = specular_color[3] = 1;
+
+  glEnable(GL_LIGHTING);
+  glLightModeli(GL_LIGHT_MODEL_TWO_SIDE, GL_TRUE);   // thin walls are seen from both sides
+  glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, diffuse_color);
+  glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, specular_color);
+
+  glBegin(GL_TRIANGLES);
+  for(int t = 0; t < mesh->numTriangles; t++){
+    Vector3d n = mesh->triangleNormal(t);
+    glNormal3f(n.x, n.y, n.z);
+    for(int k = 0; k < 3; k++)
+      glVertex3fv(&mesh->vertices[3 * mesh->indices[3 * t + k]]);
+  }
+  glEnd();
+
+  glEndList();
+}
+
+// draw the colliders, and also the particles, if the simulation is running.
+// Returns the snapshot of the particles drawn, NULL if none were
+const RenderSnapshot* View::drawModel(){
+  drawColliders();
+
+  glDisable(GL_LIGHTING);
+  glLineWidth(2.f);
+  // nothing to do if the simulation is not running
+  const RenderSnapshot *snapshot = NULL;
+  if(themodel->isSimRunning()){
+    // particles of every generator, as of the last step the model published
+    snapshot = themodel->acquireSnapshot();
+
+    if(SplatOn){
+      // splat them into a density image, and add it over the viewport
+      splatter->resize(Width, Height);
+      splatter->setCamera(*camera);
+      splatter->draw(*snapshot);
+
+      glMatrixMode(GL_PROJECTION);
+      glPushMatrix();
+      glLoadIdentity();
+      glMatrixMode(GL_MODELVIEW);
+      glPushMatrix();
+      glLoadIdentity();
+      glRasterPos2f(-1, -1);              // lower left corner of the viewport
+
+      glDisable(GL_DEPTH_TEST);
+      glEnable(GL_BLEND);
+      glBlendFunc(GL_ONE, GL_ONE);
+      glDrawPixels(Width, Height, GL_RGBA, GL_UNSIGNED_BYTE, splatter->getImage());
+      glDisable(GL_BLEND);
+      glEnable(GL_DEPTH_TEST);
+
+      glPopMatrix();
+      glMatrixMode(GL_PROJECTION);
+      glPopMatrix();
+      glMatrixMode(GL_MODELVIEW);
+    }
+    else{
+      // draw their streaks, leaving out those the camera cannot see. They
+      // fade out along their length, so they are blended, farthest first,
+      // and do not hide each other in the depth buffer, though the
+      // colliders still hide them
+      glEnable(GL_BLEND);
+      glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+      glDepthMask(GL_FALSE);
+      renderer->setCamera(*camera, Width, Height);
+      renderer->draw(*snapshot);
+      glDepthMask(GL_TRUE);
+      glDisable(GL_BLEND);
+    }
   }
+  return snapshot;
 }
 
 //
@@ -263,8 +364,19 @@ void View::updateDisplay(){
   // position and aim the camera in modelview space
   camera->AimCamera();
 
-  // draw the model
-  drawModel();
+  // draw the model, timing it if the HUD is shown
+  double start = HudOn? wallclock() : 0.0;
+  const RenderSnapshot *snapshot = drawModel();
+
+  // read the frame back, if recording, before it is swapped out
+  recorder->capture();
+
+  // the HUD goes over the frame, but not into the recording, and reports on
+  // the snapshot drawn, not acquiring another
+  if(HudOn){
+    hud->update(snapshot, 1000.0 * (wallclock() - start));
+    hud->draw(Width, Height);
+  }
 
   glutSwapBuffers();
 }
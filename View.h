@@ -12,6 +12,10 @@
 
 #include "Camera.h"
 #include "Model.h"
+#include "ParticleRenderer.h"
+#include "DensityRenderer.h"
+#include "FrameCapture.h"
+#include "PerfHUD.h"
 
 #ifndef __VIEW_H__
 #define __VIEW_H__
@@ -47,6 +51,21 @@ class View{
     // The simulation model
     Model *themodel;
 
+    // Draws the particles from a vertex buffer
+    ParticleRenderer *renderer;
+
+    // Splats the particles into a density image on the CPU, for previews
+    // of more particles than can be drawn as lines
+    DensityRenderer *splatter;
+    bool SplatOn;
+
+    // Records the frames drawn as a sequence of images
+    FrameCapture *recorder;
+
+    // Shows the frame rate and the time spent in each stage, over the window
+    PerfHUD *hud;
+    bool HudOn;
+
     // Switches to turn lights on and off
     bool KeyOn;
     bool FillOn;
@@ -55,6 +74,10 @@ class View{
     // Switch to determine background color
     bool BackgroundGrey;
 
+    // Display list holding the collider geometry, and the mesh it was made from
+    unsigned int colliderList;
+    Mesh *colliderListMesh;
+
     // Current window dimensions
     int Width;
     int Height;
@@ -62,8 +85,11 @@ class View{
     // position the lights, never called outside of this class
     void setLights();
   
-   // draw the model, never called outside of this class
-    void drawModel();
+   // draw the model, and return the snapshot drawn (NULL if none), never called outside of this class
+    const RenderSnapshot* drawModel();
+
+    // draw the geometry particles collide with, never called outside of this class
+    void drawColliders();
   
   public:
     View(Model *model = NULL);
@@ -79,6 +105,23 @@ class View{
     // Toggle background color grey/black
     void toggleBackColor();
 
+    // Toggle drawing particles as streaks or as a density image, and
+    // scale the exposure of the density image
+    void toggleSplatting();
+    void scaleExposure(float factor);
+
+    // Toggle uploading streaks in the compact vertex format or as floats
+    void toggleCompact();
+
+    // Show or hide the performance HUD
+    void toggleHUD();
+
+    // Start or stop recording frames into numbered images named after
+    // the capture file, and finish writing them before exiting
+    void setCaptureFile(const char *filename);
+    void toggleCapture();
+    void finishCapture();
+
     // Handlers for mouse events
     void handleButtons(int button, int state, int x, int y, bool shiftkey);
     void handleMotion(int x, int y);
@@ -92,6 +135,9 @@ class View{
     // accessors to determine current screen width and height
     int getWidth(){return Width;}
     int getHeight(){return Height;}
+
+    // accessor for the camera, to render what the window would show without it
+    Camera* getCamera(){return camera;}
 };
 
 #endif
@@ -16,6 +16,14 @@
    f: toggle fill light on and off
    r: toggle back (rim) light on and off
    g: toggle window background color between grey and black
+   m: toggle periodic Morton reordering of particle storage
+   t: toggle turbulence
+   b: toggle the frame time budget (throttles generators to hold 30 fps)
+   p: toggle drawing particles as streaks or as a density image (preview)
+   + or -: brighten or darken the density image
+   c: start or stop recording frames as images
+   v: toggle the compact vertex format (floats if off)
+   h: show or hide the performance HUD (frame rate, particles, stage times)
    i: reinitialize (reset program to initial default state)
    q or Esc: quit
  
@@ -26,14 +34,61 @@
  camera raise	 - middle-button, vertical motion
  trolly    - right-button, vertical or horizontal motion, trolly camera in and out
  
- usage: 
+ usage: particle_system [-sdf] [-capture frame.png] [collider.obj | collider.ply]
+   the optional mesh file replaces the built in floor and wall colliders
+   -sdf collides with a signed distance field baked from the colliders,
+   cached in the file collider.obj.sdf (or collider.ply.sdf)
+   -capture names the images the c key records frames into, frame0000.png,
+   frame0001.png, and so on, or PPM images if the name ends in .ppm
+   (default capture.png)
+
+ usage: particle_system -verify [steps [threads]]
+   runs the simulation in deterministic mode, without a window, on one
+   thread and then on threads threads (default 200 steps on 4 threads),
+   and checks that the state of every particle matches after every step,
+   then checks that stable particle IDs survive reordering and recycling
+
+ usage: particle_system -gaussbench [samples]
+   times the normal random number generators, the old inverse table
+   ParticleGenerator::gauss and the Ziggurat Rng::gauss one at a time
+   and in a batch, on samples numbers each (default 4000000), and
+   compares how closely each follows the normal distribution
+
+ usage: particle_system -render [steps [every [frame.png]]]
+   runs the simulation for steps steps (default 300) without a window,
+   and draws the particles every every steps (default 10) on the CPU,
+   as the window would show them, writing frame0000.png, frame0001.png,
+   and so on, or PPM images if the name ends in .ppm
+
+ usage: particle_system -sortbench [particles]
+   times the parallel radix sort that orders the streaks farthest first
+   each frame, on particles random distances (default 1000000), against
+   std::stable_sort, and checks its order
+
+ usage: particle_system -compactcheck [steps]
+   runs the simulation for steps steps (default 300) without a window,
+   and every 10 steps packs the streaks the window would show both as
+   floats and in the compact vertex format, and checks that the compact
+   ones land within half a pixel of the float ones, in the same colors
 */
 
 #include "Model.h"
 #include "View.h"
+#include "Parallel.h"
+#include "SoftRasterizer.h"
+#include "ImageFile.h"
+#include "DepthSort.h"
+#include "ParticleRenderer.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
 
 #ifdef __APPLE__
 #  pragma clang diagnostic ignored "-Wdeprecated-declarations"
@@ -63,7 +118,7 @@ View psView(&particleSystem);
 //===========================================================================
 
 // global needed to share parameter filename among callbacks
-char *paramfilename;
+char *paramfilename = NULL;
 
 //
 // Keyboard callback routine.
@@ -73,9 +128,8 @@ void handleKey(unsigned char key, int x, int y){
   const int ESC = 27;
   
   switch(key){
-    case 's':            
-      particleSystem.initSimulation();     // reinitialize the simulation
-      particleSystem.startSimulation();        // start the action
+    case 's':            // reinitialize the simulation and start the action
+      particleSystem.post(START_SIMULATION);
       break;
 
     case 'k':           // toggle key light on and off
@@ -94,6 +148,43 @@ void handleKey(unsigned char key, int x, int y){
       psView.toggleBackColor();
       break;
 
+    case 'm':           // toggle Morton reordering of particles
+      particleSystem.post(TOGGLE_REORDERING);
+      break;
+
+    case 't':           // toggle turbulence
+      particleSystem.post(TOGGLE_TURBULENCE);
+      break;
+
+    case 'b':           // toggle frame time budget
+      particleSystem.post(TOGGLE_BUDGET);
+      break;
+
+    case 'p':           // toggle streaks or density image
+      psView.toggleSplatting();
+      break;
+
+    case '+':           // brighten or darken the density image
+    case '=':
+      psView.scaleExposure(1.41421356);
+      break;
+
+    case '-':
+      psView.scaleExposure(0.70710678);
+      break;
+
+    case 'v':           // toggle compact or float vertices
+      psView.toggleCompact();
+      break;
+
+    case 'h':           // show or hide the performance HUD
+      psView.toggleHUD();
+      break;
+
+    case 'c':           // start or stop recording frames
+      psView.toggleCapture();
+      break;
+
     case 'i':			// I -- reinitialize view
     case 'I':
       psView.setInitialView();
@@ -143,17 +234,398 @@ void doReshape(int width, int height){
 }
 
 //
-// idle callback: let the Model handle simulation timestep events
+// idle callback: the Model takes its steps on a thread of its own, so
+// just redraw whenever it has published a new one
 //
-void doSimulation(){
-  static int count = 0;
+void doIdle(){
+  if(particleSystem.hasNewSnapshot())
+    glutPostRedisplay();
+  else
+    this_thread::sleep_for(chrono::milliseconds(1));   // do not spin while waiting
+}
 
-  particleSystem.timeStep();
+//
+// at exit, stop the simulation thread before anything it uses is destroyed
+//
+void stopSimulation(){
+  particleSystem.stopThread();
+}
 
-  if(count == 0)         // only update the display after every displayInterval time steps
-    glutPostRedisplay();
-  
-  count = (count + 1) % particleSystem.displayInterval();
+//
+// at exit, write out the frames still waiting to be written, while the
+// window, which they are read back from, is still there
+//
+void finishCapture(){
+  psView.finishCapture();
+}
+
+//
+// Deterministic replay check: run the simulation for the given number of
+// steps on one thread, hashing the state of the particles after every
+// step, then again on the given number of threads, and compare hashes.
+// Returns the exit status, 0 if every step matched
+//
+int verifyDeterminism(int steps, int threads){
+  vector<unsigned long long> hashes(steps);
+  int runThreads[2] = {1, threads};
+
+  particleSystem.setDeterministic(true);
+  for(int run = 0; run < 2; run++){
+    setNumThreads(runThreads[run]);
+    particleSystem.initSimulation();
+    particleSystem.startSimulation();
+
+    double start = wallclock();
+    for(int i = 0; i < steps; i++){
+      particleSystem.timeStep();
+      unsigned long long hash = particleSystem.hashState();
+
+      if(run == 0)
+        hashes[i] = hash;
+      else if(hash != hashes[i]){
+        char msg[128];
+        snprintf(msg, sizeof(msg), "step %d differs on %d threads (%016llx vs %016llx)",
+                 i + 1, threads, hash, hashes[i]);
+        error("verify:", msg);
+        return 1;
+      }
+    }
+
+    char msg[128];
+    snprintf(msg, sizeof(msg), "%d steps on %d thread(s) in %.2f s, final hash %016llx",
+             steps, runThreads[run], wallclock() - start, hashes[steps - 1]);
+    status("verify:", msg);
+  }
+
+  status("verify:", "runs match at every step");
+  return 0;
+}
+
+//
+// Stable ID check: fill a list with particles, half of them short lived,
+// let those die, reorder the list, and check that every survivor's ID
+// still finds it. Then activate particles in the freed slots, and check
+// that each gets its handle back with a new generation, that the new ID
+// finds it, and that the ID of the particle that died there finds nothing.
+// Returns the exit status, 0 if every ID checked out
+//
+int verifyIDs(){
+  const int n = 1000;
+  ParticleList list(n);
+  list.enableIDs();
+  Rng rng(1, 0);
+
+  vector<unsigned long long> ids(n);
+  vector<Vector3d> positions(n);
+  for(int i = 0; i < n; i++){
+    Vector3d x(rng.uniform(-10.0, 10.0), rng.uniform(-10.0, 10.0), rng.uniform(-10.0, 10.0));
+    list.activateTopParticle(x, x, Vector3d(0, 0, 0), (i % 2 == 0)? 1.0 : 10.0, 0.0);
+  }
+  for(int i = 0; i < n; i++){
+    ids[i] = list.getID(i);
+    positions[i] = list.particles[i].position;
+    if(ids[i] == 0 || list.findID(ids[i]) != i){
+      error("verify:", "a new particle's ID does not find it");
+      return 1;
+    }
+  }
+
+  list.testAndDeactivate(0.1, 2.0);
+  int active = list.reorderMorton();
+  const int *remap = list.getRemap();
+  vector<unsigned long long> deadID(n, 0);	// ID of the particle that died, by handle
+  for(int i = 0; i < n; i++){
+    int slot = list.findID(ids[i]);
+    if(remap[i] < 0){
+      deadID[ids[i] & 0xFFFFFFFFu] = ids[i];
+      if(slot != -1){
+        error("verify:", "a dead particle's ID finds a slot");
+        return 1;
+      }
+    }
+    else if(slot != remap[i] || (list.particles[slot].position - positions[i]).norm() != 0.0){
+      error("verify:", "a particle's ID does not find it after reorderMorton");
+      return 1;
+    }
+  }
+
+  int recycled = n - active;
+  for(int k = 0; k < recycled; k++){
+    int slot = list.inactiveStack[list.inactiveCount - 1];	// the slot activated next
+    Vector3d x(rng.uniform(-10.0, 10.0), rng.uniform(-10.0, 10.0), rng.uniform(-10.0, 10.0));
+    list.activateTopParticle(x, x, Vector3d(0, 0, 0), 1.0, 2.0);
+    unsigned long long id = list.getID(slot);
+    unsigned long long old = deadID[id & 0xFFFFFFFFu];
+    if(old == 0 || (id >> 32) != (old >> 32) + 1){
+      error("verify:", "a recycled slot's particle does not get a new generation of its handle");
+      return 1;
+    }
+    if(list.findID(id) != slot || list.findID(old) != -1){
+      error("verify:", "a recycled slot's new ID does not find it, or its old ID still does");
+      return 1;
+    }
+  }
+
+  char msg[128];
+  snprintf(msg, sizeof(msg), "%d particles found after reordering, %d slots recycled with new IDs",
+           active, recycled);
+  status("verify:", msg);
+  return 0;
+}
+
+//
+// Report on one normal random number generator: throughput, the first
+// four moments, how often it goes past 3 and 4 standard deviations
+// against the exact normal, the largest number drawn, and the
+// Kolmogorov-Smirnov distance of its distribution from the normal's
+//
+void gaussReport(const char *name, vector<float> &x, double seconds){
+  int n = x.size();
+  double sum = 0.0, sum2 = 0.0, sum4 = 0.0, maxabs = 0.0;
+  int over3 = 0, over4 = 0;
+  for(int i = 0; i < n; i++)
+    sum += x[i];
+  double mean = sum / n;
+  for(int i = 0; i < n; i++){
+    double d = x[i] - mean;
+    sum2 += d * d;
+    sum4 += d * d * d * d;
+    double a = fabs(x[i]);
+    maxabs = Max(maxabs, a);
+    if(a > 3.0) over3++;
+    if(a > 4.0) over4++;
+  }
+  double var = sum2 / n;
+  double kurtosis = sum4 / (n * var * var) - 3.0;
+
+  sort(x.begin(), x.end());
+  double ks = 0.0;
+  for(int i = 0; i < n; i++){
+    double cdf = 0.5 * erfc(-x[i] / sqrt(2.0));
+    ks = Max(ks, Max(cdf - (double)i / n, (double)(i + 1) / n - cdf));
+  }
+
+  char msg[256];
+  snprintf(msg, sizeof(msg), "%6.1f M/s  mean %+.5f  var %.5f  kurt %+.4f  "
+           "P(>3) %.5f  P(>4) %.2e  max %.2f  KS %.5f",
+           n / seconds * 1e-6, mean, var, kurtosis,
+           (double)over3 / n, (double)over4 / n, maxabs, ks);
+  status(name, msg);
+}
+
+//
+// Time the table generator against the Ziggurat, one at a time and in
+// a batch, on the given number of standard normal numbers.
+// Returns the exit status
+//
+int gaussBenchmark(int samples){
+  vector<float> x(samples);
+  ParticleGenerator generator;
+  Rng rng(1, 0);
+
+  double start = wallclock();
+  for(int i = 0; i < samples; i++)
+    x[i] = generator.gauss(0.0, 1.0, 1);
+  gaussReport("table:    ", x, wallclock() - start);
+
+  start = wallclock();
+  for(int i = 0; i < samples; i++)
+    x[i] = rng.gauss(0.0, 1.0);
+  gaussReport("ziggurat: ", x, wallclock() - start);
+
+  start = wallclock();
+  rng.gauss(&x[0], samples, 0.0, 1.0);
+  gaussReport("batch:    ", x, wallclock() - start);
+
+  status("exact:    ", "mean 0, var 1, kurt 0, P(>3) 0.00270, P(>4) 6.33e-05, KS 0");
+  return 0;
+}
+
+//
+// Time the depth sort of the given number of particles, as the renderer
+// sorts them, farthest first, at random distances in front of the camera,
+// against a comparison sort, and check that it orders them correctly.
+// Returns the exit status
+//
+int sortBenchmark(int particles){
+  vector<float> distance(particles);
+  Rng rng(1, 0);
+  for(int i = 0; i < particles; i++)
+    distance[i] = rng.uniform(1.0, 100.0);
+
+  // keys are made and sorted every frame, so time both, best of several runs
+  DepthSort depthSort;
+  depthSort.reserve(particles);
+  double best = 0.0;
+  for(int run = 0; run < 5; run++){
+    double start = wallclock();
+    unsigned int *keys = depthSort.getKeys();
+    int *values = depthSort.getValues();
+    for(int i = 0; i < particles; i++){
+      keys[i] = DepthSort::backToFront(distance[i]);
+      values[i] = i;
+    }
+    depthSort.sort(particles);
+    double seconds = wallclock() - start;
+    if(run == 0 || seconds < best)
+      best = seconds;
+  }
+
+  const int *order = depthSort.getValues();
+  vector<bool> seen(particles, false);
+  for(int k = 0; k < particles; k++){
+    if(order[k] < 0 || order[k] >= particles || seen[order[k]] ||
+       (k > 0 && distance[order[k]] > distance[order[k - 1]]))
+      abort("sortbench: radix sort order is wrong");
+    seen[order[k]] = true;
+  }
+
+  vector<pair<unsigned int, int>> pairs(particles);
+  double start = wallclock();
+  for(int i = 0; i < particles; i++)
+    pairs[i] = make_pair(DepthSort::backToFront(distance[i]), i);
+  stable_sort(pairs.begin(), pairs.end());
+  double comparison = wallclock() - start;
+
+  char msg[256];
+  snprintf(msg, sizeof(msg), "%d particles on %d thread(s): radix %.2f ms (%.1f M/s), std::stable_sort %.2f ms",
+           particles, getNumThreads(), best * 1e3, particles / best * 1e-6, comparison * 1e3);
+  status("sortbench:", msg);
+  return 0;
+}
+
+//
+// Check of the compact vertex format: run the simulation for the given
+// number of steps, and every 10 steps pack the streaks the View's camera
+// sees as floats and in the compact format, unpack the compact ones as
+// the shader does, and compare where both land on the screen, and their
+// colors. Returns the exit status, 1 if any vertex is off by half a
+// pixel or more, or by a step of color or more
+//
+int compactCheck(int steps){
+  Camera *camera = psView.getCamera();
+  int w = psView.getWidth(), h = psView.getHeight();
+  ParticleRenderer renderer;
+  renderer.setCamera(*camera, w, h);
+
+  double view[16], projection[16], M[16];
+  camera->ViewMatrix(view);
+  camera->ProjectionMatrix(w, h, projection);
+  for(int col = 0; col < 4; col++)
+    for(int row = 0; row < 4; row++){
+      M[4 * col + row] = 0.0;
+      for(int k = 0; k < 4; k++)
+        M[4 * col + row] += projection[4 * k + row] * view[4 * col + k];
+    }
+
+  particleSystem.initSimulation();
+  particleSystem.startSimulation();
+
+  vector<StreakVertex> floats;
+  vector<CompactVertex> compacts;
+  int frames = 0, floatFrames = 0;
+  long long vertices = 0;
+  double maxPixels = 0.0, sumPixels = 0.0, maxColor = 0.0;
+  for(int i = 1; i <= steps; i++){
+    particleSystem.timeStep();
+    if(i % 10 != 0)
+      continue;
+
+    int n = renderer.prepare(*particleSystem.acquireSnapshot());
+    frames++;
+    if(!renderer.isCompactable()){
+      floatFrames++;
+      continue;
+    }
+    floats.resize(2 * n);
+    compacts.resize(2 * n);
+    renderer.pack(*particleSystem.acquireSnapshot(), floats.data());
+    renderer.packCompact(*particleSystem.acquireSnapshot(), compacts.data());
+
+    for(int v = 0; v < 2 * n; v++){
+      float position[3], color[4];
+      renderer.unpackCompact(compacts[v], position, color);
+
+      // pixel each lands on, if in front of the camera
+      double pixel[2][2];
+      bool inFront = true;
+      for(int f = 0; f < 2; f++){
+        const float *p = (f == 0)? floats[v].position : position;
+        double clip[4];
+        for(int r = 0; r < 4; r++)
+          clip[r] = M[r] * p[0] + M[4 + r] * p[1] + M[8 + r] * p[2] + M[12 + r];
+        inFront = inFront && clip[3] > 0.0;
+        pixel[f][0] = (0.5 + 0.5 * clip[0] / clip[3]) * w;
+        pixel[f][1] = (0.5 + 0.5 * clip[1] / clip[3]) * h;
+      }
+      if(inFront){
+        double d = sqrt(pow(pixel[1][0] - pixel[0][0], 2) + pow(pixel[1][1] - pixel[0][1], 2));
+        maxPixels = max(maxPixels, d);
+        sumPixels += d;
+      }
+      for(int k = 0; k < 4; k++)
+        maxColor = max(maxColor, 255.0 * fabs(color[k] - floats[v].color[k]));
+    }
+    vertices += 2 * n;
+  }
+
+  char msg[512];
+  snprintf(msg, sizeof(msg), "%d frames, %d drawn in floats, %lld vertices: max error %.4f pixels, "
+           "mean %.5f, max color error %.3f / 255; %.1f MB as floats, %.1f MB compact",
+           frames, floatFrames, vertices, maxPixels, vertices > 0? sumPixels / vertices : 0.0, maxColor,
+           vertices * sizeof(StreakVertex) * 1e-6, vertices * sizeof(CompactVertex) * 1e-6);
+  status("compactcheck:", msg);
+  if(maxPixels >= 0.5 || maxColor >= 1.0){
+    error("compactcheck:", "compact vertices are visibly off");
+    return 1;
+  }
+  return 0;
+}
+
+//
+// Headless rendering: run the simulation for the given number of steps,
+// and every so many steps draw its snapshot with the software rasterizer,
+// through the View's camera, into numbered image files named after the
+// given one. Returns the exit status
+//
+int renderFrames(int steps, int every, const char *filename){
+  SoftRasterizer rasterizer(psView.getWidth(), psView.getHeight());
+  rasterizer.setCamera(*psView.getCamera());
+
+  vector<unsigned char> rgb(3 * rasterizer.getWidth() * rasterizer.getHeight());
+
+  particleSystem.initSimulation();
+  particleSystem.startSimulation();
+
+  int frames = 0;
+  long long streaks = 0;
+  double drawTime = 0.0;
+  for(int i = 1; i <= steps; i++){
+    particleSystem.timeStep();
+    if(i % every != 0)
+      continue;
+
+    const RenderSnapshot *snapshot = particleSystem.acquireSnapshot();
+    double start = wallclock();
+    rasterizer.clear(0, 0, 0, 0);
+    rasterizer.draw(*snapshot);
+    drawTime += wallclock() - start;
+    streaks += snapshot->getNumVertices() / 2;
+
+    // frames are named frame0000.png, frame0001.png, ... after the given name
+    rasterizer.getImage(&rgb[0]);
+    string name = sequenceName(filename, frames);
+    if(!writeImage(name.c_str(), &rgb[0], rasterizer.getWidth(), rasterizer.getHeight(), 3, false))
+      return 1;
+    frames++;
+  }
+
+  char msg[256];
+  snprintf(msg, sizeof(msg), "%d frames of %d x %d, %lld streaks drawn in %.3f s, %.2f M streaks/s",
+           frames, rasterizer.getWidth(), rasterizer.getHeight(), streaks, drawTime,
+           drawTime > 0.0? streaks / drawTime * 1e-6 : 0.0);
+  status("render:", msg);
+  return 0;
 }
 
 //
@@ -162,9 +634,66 @@ void doSimulation(){
 //
 int main(int argc, char* argv[]){
 
+  // the determinism check needs no window
+  if(argc > 1 && strcmp(argv[1], "-verify") == 0){
+    int steps = (argc > 2)? atoi(argv[2]) : 200;
+    int threads = (argc > 3)? atoi(argv[3]) : 4;
+    if(steps <= 0 || threads <= 0)
+      abort("usage: particle_system -verify [steps [threads]]");
+    if(verifyDeterminism(steps, threads) != 0)
+      return 1;
+    return verifyIDs();
+  }
+  if(argc > 1 && strcmp(argv[1], "-gaussbench") == 0){
+    int samples = (argc > 2)? atoi(argv[2]) : 4000000;
+    if(samples <= 0)
+      abort("usage: particle_system -gaussbench [samples]");
+    return gaussBenchmark(samples);
+  }
+  if(argc > 1 && strcmp(argv[1], "-sortbench") == 0){
+    int particles = (argc > 2)? atoi(argv[2]) : 1000000;
+    if(particles <= 0)
+      abort("usage: particle_system -sortbench [particles]");
+    return sortBenchmark(particles);
+  }
+  if(argc > 1 && strcmp(argv[1], "-compactcheck") == 0){
+    int steps = (argc > 2)? atoi(argv[2]) : 300;
+    if(steps <= 0)
+      abort("usage: particle_system -compactcheck [steps]");
+    return compactCheck(steps);
+  }
+  if(argc > 1 && strcmp(argv[1], "-render") == 0){
+    int steps = (argc > 2)? atoi(argv[2]) : 300;
+    int every = (argc > 3)? atoi(argv[3]) : 10;
+    if(steps <= 0 || every <= 0 || argc > 5)
+      abort("usage: particle_system -render [steps [every [frame.png]]]");
+    return renderFrames(steps, every, (argc > 4)? argv[4] : "frame.png");
+  }
   
   // start up the glut utilities
   glutInit(&argc, argv);
+
+  // load collider mesh given on the command line, and bake it into
+  // a distance field if asked to
+  bool sdf = false;
+  for(int i = 1; i < argc; i++){
+    if(strcmp(argv[i], "-sdf") == 0)
+      sdf = true;
+    else if(strcmp(argv[i], "-capture") == 0 && i + 1 < argc)
+      psView.setCaptureFile(argv[++i]);
+    else if(paramfilename == NULL)
+      paramfilename = argv[i];
+    else
+      abort("usage: particle_system [-sdf] [-capture frame.png] [collider.obj | collider.ply]");
+  }
+
+  if(paramfilename != NULL && !particleSystem.loadColliderMesh(paramfilename))
+    abort("usage: particle_system [-sdf] [-capture frame.png] [collider.obj | collider.ply]");
+
+  if(sdf){
+    string cachefile = (paramfilename != NULL)? string(paramfilename) + ".sdf" : "";
+    particleSystem.useSDFColliders(paramfilename != NULL? cachefile.c_str() : NULL);
+  }
   
   // create the graphics window, giving width, height, and title text
   // and establish double buffering, RGBA color
@@ -181,13 +710,18 @@ int main(int argc, char* argv[]){
   glutMotionFunc(handleMotion);
 
   // idle function is called whenever there are no other events to process
-  glutIdleFunc(doSimulation);
+  glutIdleFunc(doIdle);
   
   // set up the camera viewpoint, materials, and lights
   psView.setInitialView();
 
   // load parameters and initialize the ball model
   particleSystem.initSimulation();
+
+  // the model runs on its own thread, taking commands from handleKey as messages
+  particleSystem.startThread();
+  atexit(stopSimulation);
+  atexit(finishCapture);
   
   glutMainLoop();
 }